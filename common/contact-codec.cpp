@@ -0,0 +1,181 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contact-codec.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+#include <QtCore/QMap>
+#include <QtCore/QMetaType>
+
+#include <QtContacts/QContactDetail>
+#include <QtContacts/QContactManagerEngine>
+
+#define CONTACT_CODEC_MAGIC     0x47434231 // "GCB1"
+#define CONTACT_CODEC_STREAM    QDataStream::Qt_5_0
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+void ContactCodec::registerTypes()
+{
+    // contexts and sub types are stored as QList<int>
+    static bool registered = false;
+    if (!registered) {
+        qRegisterMetaTypeStreamOperators<QList<int> >("QList<int>");
+        registered = true;
+    }
+}
+
+QByteArray ContactCodec::encode(const QList<QContact> &contacts)
+{
+    registerTypes();
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(CONTACT_CODEC_STREAM);
+
+    stream << quint32(CONTACT_CODEC_MAGIC) << quint32(contacts.size());
+    Q_FOREACH(const QContact &contact, contacts) {
+        stream << encodeContact(contact);
+    }
+    return data;
+}
+
+QList<QContact> ContactCodec::decode(const QByteArray &data, bool *ok)
+{
+    registerTypes();
+
+    QList<QContact> contacts;
+    QDataStream stream(data);
+    stream.setVersion(CONTACT_CODEC_STREAM);
+
+    quint32 magic = 0;
+    quint32 count = 0;
+    stream >> magic >> count;
+    bool valid = (stream.status() == QDataStream::Ok) && (magic == CONTACT_CODEC_MAGIC);
+
+    for(quint32 i = 0; valid && (i < count); i++) {
+        QByteArray record;
+        stream >> record;
+        valid = (stream.status() == QDataStream::Ok);
+        if (valid) {
+            contacts << decodeContact(record, &valid);
+        }
+    }
+
+    if (!valid) {
+        qWarning() << "Fail to decode contacts";
+        contacts.clear();
+    }
+    if (ok) {
+        *ok = valid;
+    }
+    return contacts;
+}
+
+QByteArray ContactCodec::encodeContact(const QContact &contact)
+{
+    registerTypes();
+
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(CONTACT_CODEC_STREAM);
+
+    QList<QContactDetail> details;
+    Q_FOREACH(const QContactDetail &detail, contact.details()) {
+        if (!detail.values().isEmpty()) {
+            details << detail;
+        }
+    }
+
+    // preferred details are stored as the index of the detail in the record
+    QMap<QString, qint32> preferred;
+    QMap<QString, int> preferredKeys = contact.preferredDetails();
+    for(QMap<QString, int>::const_iterator i = preferredKeys.constBegin();
+        i != preferredKeys.constEnd(); ++i) {
+        for(int d = 0; d < details.size(); d++) {
+            if (details.at(d).key() == i.value()) {
+                preferred.insert(i.key(), d);
+                break;
+            }
+        }
+    }
+    stream << preferred;
+
+    stream << quint32(details.size());
+    Q_FOREACH(const QContactDetail &detail, details) {
+        QMap<int, QVariant> values = detail.values();
+        stream << qint32(detail.type())
+               << quint32(detail.accessConstraints())
+               << quint32(values.size());
+        for(QMap<int, QVariant>::const_iterator i = values.constBegin();
+            i != values.constEnd(); ++i) {
+            stream << qint32(i.key()) << i.value();
+        }
+    }
+
+    return record;
+}
+
+QContact ContactCodec::decodeContact(const QByteArray &record, bool *ok)
+{
+    registerTypes();
+
+    QContact contact;
+    QDataStream stream(record);
+    stream.setVersion(CONTACT_CODEC_STREAM);
+
+    QMap<QString, qint32> preferred;
+    quint32 detailsCount = 0;
+    stream >> preferred >> detailsCount;
+
+    QList<QContactDetail> details;
+    for(quint32 d = 0; (d < detailsCount) && (stream.status() == QDataStream::Ok); d++) {
+        qint32 type = 0;
+        quint32 constraints = 0;
+        quint32 valuesCount = 0;
+        stream >> type >> constraints >> valuesCount;
+
+        QContactDetail detail(static_cast<QContactDetail::DetailType>(type));
+        for(quint32 v = 0; (v < valuesCount) && (stream.status() == QDataStream::Ok); v++) {
+            qint32 field = 0;
+            QVariant value;
+            stream >> field >> value;
+            detail.setValue(field, value);
+        }
+        QContactManagerEngine::setDetailAccessConstraints(&detail,
+                                                          QContactDetail::AccessConstraints(constraints));
+        contact.saveDetail(&detail);
+        details << detail;
+    }
+
+    for(QMap<QString, qint32>::const_iterator i = preferred.constBegin();
+        i != preferred.constEnd(); ++i) {
+        if ((i.value() >= 0) && (i.value() < details.size())) {
+            contact.setPreferredDetail(i.key(), details.at(i.value()));
+        }
+    }
+
+    *ok = (stream.status() == QDataStream::Ok);
+    return contact;
+}
+
+}
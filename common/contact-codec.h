@@ -0,0 +1,49 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_CONTACT_CODEC_H__
+#define __GALERA_CONTACT_CODEC_H__
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+#include <QtContacts/QContact>
+
+namespace galera
+{
+
+// Binary representation of a page of contacts used by the
+// "contactsDetailsBinary" view method. Each contact is a length-prefixed
+// record containing its details as (detailType, field, value) entries.
+class ContactCodec
+{
+public:
+    static QByteArray encode(const QList<QtContacts::QContact> &contacts);
+    static QList<QtContacts::QContact> decode(const QByteArray &data, bool *ok = 0);
+
+    // single contact record, without the page header
+    static QByteArray encodeContact(const QtContacts::QContact &contact);
+    static QtContacts::QContact decodeContact(const QByteArray &record, bool *ok);
+
+private:
+    static void registerTypes();
+};
+
+}
+
+#endif
@@ -26,6 +26,11 @@
 #define CPIM_ADDRESSBOOK_VIEW_OBJECT_PATH   "/com/canonical/pim/AddressBookView"
 #define CPIM_ADDRESSBOOK_VIEW_IFACE_NAME    "com.canonical.pim.AddressBookView"
 
+//Capabilities
+#define CPIM_CAPABILITY_BINARY_DETAILS      "binary-contacts-details"
+#define CPIM_CAPABILITY_PHONE_LOOKUP        "phone-number-lookup"
+#define CPIM_CAPABILITY_BATCH_CREATE        "batch-create-contacts"
+
 //Updater
 #define CPIM_UPDATE_SERVICE_NAME              "com.canonical.pim.updater"
 #define CPIM_UPDATE_OBJECT_PATH               "/com/canonical/pim/Updater"
@@ -25,6 +25,7 @@
 #include <QtCore/QDebug>
 
 #include <QtContacts/QContactGuid>
+#include <QtContacts/QContactPhoneNumber>
 #include <QtContacts/QContactExtendedDetail>
 #include <QtContacts/QContactIdFilter>
 #include <QtContacts/QContactDetailFilter>
@@ -36,7 +37,7 @@
 #include <QtContacts/QContactIdFilter>
 #include <QtContacts/QContactRelationshipFilter>
 
-#include <phonenumbers/phonenumberutil.h>
+#include <algorithm>
 
 using namespace QtContacts;
 
@@ -46,11 +47,13 @@ namespace galera
 Filter::Filter(const QString &filter)
 {
     m_filter = buildFilter(filter);
+    compile();
 }
 
 Filter::Filter(const QtContacts::QContactFilter &filter)
 {
     m_filter = parseFilter(filter);
+    compile();
 }
 
 QString Filter::toString() const
@@ -63,30 +66,78 @@ QtContacts::QContactFilter Filter::toContactFilter() const
     return m_filter;
 }
 
-bool Filter::test(const QContact &contact, const QDateTime &deletedDate) const
+bool Filter::test(const QContact &contact,
+                  const QDateTime &deletedDate,
+                  const QList<ParsedPhoneNumber> *phoneNumbers) const
 {
-    if (deletedDate.isValid() && !includeRemoved()) {
+    if (deletedDate.isValid() && !m_includeRemoved) {
         return false;
     }
 
-    return testFilter(m_filter, contact, deletedDate);
+    return run(0, contact, deletedDate, phoneNumbers);
 }
 
-bool Filter::testFilter(const QContactFilter& filter,
-                        const QContact &contact,
-                        const QDateTime &deletedDate)
+bool Filter::hasPhoneNumberTest() const
 {
-    switch(filter.type()) {
-        case QContactFilter::IdFilter:
-            return QContactManagerEngine::testFilter(filter, contact);
+    return m_hasPhoneNumberTest;
+}
+
+void Filter::compile()
+{
+    // FIXME: Return deleted contacts for id filter
+    // we need this to avoid problems with buteo, we should fix buteo to query for any contact
+    // include deleted ones.
+    m_includeRemoved = isIdFilter(m_filter) || includeRemoved(m_filter);
+    m_program = compileFilter(m_filter);
+
+    m_hasPhoneNumberTest = false;
+    m_detailTypes.clear();
+    m_detailTypes << QContactDetail::TypeGuid;
+    bool allDetails = false;
+    Q_FOREACH(const Operation &op, m_program) {
+        m_hasPhoneNumberTest |= (op.type == Operation::DetailPhoneNumber);
+        if (op.detailType != QContactDetail::TypeUndefined) {
+            if (!m_detailTypes.contains(op.detailType)) {
+                m_detailTypes << op.detailType;
+            }
+        } else if ((op.type == Operation::Fallback) &&
+                   (op.filter.type() != QContactFilter::ContactDetailFilter) &&
+                   (op.filter.type() != QContactFilter::IdFilter) &&
+                   (op.filter.type() != QContactFilter::DefaultFilter)) {
+            // the engine can test any detail
+            allDetails = true;
+        }
+    }
+    if (allDetails) {
+        m_detailTypes.clear();
+    }
+}
 
+QList<QContactDetail::DetailType> Filter::detailTypes() const
+{
+    return m_detailTypes;
+}
+
+QVector<Filter::Operation> Filter::compileFilter(const QContactFilter &filter)
+{
+    Operation op;
+    op.type = Operation::Fallback;
+    op.detailType = QContactDetail::TypeUndefined;
+    op.field = -1;
+    op.caseSensitivity = Qt::CaseInsensitive;
+    op.terms = 0;
+    op.size = 1;
+
+    QVector<Operation> program;
+    switch(filter.type()) {
         case QContactFilter::ChangeLogFilter:
         {
             const QContactChangeLogFilter bf(filter);
             if (bf.eventType() == QContactChangeLogFilter::EventRemoved) {
-                return (deletedDate >= bf.since());
-            } else if (QContactManagerEngine::testFilter(filter, contact)) {
-                return true;
+                op.type = Operation::RemovedSince;
+                op.since = bf.since();
+            } else {
+                op.filter = filter;
             }
             break;
         }
@@ -94,97 +145,183 @@ bool Filter::testFilter(const QContactFilter& filter,
         case QContactFilter::ContactDetailFilter:
         {
             const QContactDetailFilter cdf(filter);
-            if (cdf.detailType() == QContactDetail::TypeUndefined)
-                return false;
+            op.detailType = cdf.detailType();
+            op.field = cdf.detailField();
+            op.flags = cdf.matchFlags();
+            op.caseSensitivity = (op.flags & QContactFilter::MatchCaseSensitive) ?
+                        Qt::CaseSensitive : Qt::CaseInsensitive;
+
+            const QContactFilter::MatchFlags stringFlags = QContactFilter::MatchContains |
+                                                           QContactFilter::MatchStartsWith |
+                                                           QContactFilter::MatchEndsWith |
+                                                           QContactFilter::MatchFixedString;
+            if (op.detailType == QContactDetail::TypeUndefined) {
+                op.type = Operation::MatchNone;
+            } else if (op.field == -1) {
+                op.type = Operation::DetailPresence;
+            } else if (op.flags & QContactFilter::MatchPhoneNumber) {
+                op.type = Operation::DetailPhoneNumber;
+                op.phoneNumber = ParsedPhoneNumber(cdf.value().toString());
+            } else if (cdf.value().isValid() &&
+                       (op.flags & stringFlags) &&
+                       !(op.flags & QContactFilter::MatchKeypadCollation)) {
+                op.type = Operation::DetailString;
+                op.value = cdf.value().toString();
+            } else {
+                op.filter = filter;
+            }
+            break;
+        }
 
-            /* See if this contact has one of these details in it */
-            const QList<QContactDetail>& details = contact.details(cdf.detailType());
+        case QContactFilter::IntersectionFilter:
+        case QContactFilter::UnionFilter:
+        {
+            QList<QContactFilter> terms = (filter.type() == QContactFilter::IntersectionFilter) ?
+                        QContactIntersectionFilter(filter).filters() :
+                        QContactUnionFilter(filter).filters();
+            if (terms.isEmpty()) {
+                op.type = Operation::MatchNone;
+                break;
+            }
 
-            if (details.count() == 0)
-                return false; /* can't match */
+            // the filters do not have side effects, the cheaper terms are tested first
+            QList<QVector<Operation> > compiledTerms;
+            Q_FOREACH(const QContactFilter &f, terms) {
+                compiledTerms << compileFilter(f);
+            }
+            std::stable_sort(compiledTerms.begin(), compiledTerms.end(), operationLessThan);
+
+            op.type = (filter.type() == QContactFilter::IntersectionFilter) ?
+                        Operation::All : Operation::Any;
+            op.terms = compiledTerms.size();
+            op.cost = 0;
+            program << op;
+            Q_FOREACH(const QVector<Operation> &term, compiledTerms) {
+                program[0].size += term.size();
+                program[0].cost += term.first().cost;
+                program << term;
+            }
+            return program;
+        }
 
-            /* See if we need to check the values */
-            if (cdf.detailField() == -1)
-                return true;  /* just testing for the presence of a detail of the specified type */
+        default:
+            op.filter = filter;
+            break;
+    }
 
-            if (cdf.matchFlags() & QContactFilter::MatchPhoneNumber) {
-                /* Doing phone number filtering.  We hand roll an implementation here, backends will obviously want to override this. */
-                QString input = cdf.value().toString();
+    // estimated cost of the test, used to sort the terms
+    op.cost = int(op.type);
+    program << op;
+    return program;
+}
 
-                /* Look at every detail in the set of details and compare */
-                for (int j = 0; j < details.count(); j++) {
-                    const QContactDetail& detail = details.at(j);
-                    const QString& valueString = detail.value(cdf.detailField()).toString();
+bool Filter::operationLessThan(const QVector<Operation> &a, const QVector<Operation> &b)
+{
+    return (a.first().cost < b.first().cost);
+}
 
-                    if (comparePhoneNumbers(input, valueString, cdf.matchFlags())) {
-                        return true;
-                    }
+bool Filter::run(int index,
+                 const QContact &contact,
+                 const QDateTime &deletedDate,
+                 const QList<ParsedPhoneNumber> *phoneNumbers) const
+{
+    const Operation &op = m_program.at(index);
+    switch(op.type) {
+        case Operation::MatchNone:
+            return false;
+
+        case Operation::RemovedSince:
+            return (deletedDate >= op.since);
+
+        case Operation::DetailPresence:
+            return !contact.details(op.detailType).isEmpty();
+
+        case Operation::DetailString:
+        {
+            Q_FOREACH(const QContactDetail &detail, contact.details(op.detailType)) {
+                const QString value = detail.value(op.field).toString();
+                bool match;
+                // same string tests done by QContactManagerEngine::testFilter
+                switch(int(op.flags) & 7) {
+                case QContactFilter::MatchEndsWith:
+                    match = value.endsWith(op.value, op.caseSensitivity);
+                    break;
+                case QContactFilter::MatchStartsWith:
+                    match = value.startsWith(op.value, op.caseSensitivity);
+                    break;
+                case QContactFilter::MatchContains:
+                    match = value.contains(op.value, op.caseSensitivity);
+                    break;
+                default:
+                    match = (QString::compare(value, op.value, op.caseSensitivity) == 0);
+                    break;
+                }
+                if (match) {
+                    return true;
                 }
-            } else if (QContactManagerEngine::testFilter(cdf, contact)) {
-                return true;
             }
-            break;
+            return false;
         }
 
-        case QContactFilter::IntersectionFilter:
+        case Operation::DetailPhoneNumber:
         {
-            /* XXX In theory we could reorder the terms to put the native tests first */
-            const QContactIntersectionFilter bf(filter);
-            const QList<QContactFilter>& terms = bf.filters();
+            if (phoneNumbers &&
+                (op.detailType == QContactDetail::TypePhoneNumber) &&
+                (op.field == QContactPhoneNumber::FieldNumber)) {
+                Q_FOREACH(const ParsedPhoneNumber &number, *phoneNumbers) {
+                    if (comparePhoneNumbers(op.phoneNumber, number, op.flags)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
 
-            if (terms.isEmpty()) {
-                break;
+            Q_FOREACH(const QContactDetail &detail, contact.details(op.detailType)) {
+                // the number is only parsed if necessary for the match
+                ParsedPhoneNumber number(detail.value(op.field).toString(), false);
+                if (comparePhoneNumbers(op.phoneNumber, number, op.flags)) {
+                    return true;
+                }
             }
+            return false;
+        }
 
-           Q_FOREACH(const QContactFilter &f, terms) {
-                if (!testFilter(f, contact, deletedDate)) {
+        case Operation::All:
+        {
+            int term = index + 1;
+            for(int i = 0; i < op.terms; i++) {
+                if (!run(term, contact, deletedDate, phoneNumbers)) {
                     return false;
                 }
+                term += m_program.at(term).size;
             }
             return true;
         }
-        break;
 
-        case QContactFilter::UnionFilter:
+        case Operation::Any:
         {
-            /* XXX In theory we could reorder the terms to put the native tests first */
-            const QContactUnionFilter bf(filter);
-            const QList<QContactFilter>& terms = bf.filters();
-            if (terms.count() > 0) {
-                for(int j = 0; j < terms.count(); j++) {
-                    if (testFilter(terms.at(j), contact, deletedDate)) {
-                        return true;
-                    }
+            int term = index + 1;
+            for(int i = 0; i < op.terms; i++) {
+                if (run(term, contact, deletedDate, phoneNumbers)) {
+                    return true;
                 }
-                return false;
+                term += m_program.at(term).size;
             }
-            // Fall through to end
+            return false;
         }
-        break;
 
+        case Operation::Fallback:
         default:
-            if (QContactManagerEngine::testFilter(filter, contact)) {
-                return true;
-            }
-            break;
-
+            return QContactManagerEngine::testFilter(op.filter, contact);
     }
-
-    return false;
 }
 
-bool Filter::comparePhoneNumbers(const QString &input, const QString &value, QContactFilter::MatchFlags flags)
+bool Filter::comparePhoneNumbers(const ParsedPhoneNumber &input,
+                                 const ParsedPhoneNumber &value,
+                                 QContactFilter::MatchFlags flags)
 {
-    static i18n::phonenumbers::PhoneNumberUtil *phonenumberUtil = i18n::phonenumbers::PhoneNumberUtil::GetInstance();
-
-    std::string stdPreprocessedInput(input.toStdString());
-    std::string stdProcessedValue(value.toStdString());
-
-    phonenumberUtil->NormalizeDiallableCharsOnly(&stdPreprocessedInput);
-    phonenumberUtil->NormalizeDiallableCharsOnly(&stdProcessedValue);
-
-    QString preprocessedInput = QString::fromStdString(stdPreprocessedInput);
-    QString preprocessedValue = QString::fromStdString(stdProcessedValue);
+    const QString preprocessedInput = input.normalized();
+    const QString preprocessedValue = value.normalized();
 
     // if one of they does not contain digits return false
     if (preprocessedInput.isEmpty() || preprocessedValue.isEmpty()) {
@@ -195,9 +332,8 @@ bool Filter::comparePhoneNumbers(const QString &input, const QString &value, QCo
     bool msw = flags & QContactFilter::MatchStartsWith;
     bool mew = flags & QContactFilter::MatchEndsWith;
     bool me = flags & QContactFilter::MatchExactly;
-    if (!mc && !msw && !mew && !me &&
-        ((preprocessedInput.length() < 6) || (preprocessedValue.length() < 6))) {
-        return preprocessedInput == preprocessedValue;
+    if (!mc && !msw && !mew && !me) {
+        return input.matchType(value) > ParsedPhoneNumber::NoMatch;
     }
 
     if (mc) {
@@ -207,13 +343,11 @@ bool Filter::comparePhoneNumbers(const QString &input, const QString &value, QCo
     } else if (mew) {
         return preprocessedValue.endsWith(preprocessedInput);
     } else {
-        i18n::phonenumbers::PhoneNumberUtil::MatchType match =
-                phonenumberUtil->IsNumberMatchWithTwoStrings(input.toStdString(),
-                                                             value.toStdString());
+        int match = input.match(value);
         if (me) {
-            return match == i18n::phonenumbers::PhoneNumberUtil::EXACT_MATCH;
+            return match == ParsedPhoneNumber::ExactMatch;
         } else {
-            return match > i18n::phonenumbers::PhoneNumberUtil::NO_MATCH;
+            return match > ParsedPhoneNumber::NoMatch;
         }
     }
     return false;
@@ -287,13 +421,7 @@ bool Filter::isEmpty() const
 
 bool Filter::includeRemoved() const
 {
-    // FIXME: Return deleted contacts for id filter
-    // we need this to avoid problems with buteo, we should fix buteo to query for any contact
-    // include deleted ones.
-    if (isIdFilter(m_filter)) {
-        return true;
-    }
-    return includeRemoved(m_filter);
+    return m_includeRemoved;
 }
 
 QString Filter::phoneNumberToFilter() const
@@ -306,6 +434,23 @@ QStringList Filter::idsToFilter() const
     return idsToFilter(m_filter);
 }
 
+QList<QStringList> Filter::textToFilter() const
+{
+    return textToFilter(m_filter);
+}
+
+QList<QContactDetail::DetailType> Filter::textIndexedDetails()
+{
+    static QList<QContactDetail::DetailType> details;
+    if (details.isEmpty()) {
+        details << QContactDetail::TypeDisplayLabel
+                << QContactDetail::TypeName
+                << QContactDetail::TypeNickname
+                << QContactDetail::TypeEmailAddress;
+    }
+    return details;
+}
+
 QString Filter::phoneNumberToFilter(const QtContacts::QContactFilter &filter)
 {
     switch (filter.type()) {
@@ -389,6 +534,61 @@ QStringList Filter::idsToFilter(const QtContacts::QContactFilter &filter)
     return result;
 }
 
+// The result is a list of clauses, a contact must match all clauses and a clause
+// matches if the contact contains at least one of its terms (case folded).
+// The terms only narrow the search, the contacts still need to be tested against the filter.
+QList<QStringList> Filter::textToFilter(const QtContacts::QContactFilter &filter)
+{
+    QList<QStringList> result;
+
+    switch (filter.type()) {
+    case QContactFilter::ContactDetailFilter:
+    {
+        const QContactDetailFilter cdf(filter);
+        const QContactFilter::MatchFlags unsupported = QContactFilter::MatchPhoneNumber |
+                                                       QContactFilter::MatchKeypadCollation;
+        if ((cdf.detailField() != -1) &&
+            ((cdf.matchFlags() & unsupported) == 0) &&
+            (cdf.value().type() == QVariant::String) &&
+            textIndexedDetails().contains(cdf.detailType())) {
+            QString term = cdf.value().toString().toCaseFolded();
+            if (!term.isEmpty()) {
+                result << (QStringList() << term);
+            }
+        }
+        break;
+    }
+    case QContactFilter::UnionFilter:
+    {
+        // every term of the union must be optimizable, otherwise any contact can match
+        const QContactUnionFilter uf(filter);
+        QStringList terms;
+        Q_FOREACH(const QContactFilter &f, uf.filters()) {
+            QList<QStringList> fTerms = textToFilter(f);
+            if (fTerms.isEmpty()) {
+                return result;
+            }
+            terms << fTerms.first();
+        }
+        if (!terms.isEmpty()) {
+            result << terms;
+        }
+        break;
+    }
+    case QContactFilter::IntersectionFilter:
+    {
+        const QContactIntersectionFilter cif(filter);
+        Q_FOREACH(const QContactFilter &f, cif.filters()) {
+            result << textToFilter(f);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return result;
+}
+
 QString Filter::toString(const QtContacts::QContactFilter &filter)
 {
     QByteArray filterArray;
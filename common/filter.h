@@ -20,9 +20,11 @@
 #define __GALERA_FILTER_H__
 
 #include <QtCore/QDateTime>
+#include <QtCore/QVector>
 #include <QtContacts/QContactFilter>
 #include <QtContacts/QContact>
 
+#include "parsed-phone-number.h"
 
 namespace galera
 {
@@ -35,7 +37,14 @@ public:
 
     QString toString() const;
     QtContacts::QContactFilter toContactFilter() const;
-    bool test(const QtContacts::QContact &contact, const QDateTime &deletedDate = QDateTime()) const;
+    // phoneNumbers are the contact numbers already parsed, they are parsed
+    // on demand if not provided
+    bool test(const QtContacts::QContact &contact,
+              const QDateTime &deletedDate = QDateTime(),
+              const QList<ParsedPhoneNumber> *phoneNumbers = 0) const;
+    bool hasPhoneNumberTest() const;
+    // detail types read by the filter tests, empty if the filter needs the whole contact
+    QList<QtContacts::QContactDetail::DetailType> detailTypes() const;
     bool isValid() const;
     bool isEmpty() const;
     bool includeRemoved() const;
@@ -43,18 +52,65 @@ public:
     // optimization by index
     QString phoneNumberToFilter() const;
     QStringList idsToFilter() const;
+    QList<QStringList> textToFilter() const;
+
+    static QList<QtContacts::QContactDetail::DetailType> textIndexedDetails();
 
 private:
+    // Operation of the compiled filter, the operations are stored in prefix order
+    // and the terms of unions and intersections are sorted by their cost
+    struct Operation
+    {
+        // the types are declared from the cheapest to the most expensive test
+        enum Type {
+            MatchNone = 0,
+            RemovedSince,
+            DetailPresence,
+            DetailString,
+            Fallback,
+            DetailPhoneNumber,
+            All,
+            Any
+        };
+
+        Type type;
+        QtContacts::QContactDetail::DetailType detailType;
+        int field;
+        QtContacts::QContactFilter::MatchFlags flags;
+        Qt::CaseSensitivity caseSensitivity;
+        QString value;
+        ParsedPhoneNumber phoneNumber;
+        QDateTime since;
+        // filter tested by the contacts engine
+        QtContacts::QContactFilter filter;
+        // number of terms of All and Any operations
+        int terms;
+        // number of operations used by this one and its terms
+        int size;
+        int cost;
+    };
+
     QtContacts::QContactFilter m_filter;
+    QVector<Operation> m_program;
+    bool m_includeRemoved;
+    bool m_hasPhoneNumberTest;
+    QList<QtContacts::QContactDetail::DetailType> m_detailTypes;
 
     Filter();
 
+    void compile();
+    bool run(int index,
+             const QtContacts::QContact &contact,
+             const QDateTime &deletedDate,
+             const QList<ParsedPhoneNumber> *phoneNumbers) const;
+
     bool checkIsEmpty(const QList<QtContacts::QContactFilter> filters) const;
     bool checkIsValid(const QList<QtContacts::QContactFilter> filters) const;
     bool isIdFilter(const QtContacts::QContactFilter &filter) const;
 
     static QString phoneNumberToFilter(const QtContacts::QContactFilter &filter);
     static QStringList idsToFilter(const QtContacts::QContactFilter &filter);
+    static QList<QStringList> textToFilter(const QtContacts::QContactFilter &filter);
     static QString toString(const QtContacts::QContactFilter &filter);
     static QtContacts::QContactFilter buildFilter(const QString &filter);
 
@@ -65,8 +121,11 @@ private:
     static QtContacts::QContactFilter parseFilter(const QtContacts::QContactFilter &filter);
     static QtContacts::QContactFilter parseUnionFilter(const QtContacts::QContactFilter &filter);
     static QtContacts::QContactFilter parseIntersectionFilter(const QtContacts::QContactFilter &filter);
-    static bool testFilter(const QtContacts::QContactFilter& filter, const QtContacts::QContact &contact, const QDateTime &deletedDate);
-    static bool comparePhoneNumbers(const QString &phoneNumberA, const QString &phoneNumberB, QtContacts::QContactFilter::MatchFlags flags);
+    static QVector<Operation> compileFilter(const QtContacts::QContactFilter &filter);
+    static bool operationLessThan(const QVector<Operation> &a, const QVector<Operation> &b);
+    static bool comparePhoneNumbers(const ParsedPhoneNumber &input,
+                                    const ParsedPhoneNumber &value,
+                                    QtContacts::QContactFilter::MatchFlags flags);
 };
 
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parsed-phone-number.h"
+
+#include <phonenumbers/phonenumberutil.h>
+#include <phonenumbers/region_code.h>
+
+using namespace i18n::phonenumbers;
+
+#define NOT_PARSED  -1
+
+namespace galera
+{
+
+ParsedPhoneNumber::ParsedPhoneNumber()
+    : m_parseError(NOT_PARSED)
+{
+}
+
+ParsedPhoneNumber::ParsedPhoneNumber(const QString &number, bool parse)
+    : m_number(number),
+      m_parseError(NOT_PARSED)
+{
+    static PhoneNumberUtil *phonenumberUtil = PhoneNumberUtil::GetInstance();
+
+    std::string stdNumber(number.toStdString());
+    std::string stdNormalized(stdNumber);
+    phonenumberUtil->NormalizeDiallableCharsOnly(&stdNormalized);
+    m_normalized = QString::fromStdString(stdNormalized);
+
+    if (parse) {
+        PhoneNumber *parsed = new PhoneNumber;
+        m_parseError = phonenumberUtil->Parse(stdNumber, RegionCode::GetUnknown(), parsed);
+        m_parsed = QSharedPointer<PhoneNumber>(parsed);
+    }
+}
+
+QString ParsedPhoneNumber::number() const
+{
+    return m_number;
+}
+
+QString ParsedPhoneNumber::normalized() const
+{
+    return m_normalized;
+}
+
+bool ParsedPhoneNumber::isParsed() const
+{
+    return (m_parseError != NOT_PARSED);
+}
+
+int ParsedPhoneNumber::match(const ParsedPhoneNumber &other) const
+{
+    static PhoneNumberUtil *phonenumberUtil = PhoneNumberUtil::GetInstance();
+
+    // follows the IsNumberMatchWithTwoStrings steps without parsing the numbers again
+    if (m_parseError == PhoneNumberUtil::NO_PARSING_ERROR) {
+        if (other.m_parseError == PhoneNumberUtil::NO_PARSING_ERROR) {
+            return phonenumberUtil->IsNumberMatch(*m_parsed, *other.m_parsed);
+        }
+        return phonenumberUtil->IsNumberMatchWithOneString(*m_parsed, other.m_number.toStdString());
+    }
+
+    if (!isParsed() || !other.isParsed()) {
+        return phonenumberUtil->IsNumberMatchWithTwoStrings(m_number.toStdString(),
+                                                            other.m_number.toStdString());
+    }
+
+    if (m_parseError == PhoneNumberUtil::INVALID_COUNTRY_CODE_ERROR) {
+        if (other.m_parseError == PhoneNumberUtil::NO_PARSING_ERROR) {
+            return phonenumberUtil->IsNumberMatchWithOneString(*other.m_parsed, m_number.toStdString());
+        } else if (other.m_parseError == PhoneNumberUtil::INVALID_COUNTRY_CODE_ERROR) {
+            // numbers without country code are parsed by libphonenumber without validation
+            return phonenumberUtil->IsNumberMatchWithTwoStrings(m_number.toStdString(),
+                                                                other.m_number.toStdString());
+        }
+    }
+    return PhoneNumberUtil::INVALID_NUMBER;
+}
+
+ParsedPhoneNumber::MatchType ParsedPhoneNumber::matchType(const ParsedPhoneNumber &other) const
+{
+    if (m_normalized.isEmpty() || other.m_normalized.isEmpty()) {
+        return NoMatch;
+    }
+
+    if ((m_normalized.length() < 6) || (other.m_normalized.length() < 6)) {
+        return (m_normalized == other.m_normalized) ? ExactMatch : NoMatch;
+    }
+    return MatchType(match(other));
+}
+
+}
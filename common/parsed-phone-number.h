@@ -0,0 +1,73 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_PARSED_PHONE_NUMBER_H__
+#define __GALERA_PARSED_PHONE_NUMBER_H__
+
+#include <QtCore/QString>
+#include <QtCore/QSharedPointer>
+
+namespace i18n {
+namespace phonenumbers {
+class PhoneNumber;
+}
+}
+
+namespace galera
+{
+
+// Phone number normalized and parsed by libphonenumber only once, it is kept
+// with the contact and reused every time the number is compared
+class ParsedPhoneNumber
+{
+public:
+    // same values of PhoneNumberUtil::MatchType
+    enum MatchType {
+        InvalidNumber = 0,
+        NoMatch,
+        ShortNsnMatch,
+        NsnMatch,
+        ExactMatch
+    };
+
+    ParsedPhoneNumber();
+    // the parse is only necessary to use match()
+    ParsedPhoneNumber(const QString &number, bool parse = true);
+
+    QString number() const;
+    // number with diallable chars only
+    QString normalized() const;
+
+    // same result of PhoneNumberUtil::IsNumberMatchWithTwoStrings
+    int match(const ParsedPhoneNumber &other) const;
+    // match used by the default phone number filter, numbers with less than
+    // six digits only match the same number
+    MatchType matchType(const ParsedPhoneNumber &other) const;
+
+private:
+    QString m_number;
+    QString m_normalized;
+    int m_parseError;
+    QSharedPointer<i18n::phonenumbers::PhoneNumber> m_parsed;
+
+    bool isParsed() const;
+};
+
+}
+
+#endif
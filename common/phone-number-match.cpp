@@ -0,0 +1,132 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "phone-number-match.h"
+
+namespace galera {
+
+PhoneNumberMatch::PhoneNumberMatch()
+    : m_matchType(0)
+{
+}
+
+PhoneNumberMatch::PhoneNumberMatch(const QString &phoneNumber,
+                                   const QString &contactId,
+                                   const QString &displayLabel,
+                                   const QString &avatar,
+                                   const QString &matchedNumber,
+                                   int matchType)
+    : m_phoneNumber(phoneNumber),
+      m_contactId(contactId),
+      m_displayLabel(displayLabel),
+      m_avatar(avatar),
+      m_matchedNumber(matchedNumber),
+      m_matchType(matchType)
+{
+}
+
+QString PhoneNumberMatch::phoneNumber() const
+{
+    return m_phoneNumber;
+}
+
+QString PhoneNumberMatch::contactId() const
+{
+    return m_contactId;
+}
+
+QString PhoneNumberMatch::displayLabel() const
+{
+    return m_displayLabel;
+}
+
+QString PhoneNumberMatch::avatar() const
+{
+    return m_avatar;
+}
+
+QString PhoneNumberMatch::matchedNumber() const
+{
+    return m_matchedNumber;
+}
+
+int PhoneNumberMatch::matchType() const
+{
+    return m_matchType;
+}
+
+void PhoneNumberMatch::registerMetaType()
+{
+    qRegisterMetaType<PhoneNumberMatch>("PhoneNumberMatch");
+    qRegisterMetaType<PhoneNumberMatchList>("PhoneNumberMatchList");
+    qDBusRegisterMetaType<PhoneNumberMatch>();
+    qDBusRegisterMetaType<PhoneNumberMatchList>();
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PhoneNumberMatch &match)
+{
+    argument.beginStructure();
+    argument << match.m_phoneNumber;
+    argument << match.m_contactId;
+    argument << match.m_displayLabel;
+    argument << match.m_avatar;
+    argument << match.m_matchedNumber;
+    argument << match.m_matchType;
+    argument.endStructure();
+
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PhoneNumberMatch &match)
+{
+    argument.beginStructure();
+    argument >> match.m_phoneNumber;
+    argument >> match.m_contactId;
+    argument >> match.m_displayLabel;
+    argument >> match.m_avatar;
+    argument >> match.m_matchedNumber;
+    argument >> match.m_matchType;
+    argument.endStructure();
+
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PhoneNumberMatchList &matches)
+{
+    argument.beginArray(qMetaTypeId<PhoneNumberMatch>());
+    for(int i=0; i < matches.count(); ++i) {
+        argument << matches[i];
+    }
+    argument.endArray();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PhoneNumberMatchList &matches)
+{
+    argument.beginArray();
+    matches.clear();
+    while(!argument.atEnd()) {
+        PhoneNumberMatch match;
+        argument >> match;
+        matches << match;
+    }
+    argument.endArray();
+    return argument;
+}
+
+} // namespace galera
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_PHONE_NUMBER_MATCH_H__
+#define __GALERA_PHONE_NUMBER_MATCH_H__
+
+#include <QtCore/QString>
+#include <QtDBus/QtDBus>
+
+namespace galera {
+
+// Contact found by a phone number lookup, used to identify the caller
+// without creating a view
+class PhoneNumberMatch
+{
+public:
+    PhoneNumberMatch();
+    PhoneNumberMatch(const QString &phoneNumber,
+                     const QString &contactId,
+                     const QString &displayLabel,
+                     const QString &avatar,
+                     const QString &matchedNumber,
+                     int matchType);
+    friend QDBusArgument &operator<<(QDBusArgument &argument, const PhoneNumberMatch &match);
+    friend const QDBusArgument &operator>>(const QDBusArgument &argument, PhoneNumberMatch &match);
+
+    static void registerMetaType();
+    // the phone number used in the lookup
+    QString phoneNumber() const;
+    QString contactId() const;
+    QString displayLabel() const;
+    QString avatar() const;
+    // the contact phone number that matches the lookup
+    QString matchedNumber() const;
+    // ParsedPhoneNumber::MatchType value
+    int matchType() const;
+
+private:
+    QString m_phoneNumber;
+    QString m_contactId;
+    QString m_displayLabel;
+    QString m_avatar;
+    QString m_matchedNumber;
+    int m_matchType;
+};
+
+typedef QList<PhoneNumberMatch> PhoneNumberMatchList;
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PhoneNumberMatchList &matches);
+const QDBusArgument &operator>>(const QDBusArgument &argument, PhoneNumberMatchList &matches);
+
+} // namespace galera
+
+Q_DECLARE_METATYPE(galera::PhoneNumberMatch)
+Q_DECLARE_METATYPE(galera::PhoneNumberMatchList)
+
+#endif
@@ -19,10 +19,14 @@
 #include "sort-clause.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QDateTime>
+#include <QtCore/QtEndian>
 #include <QtContacts/qcontactdetails.h>
 #include <QtContacts/QContactSortOrder>
 #include <QtContacts/QContactManagerEngine>
 
+#include <string.h>
+
 using namespace QtContacts;
 
 namespace galera
@@ -100,6 +104,124 @@ QList<QtContacts::QContactSortOrder> SortClause::toContactSortOrder() const
     return m_sortOrders;
 }
 
+QList<QContactDetail::DetailType> SortClause::detailTypes() const
+{
+    QList<QContactDetail::DetailType> types;
+    Q_FOREACH(const QContactSortOrder &sortOrder, m_sortOrders) {
+        if (!types.contains(sortOrder.detailType())) {
+            types << sortOrder.detailType();
+        }
+    }
+    return types;
+}
+
+QByteArray SortClause::sortKey(const QContact &contact) const
+{
+    QByteArray key;
+    Q_FOREACH(const QContactSortOrder &sortOrder, m_sortOrders) {
+        if (!sortOrder.isValid()) {
+            break;
+        }
+
+        // blanks are placed according to the blank policy, independent of the direction
+        QVariant value = contact.detail(sortOrder.detailType()).value(sortOrder.detailField());
+        if (value.isNull() ||
+            ((value.type() == QVariant::String) && value.toString().isEmpty())) {
+            key.append(sortOrder.blankPolicy() == QContactSortOrder::BlanksFirst ? '\x01' : '\x03');
+            continue;
+        }
+
+        QByteArray valueKey = valueSortKey(value, sortOrder.caseSensitivity());
+        if (sortOrder.direction() == Qt::DescendingOrder) {
+            for(int i = 0; i < valueKey.size(); i++) {
+                valueKey[i] = ~valueKey[i];
+            }
+        }
+        key.append('\x02');
+        key.append(valueKey);
+    }
+    return key;
+}
+
+int SortClause::compareSortKeys(const QByteArray &keyA, const QByteArray &keyB)
+{
+    int size = qMin(keyA.size(), keyB.size());
+    int r = memcmp(keyA.constData(), keyB.constData(), size);
+    if (r == 0) {
+        r = keyA.size() - keyB.size();
+    }
+    return r;
+}
+
+QByteArray SortClause::valueSortKey(const QVariant &value, Qt::CaseSensitivity sensitivity)
+{
+    // every value key is prefix free, this keeps the order of the next sort
+    // fields and allow to revert the order by inverting the bits
+    QByteArray key;
+    quint64 number;
+    switch(value.type()) {
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::LongLong:
+        number = quint64(value.toLongLong()) ^ Q_UINT64_C(0x8000000000000000);
+        break;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        number = value.toULongLong();
+        break;
+    case QVariant::Double:
+    {
+        double d = value.toDouble();
+        memcpy(&number, &d, sizeof(number));
+        number = (number & Q_UINT64_C(0x8000000000000000)) ? ~number : (number | Q_UINT64_C(0x8000000000000000));
+        break;
+    }
+    case QVariant::Date:
+        number = quint64(value.toDate().toJulianDay()) ^ Q_UINT64_C(0x8000000000000000);
+        break;
+    case QVariant::DateTime:
+        number = quint64(value.toDateTime().toMSecsSinceEpoch()) ^ Q_UINT64_C(0x8000000000000000);
+        break;
+    case QVariant::Time:
+        number = quint64(QTime(0, 0).msecsTo(value.toTime())) ^ Q_UINT64_C(0x8000000000000000);
+        break;
+    default:
+    {
+        // strxfrm keys follow strcoll, the code points break the ties; this is the
+        // order of QString::localeAwareCompare only on Qt builds without ICU
+        QString text = value.toString();
+        if (sensitivity == Qt::CaseInsensitive) {
+            text = text.toCaseFolded();
+        }
+
+        QByteArray local = text.toLocal8Bit();
+        size_t size = strxfrm(0, local.constData(), 0);
+        key.resize(int(size) + 1);
+        strxfrm(key.data(), local.constData(), size + 1);
+        key.resize(int(size));
+        key.append('\0');
+
+        for(int i = 0; i < text.size(); i++) {
+            ushort unicode = text.at(i).unicode();
+            char bytes[2] = { char(unicode >> 8), char(unicode & 0xff) };
+            for(int b = 0; b < 2; b++) {
+                key.append(bytes[b]);
+                if (bytes[b] == '\0') {
+                    key.append('\xff');
+                }
+            }
+        }
+        key.append('\0');
+        key.append('\0');
+        return key;
+    }
+    }
+
+    key.resize(sizeof(number));
+    qToBigEndian(number, reinterpret_cast<uchar*>(key.data()));
+    return key;
+}
+
 QStringList SortClause::supportedFields()
 {
     initialize();
@@ -21,7 +21,9 @@
 
 #include <QtCore/QString>
 #include <QtCore/QList>
+#include <QtCore/QByteArray>
 
+#include <QtContacts/QContact>
 #include <QtContacts/QContactSortOrder>
 
 namespace galera
@@ -38,7 +40,15 @@ public:
     bool isEmpty() const;
     QString toString() const;
     QList<QtContacts::QContactSortOrder> toContactSortOrder() const;
+    QList<QtContacts::QContactDetail::DetailType> detailTypes() const;
 
+    // binary key with the order of QContactManagerEngine::compareContact, except that
+    // strings follow the C library collation (strcoll) with the code points breaking
+    // ties, QString::localeAwareCompare uses ICU when Qt is built with it;
+    // keys can be compared with compareSortKeys
+    QByteArray sortKey(const QtContacts::QContact &contact) const;
+
+    static int compareSortKeys(const QByteArray &keyA, const QByteArray &keyB);
     static QStringList supportedFields();
 
 private:
@@ -47,6 +57,7 @@ private:
     QtContacts::QContactSortOrder fromString(const QString &clause) const;
     QString toString(const QtContacts::QContactSortOrder &sort) const;
     static void initialize();
+    static QByteArray valueSortKey(const QVariant &value, Qt::CaseSensitivity sensitivity);
 };
 
 }
@@ -17,9 +17,12 @@
  */
 
 #include "vcard-parser.h"
+#include "vcard-writer.h"
 
 #include <QtCore/QMimeDatabase>
 #include <QtCore/QMimeType>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
 
 #include <QtVersit/QVersitDocument>
 #include <QtVersit/QVersitWriter>
@@ -31,6 +34,9 @@
 #include <QtContacts/QContactDetail>
 #include <QtContacts/QContactExtendedDetail>
 
+// minimum number of vcards imported by each worker thread
+#define VCARD_IMPORT_MIN_CHUNK_SIZE     8
+
 using namespace QtVersit;
 using namespace QtContacts;
 
@@ -270,6 +276,71 @@ namespace
 namespace galera
 {
 
+class VCardImportTask : public QRunnable
+{
+public:
+    VCardImportTask(VCardParser *parser, const QStringList &vcards)
+        : m_parser(parser),
+          m_vcards(vcards),
+          m_failed(false)
+    {
+        setAutoDelete(false);
+    }
+
+    QList<QContact> contacts() const
+    {
+        return m_contacts;
+    }
+
+    bool failed() const
+    {
+        return m_failed;
+    }
+
+protected:
+    void run()
+    {
+        // a chunk must produce one contact per vcard, otherwise import one
+        // vcard at a time to keep the result aligned with the input
+        if (!import(m_vcards, &m_contacts) || (m_contacts.size() != m_vcards.size())) {
+            m_contacts.clear();
+            Q_FOREACH(const QString &vcard, m_vcards) {
+                QList<QContact> contacts;
+                if (!import(QStringList() << vcard, &contacts) || (contacts.size() != 1)) {
+                    m_contacts.clear();
+                    m_failed = true;
+                    break;
+                }
+                m_contacts += contacts;
+            }
+        }
+        m_parser->importTaskDone();
+    }
+
+private:
+    VCardParser *m_parser;
+    QStringList m_vcards;
+    QList<QContact> m_contacts;
+    bool m_failed;
+
+    static bool import(const QStringList &vcards, QList<QContact> *contacts)
+    {
+        QVersitReader reader(vcards.join("\r\n").toUtf8());
+        if (!reader.startReading() || !reader.waitForFinished()) {
+            return false;
+        }
+
+        ContactImporterPropertyHandler handler;
+        QVersitContactImporter contactImporter;
+        contactImporter.setPropertyHandler(&handler);
+        if (!contactImporter.importDocuments(reader.results())) {
+            return false;
+        }
+        *contacts = contactImporter.contacts();
+        return true;
+    }
+};
+
 const QString VCardParser::PidMapFieldName = QStringLiteral("CLIENTPIDMAP");
 const QString VCardParser::PidFieldName = QStringLiteral("PID");
 const QString VCardParser::PrefParamName = QStringLiteral("PREF");
@@ -296,7 +367,10 @@ const QMap<QtContacts::QContactDetail::DetailType, QString> VCardParser::Preferr
 VCardParser::VCardParser(QObject *parent)
     : QObject(parent),
       m_versitWriter(0),
-      m_versitReader(0)
+      m_versitReader(0),
+      m_directWriterEnabled(true),
+      m_runningImports(0),
+      m_importCanceled(false)
 {
     m_exporterHandler = new ContactExporterDetailHandler;
     m_importerHandler = new ContactImporterPropertyHandler;
@@ -305,6 +379,7 @@ VCardParser::VCardParser(QObject *parent)
 VCardParser::~VCardParser()
 {
     waitForFinished();
+    qDeleteAll(m_importTasks);
 
     delete m_exporterHandler;
     delete m_importerHandler;
@@ -326,13 +401,30 @@ QtContacts::QContact VCardParser::vcardToContact(const QString &vcard)
 
 void VCardParser::vcardToContact(const QStringList &vcardList)
 {
-    if (m_versitReader) {
+    if (m_versitReader || !m_importTasks.isEmpty()) {
         qWarning() << "Import operation in progress.";
         return;
     }
     m_vcardsResult.clear();
     m_contactsResult.clear();
 
+    // split big lists into chunks imported in parallel, the results are
+    // merged in the original order by onImportFinished
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int chunks = qMin(pool->maxThreadCount(), vcardList.size() / VCARD_IMPORT_MIN_CHUNK_SIZE);
+    if (chunks > 1) {
+        int chunkSize = (vcardList.size() + chunks - 1) / chunks;
+        for(int i = 0; i < vcardList.size(); i += chunkSize) {
+            m_importTasks << new VCardImportTask(this, vcardList.mid(i, chunkSize));
+        }
+        m_importCanceled = false;
+        m_runningImports = m_importTasks.size();
+        Q_FOREACH(VCardImportTask *task, m_importTasks) {
+            pool->start(task);
+        }
+        return;
+    }
+
     QString vcards = vcardList.join("\r\n");
     m_versitReader = new QVersitReader(vcards.toUtf8());
     connect(m_versitReader,
@@ -346,6 +438,11 @@ void VCardParser::vcardToContact(const QStringList &vcardList)
 
 void VCardParser::cancel()
 {
+    // running import tasks can not be interrupted, just ignore the result
+    if (!m_importTasks.isEmpty()) {
+        m_importCanceled = true;
+    }
+
     if (m_versitReader) {
         m_versitReader->disconnect(this);
         m_versitReader->cancel();
@@ -372,10 +469,21 @@ void VCardParser::waitForFinished()
         m_versitWriter->waitForFinished();
     }
 
+    m_importLock.lock();
+    while (m_runningImports > 0) {
+        m_importDone.wait(&m_importLock);
+    }
+    m_importLock.unlock();
+
     // wait state changed events to arrive
     QCoreApplication::sendPostedEvents(this);
 }
 
+void VCardParser::setDirectWriterEnabled(bool enabled)
+{
+    m_directWriterEnabled = enabled;
+}
+
 QStringList VCardParser::vcardResult() const
 {
     return m_vcardsResult;
@@ -391,6 +499,44 @@ void VCardParser::onReaderResultsAvailable()
     //NOTHING FOR NOW
 }
 
+void VCardParser::importTaskDone()
+{
+    // called from the worker threads
+    QMutexLocker locker(&m_importLock);
+    m_runningImports--;
+    if (m_runningImports == 0) {
+        m_importDone.wakeAll();
+        QMetaObject::invokeMethod(this, "onImportFinished", Qt::QueuedConnection);
+    }
+}
+
+void VCardParser::onImportFinished()
+{
+    if (m_importTasks.isEmpty()) {
+        return;
+    }
+
+    QList<QContact> contacts;
+    bool failed = false;
+    Q_FOREACH(VCardImportTask *task, m_importTasks) {
+        contacts += task->contacts();
+        failed |= task->failed();
+    }
+    qDeleteAll(m_importTasks);
+    m_importTasks.clear();
+
+    // like the sequential import, a failure does not produce a partial result
+    if (failed) {
+        qWarning() << "Fail to import contacts";
+        return;
+    }
+
+    if (!m_importCanceled) {
+        m_contactsResult = contacts;
+        Q_EMIT contactsParsed(contacts);
+    }
+}
+
 QStringList VCardParser::splitVcards(const QByteArray &vcardList)
 {
     QStringList result;
@@ -437,11 +583,46 @@ void VCardParser::contactToVcard(QList<QtContacts::QContact> contacts)
     }
     m_vcardsResult.clear();
     m_contactsResult.clear();
+    m_vcardData.clear();
+    m_versitIndexes.clear();
+
+    // write the contacts that we know how to serialize directly and only
+    // use QtVersit for the remaining ones
+    QList<QContact> directContacts;
+    QList<QContact> versitContacts;
+    for(int i = 0; i < contacts.size(); i++) {
+        const QContact &contact = contacts.at(i);
+        if (m_directWriterEnabled && VCardWriter::canWrite(contact)) {
+            directContacts << contact;
+        } else {
+            versitContacts << contact;
+            m_versitIndexes << i;
+        }
+    }
+
+    VCardWriter writer;
+    writer.write(directContacts);
+    for(int i = 0, d = 0, v = 0; i < contacts.size(); i++) {
+        if ((v < m_versitIndexes.size()) && (m_versitIndexes.at(v) == i)) {
+            // filled by onWriterStateChanged
+            m_vcardsResult << QString();
+            v++;
+        } else {
+            m_vcardsResult << writer.vcard(d++);
+        }
+    }
+
+    if (versitContacts.isEmpty()) {
+        QMetaObject::invokeMethod(this, "vcardParsed", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, m_vcardsResult));
+        return;
+    }
 
     QVersitContactExporter exporter;
     exporter.setDetailHandler(m_exporterHandler);
-    if (!exporter.exportContacts(contacts, QVersitDocument::VCard30Type)) {
+    if (!exporter.exportContacts(versitContacts, QVersitDocument::VCard30Type)) {
         qWarning() << "Fail to export contacts" << exporter.errors();
+        m_vcardsResult.clear();
         return;
     }
 
@@ -456,8 +637,10 @@ void VCardParser::onWriterStateChanged(QVersitWriter::State state)
 {
     if (state == QVersitWriter::FinishedState) {
         QStringList vcards = VCardParser::splitVcards(m_vcardData);
-        m_vcardsResult = vcards;
-        Q_EMIT vcardParsed(vcards);
+        for(int i = 0; i < m_versitIndexes.size(); i++) {
+            m_vcardsResult[m_versitIndexes.at(i)] = vcards.value(i);
+        }
+        Q_EMIT vcardParsed(m_vcardsResult);
         delete m_versitWriter;
         m_versitWriter = 0;
     }
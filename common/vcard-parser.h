@@ -22,6 +22,8 @@
 #include <QtCore/QObject>
 #include <QtCore/QStringList>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
 
 #include <QtContacts/QtContacts>
 
@@ -36,6 +38,8 @@ namespace galera
 
 using namespace QtVersit;
 
+class VCardImportTask;
+
 class VCardParser : public QObject
 {
     Q_OBJECT
@@ -47,6 +51,7 @@ public:
     void vcardToContact(const QStringList &vcardList);
     void cancel();
     void waitForFinished();
+    void setDirectWriterEnabled(bool enabled);
 
     QStringList vcardResult() const;
     QList<QtContacts::QContact> contactsResult() const;
@@ -76,6 +81,7 @@ private Q_SLOTS:
     void onWriterStateChanged(QVersitWriter::State state);
     void onReaderStateChanged(QVersitReader::State state);
     void onReaderResultsAvailable();
+    void onImportFinished();
 
 private:
     QtVersit::QVersitWriter *m_versitWriter;
@@ -85,7 +91,21 @@ private:
 
     QByteArray m_vcardData;
     QStringList m_vcardsResult;
+    // contacts exported with QtVersit because VCardWriter can not handle them
+    QList<int> m_versitIndexes;
+    bool m_directWriterEnabled;
     QList<QtContacts::QContact> m_contactsResult;
+
+    // parallel import
+    QList<VCardImportTask*> m_importTasks;
+    QMutex m_importLock;
+    QWaitCondition m_importDone;
+    int m_runningImports;
+    bool m_importCanceled;
+
+    void importTaskDone();
+
+    friend class VCardImportTask;
 };
 
 }
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vcard-writer.h"
+#include "vcard-parser.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QUrl>
+
+#include <QtContacts/QContactAddress>
+#include <QtContacts/QContactAvatar>
+#include <QtContacts/QContactBirthday>
+#include <QtContacts/QContactDisplayLabel>
+#include <QtContacts/QContactEmailAddress>
+#include <QtContacts/QContactExtendedDetail>
+#include <QtContacts/QContactFavorite>
+#include <QtContacts/QContactGuid>
+#include <QtContacts/QContactName>
+#include <QtContacts/QContactNickname>
+#include <QtContacts/QContactNote>
+#include <QtContacts/QContactPhoneNumber>
+#include <QtContacts/QContactSyncTarget>
+#include <QtContacts/QContactTag>
+#include <QtContacts/QContactTimestamp>
+#include <QtContacts/QContactType>
+#include <QtContacts/QContactUrl>
+
+// lines are folded at 76 octets, never inside a UTF-8 sequence
+#define VCARD_MAX_LINE_LENGTH   76
+// average size of a exported contact, used to preallocate the output buffer
+#define VCARD_AVERAGE_SIZE      512
+
+using namespace QtContacts;
+
+namespace
+{
+
+// same mappings used by the QtVersit exporter
+QString contextName(int context)
+{
+    switch (context) {
+    case QContactDetail::ContextHome:
+        return QStringLiteral("HOME");
+    case QContactDetail::ContextWork:
+        return QStringLiteral("WORK");
+    default:
+        return QString();
+    }
+}
+
+QString phoneSubTypeName(int subType)
+{
+    switch (subType) {
+    case QContactPhoneNumber::SubTypeLandline:
+        return QStringLiteral("ISDN");
+    case QContactPhoneNumber::SubTypeMobile:
+        return QStringLiteral("CELL");
+    case QContactPhoneNumber::SubTypeFax:
+        return QStringLiteral("FAX");
+    case QContactPhoneNumber::SubTypePager:
+        return QStringLiteral("PAGER");
+    case QContactPhoneNumber::SubTypeVoice:
+        return QStringLiteral("VOICE");
+    case QContactPhoneNumber::SubTypeModem:
+        return QStringLiteral("MODEM");
+    case QContactPhoneNumber::SubTypeVideo:
+        return QStringLiteral("VIDEO");
+    case QContactPhoneNumber::SubTypeCar:
+        return QStringLiteral("CAR");
+    case QContactPhoneNumber::SubTypeBulletinBoardSystem:
+        return QStringLiteral("BBS");
+    case QContactPhoneNumber::SubTypeMessagingCapable:
+        return QStringLiteral("MSG");
+    default:
+        return QString();
+    }
+}
+
+QString addressSubTypeName(int subType)
+{
+    switch (subType) {
+    case QContactAddress::SubTypeDomestic:
+        return QStringLiteral("DOM");
+    case QContactAddress::SubTypeInternational:
+        return QStringLiteral("INTL");
+    case QContactAddress::SubTypePostal:
+        return QStringLiteral("POSTAL");
+    case QContactAddress::SubTypeParcel:
+        return QStringLiteral("PARCEL");
+    default:
+        return QString();
+    }
+}
+
+bool isRemoteAvatar(const QUrl &url)
+{
+    return url.isValid() &&
+           !url.isLocalFile() &&
+           !url.host().isEmpty() &&
+           ((url.scheme() == QStringLiteral("http")) ||
+            (url.scheme() == QStringLiteral("https")));
+}
+
+QString dateTimeToString(const QDateTime &dateTime)
+{
+    QString value = dateTime.toString(Qt::ISODate);
+    if ((dateTime.timeSpec() == Qt::UTC) &&
+        !value.endsWith(QLatin1Char('Z'), Qt::CaseInsensitive)) {
+        value += QLatin1Char('Z');
+    }
+    return value;
+}
+
+}
+
+namespace galera
+{
+
+VCardWriter::VCardWriter()
+{
+}
+
+bool VCardWriter::canWrite(const QContact &contact)
+{
+    int nicknames = 0;
+    int tags = 0;
+
+    Q_FOREACH(const QContactDetail &detail, contact.details()) {
+        switch (detail.type()) {
+        case QContactDetail::TypeType:
+            if (contact.type() != QContactType::TypeContact) {
+                return false;
+            }
+            break;
+        case QContactDetail::TypeGuid:
+        case QContactDetail::TypeFavorite:
+        case QContactDetail::TypeSyncTarget:
+        case QContactDetail::TypeNote:
+        case QContactDetail::TypeTimestamp:
+            break;
+        case QContactDetail::TypeName:
+            if (!detail.value(QContactName::FieldCustomLabel).toString().isEmpty()) {
+                return false;
+            }
+            break;
+        case QContactDetail::TypeDisplayLabel:
+            if (detail.value(QContactDisplayLabel::FieldLabel).toString().isEmpty()) {
+                return false;
+            }
+            break;
+        case QContactDetail::TypeEmailAddress:
+        case QContactDetail::TypeUrl:
+        case QContactDetail::TypePhoneNumber:
+        case QContactDetail::TypeAddress:
+        {
+            bool ok = true;
+            types(detail, &ok);
+            if (!ok) {
+                return false;
+            }
+            break;
+        }
+        case QContactDetail::TypeBirthday:
+        {
+            QVariant bday = detail.value(QContactBirthday::FieldBirthday);
+            if (detail.hasValue(QContactBirthday::FieldCalendarType) ||
+                ((bday.type() != QVariant::Date) && (bday.type() != QVariant::DateTime))) {
+                return false;
+            }
+            break;
+        }
+        case QContactDetail::TypeNickname:
+            if ((++nicknames > 1) ||
+                detail.value(QContactNickname::FieldNickname).toString().isEmpty()) {
+                return false;
+            }
+            break;
+        case QContactDetail::TypeTag:
+            if ((++tags > 1) ||
+                detail.value(QContactTag::FieldTag).toString().isEmpty()) {
+                return false;
+            }
+            break;
+        case QContactDetail::TypeExtendedDetail:
+        {
+            QVariant data = detail.value(QContactExtendedDetail::FieldData);
+            if (detail.value(QContactExtendedDetail::FieldName).toString().isEmpty() ||
+                (data.isValid() && (data.type() != QVariant::String))) {
+                return false;
+            }
+            break;
+        }
+        case QContactDetail::TypeAvatar:
+            if (!isRemoteAvatar(detail.value<QUrl>(QContactAvatar::FieldImageUrl))) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+void VCardWriter::write(const QList<QContact> &contacts)
+{
+    m_data.reserve(m_data.size() + (contacts.size() * VCARD_AVERAGE_SIZE));
+    m_slices.reserve(m_slices.size() + contacts.size());
+
+    Q_FOREACH(const QContact &contact, contacts) {
+        write(contact);
+    }
+}
+
+void VCardWriter::write(const QContact &contact)
+{
+    int offset = m_data.size();
+    bool hasName = false;
+    QContactDetail preferredPhone =
+            contact.preferredDetail(VCardParser::PreferredActionNames[QContactDetail::TypePhoneNumber]);
+
+    m_data.append("BEGIN:VCARD\r\nVERSION:3.0\r\n");
+    Q_FOREACH(const QContactDetail &detail, contact.details()) {
+        writeDetail(detail, preferredPhone, &hasName);
+    }
+
+    // QtVersit requires at least one name property
+    if (!hasName) {
+        m_value.clear();
+        writeProperty(QStringLiteral("FN"), QContactDetail());
+    }
+
+    // translate contact id to uid vcard
+    if (!contact.id().isNull() &&
+        contact.details<QContactGuid>().isEmpty()) {
+        m_value.clear();
+        appendValue(contact.id().toString().split("::").last());
+        writeProperty(QStringLiteral("UID"), QContactDetail());
+    }
+    m_data.append("END:VCARD\r\n");
+
+    m_slices << qMakePair(offset, m_data.size() - offset);
+}
+
+void VCardWriter::clear()
+{
+    m_data.clear();
+    m_slices.clear();
+}
+
+int VCardWriter::count() const
+{
+    return m_slices.size();
+}
+
+QString VCardWriter::vcard(int index) const
+{
+    const QPair<int, int> &slice = m_slices.at(index);
+    return QString::fromUtf8(m_data.constData() + slice.first, slice.second);
+}
+
+QStringList VCardWriter::vcards() const
+{
+    QStringList result;
+    result.reserve(m_slices.size());
+    for(int i = 0; i < m_slices.size(); i++) {
+        result << vcard(i);
+    }
+    return result;
+}
+
+void VCardWriter::writeDetail(const QContactDetail &detail,
+                              const QContactDetail &preferredPhone,
+                              bool *hasName)
+{
+    m_value.clear();
+
+    switch (detail.type()) {
+    case QContactDetail::TypeName:
+    {
+        QContactName name(detail);
+        if (name.lastName().isEmpty() && name.firstName().isEmpty() &&
+            name.middleName().isEmpty() && name.prefix().isEmpty() &&
+            name.suffix().isEmpty()) {
+            break;
+        }
+        appendCompoundValue(QStringList() << name.lastName()
+                                          << name.firstName()
+                                          << name.middleName()
+                                          << name.prefix()
+                                          << name.suffix());
+        writeProperty(QStringLiteral("N"), detail);
+        *hasName = true;
+        break;
+    }
+    case QContactDetail::TypeDisplayLabel:
+        appendValue(detail.value(QContactDisplayLabel::FieldLabel).toString());
+        writeProperty(QStringLiteral("FN"), detail);
+        *hasName = true;
+        break;
+    case QContactDetail::TypeGuid:
+        appendValue(detail.value(QContactGuid::FieldGuid).toString());
+        writeProperty(QStringLiteral("UID"), detail);
+        break;
+    case QContactDetail::TypeFavorite:
+    {
+        QContactFavorite favorite(detail);
+        appendCompoundValue(QStringList() << (favorite.isFavorite() ? QStringLiteral("true") : QStringLiteral("false"))
+                                          << QString::number(favorite.index()));
+        writeProperty(QStringLiteral("X-QTPROJECT-FAVORITE"), detail);
+        break;
+    }
+    case QContactDetail::TypeEmailAddress:
+        appendValue(detail.value(QContactEmailAddress::FieldEmailAddress).toString());
+        writeProperty(QStringLiteral("EMAIL"), detail, types(detail));
+        break;
+    case QContactDetail::TypeUrl:
+        appendValue(detail.value(QContactUrl::FieldUrl).toString());
+        writeProperty(QStringLiteral("URL"), detail, types(detail));
+        break;
+    case QContactDetail::TypePhoneNumber:
+        appendValue(detail.value(QContactPhoneNumber::FieldNumber).toString());
+        writeProperty(QStringLiteral("TEL"), detail, types(detail), (detail == preferredPhone));
+        break;
+    case QContactDetail::TypeAddress:
+    {
+        QContactAddress address(detail);
+        appendCompoundValue(QStringList() << address.postOfficeBox()
+                                          << QString()
+                                          << address.street()
+                                          << address.locality()
+                                          << address.region()
+                                          << address.postcode()
+                                          << address.country());
+        writeProperty(QStringLiteral("ADR"), detail, types(detail));
+        break;
+    }
+    case QContactDetail::TypeBirthday:
+    {
+        QVariant bday = detail.value(QContactBirthday::FieldBirthday);
+        if (bday.type() == QVariant::Date) {
+            appendValue(bday.toDate().toString(Qt::ISODate));
+        } else {
+            appendValue(bday.toDateTime().toString(Qt::ISODate));
+        }
+        writeProperty(QStringLiteral("BDAY"), detail);
+        break;
+    }
+    case QContactDetail::TypeNickname:
+        appendValue(detail.value(QContactNickname::FieldNickname).toString());
+        writeProperty(QStringLiteral("NICKNAME"), detail);
+        break;
+    case QContactDetail::TypeTag:
+        appendValue(detail.value(QContactTag::FieldTag).toString());
+        writeProperty(QStringLiteral("CATEGORIES"), detail);
+        break;
+    case QContactDetail::TypeNote:
+        appendValue(detail.value(QContactNote::FieldNote).toString());
+        writeProperty(QStringLiteral("NOTE"), detail);
+        break;
+    case QContactDetail::TypeTimestamp:
+    {
+        QContactTimestamp timestamp(detail);
+        QDateTime rev = timestamp.lastModified().isValid() ? timestamp.lastModified() : timestamp.created();
+        if (!rev.isValid()) {
+            break;
+        }
+        appendValue(dateTimeToString(rev));
+        writeProperty(QStringLiteral("REV"), detail);
+        break;
+    }
+    case QContactDetail::TypeAvatar:
+    {
+        QUrl url = detail.value<QUrl>(QContactAvatar::FieldImageUrl);
+        appendValue(url.toString(QUrl::RemoveUserInfo));
+        writeProperty(QStringLiteral("PHOTO"), detail, QStringList(), false,
+                      QStringLiteral("URL,URL"));
+        break;
+    }
+    case QContactDetail::TypeSyncTarget:
+        appendCompoundValue(QStringList() << detail.value(QContactSyncTarget::FieldSyncTarget).toString()
+                                          << detail.value(QContactSyncTarget::FieldSyncTarget + 1).toString()
+                                          << detail.value(QContactSyncTarget::FieldSyncTarget + 2).toString());
+        writeProperty(VCardParser::PidMapFieldName, detail);
+        break;
+    case QContactDetail::TypeExtendedDetail:
+        appendValue(detail.value(QContactExtendedDetail::FieldData).toString());
+        writeProperty(detail.value(QContactExtendedDetail::FieldName).toString(), detail);
+        break;
+    default:
+        break;
+    }
+}
+
+void VCardWriter::writeProperty(const QString &name,
+                                const QContactDetail &detail,
+                                const QStringList &types,
+                                bool preferred,
+                                const QString &valueParam)
+{
+    QContactDetail::AccessConstraints constraints = detail.accessConstraints();
+
+    // parameters are written in alphabetical order
+    m_line.clear();
+    m_line += name;
+    if (constraints.testFlag(QContactDetail::Irremovable)) {
+        m_line += QLatin1Char(';');
+        m_line += VCardParser::IrremovableFieldName;
+        m_line += QStringLiteral("=YES");
+    }
+    if (!detail.detailUri().isEmpty()) {
+        m_line += QLatin1Char(';');
+        m_line += VCardParser::PidFieldName;
+        m_line += QLatin1Char('=');
+        escape(detail.detailUri(), &m_line);
+    }
+    if (preferred) {
+        m_line += QLatin1Char(';');
+        m_line += VCardParser::PrefParamName;
+        m_line += QStringLiteral("=1");
+    }
+    if (constraints.testFlag(QContactDetail::ReadOnly)) {
+        m_line += QLatin1Char(';');
+        m_line += VCardParser::ReadOnlyFieldName;
+        m_line += QStringLiteral("=YES");
+    }
+    if (!types.isEmpty()) {
+        m_line += QStringLiteral(";TYPE=");
+        m_line += types.join(QLatin1Char(','));
+    }
+    if (!valueParam.isEmpty()) {
+        m_line += QStringLiteral(";VALUE=");
+        m_line += valueParam;
+    }
+    m_line += QLatin1Char(':');
+    m_line += m_value;
+
+    writeLine(m_line);
+}
+
+void VCardWriter::writeLine(const QString &line)
+{
+    const QByteArray data = line.toUtf8();
+    int pos = 0;
+    int chunkSize = VCARD_MAX_LINE_LENGTH;
+
+    // fold long lines, continuation lines start with a space
+    while ((data.size() - pos) > chunkSize) {
+        int end = pos + chunkSize;
+        // move back to the first byte of the sequence, code points are never split
+        while ((end > pos) && ((data.at(end) & 0xC0) == 0x80)) {
+            end--;
+        }
+        m_data.append(data.constData() + pos, end - pos);
+        m_data.append("\r\n ");
+        pos = end;
+        chunkSize = VCARD_MAX_LINE_LENGTH - 1;
+    }
+    m_data.append(data.constData() + pos, data.size() - pos);
+    m_data.append("\r\n");
+}
+
+void VCardWriter::appendValue(const QString &value)
+{
+    escape(value, &m_value);
+}
+
+void VCardWriter::appendCompoundValue(const QStringList &values)
+{
+    for(int i = 0; i < values.size(); i++) {
+        if (i > 0) {
+            m_value += QLatin1Char(';');
+        }
+        escape(values.at(i), &m_value);
+    }
+}
+
+void VCardWriter::escape(const QString &text, QString *out)
+{
+    const QChar *data = text.constData();
+    const int size = text.size();
+
+    for(int i = 0; i < size; i++) {
+        const QChar c = data[i];
+        switch (c.unicode()) {
+        case '\\':
+        case ';':
+        case ',':
+            *out += QLatin1Char('\\');
+            *out += c;
+            break;
+        case '\r':
+            // CRLF is written as a single line break
+            if (((i + 1) < size) && (data[i + 1] == QLatin1Char('\n'))) {
+                i++;
+            }
+            *out += QStringLiteral("\\n");
+            break;
+        case '\n':
+            *out += QStringLiteral("\\n");
+            break;
+        default:
+            *out += c;
+        }
+    }
+}
+
+QStringList VCardWriter::types(const QContactDetail &detail, bool *ok)
+{
+    QStringList result;
+    bool valid = true;
+
+    Q_FOREACH(int context, detail.value<QList<int> >(QContactDetail::FieldContext)) {
+        QString name = contextName(context);
+        if (name.isEmpty()) {
+            valid = false;
+        } else {
+            result << name;
+        }
+    }
+
+    QList<int> subTypes;
+    switch (detail.type()) {
+    case QContactDetail::TypePhoneNumber:
+        subTypes = detail.value<QList<int> >(QContactPhoneNumber::FieldSubTypes);
+        Q_FOREACH(int subType, subTypes) {
+            QString name = phoneSubTypeName(subType);
+            if (name.isEmpty()) {
+                valid = false;
+            } else {
+                result << name;
+            }
+        }
+        break;
+    case QContactDetail::TypeAddress:
+        subTypes = detail.value<QList<int> >(QContactAddress::FieldSubTypes);
+        Q_FOREACH(int subType, subTypes) {
+            QString name = addressSubTypeName(subType);
+            if (name.isEmpty()) {
+                valid = false;
+            } else {
+                result << name;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (ok) {
+        *ok = valid;
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_VCARD_WRITER_H__
+#define __GALERA_VCARD_WRITER_H__
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <QtContacts/QContact>
+#include <QtContacts/QContactDetail>
+
+namespace galera
+{
+
+// Serializes contacts straight into vCard 3.0 text, producing the same
+// output as the QtVersit exporter used by VCardParser. Only the details
+// created by the service are supported, use canWrite() to check a contact
+// before writing it.
+class VCardWriter
+{
+public:
+    VCardWriter();
+
+    static bool canWrite(const QtContacts::QContact &contact);
+
+    void write(const QList<QtContacts::QContact> &contacts);
+    void write(const QtContacts::QContact &contact);
+    void clear();
+
+    int count() const;
+    QString vcard(int index) const;
+    QStringList vcards() const;
+
+private:
+    QByteArray m_data;
+    QList<QPair<int, int> > m_slices;
+    QString m_line;
+    QString m_value;
+
+    void writeDetail(const QtContacts::QContactDetail &detail,
+                     const QtContacts::QContactDetail &preferredPhone,
+                     bool *hasName);
+    void writeProperty(const QString &name,
+                       const QtContacts::QContactDetail &detail,
+                       const QStringList &types = QStringList(),
+                       bool preferred = false,
+                       const QString &valueParam = QString());
+    void writeLine(const QString &line);
+
+    void appendValue(const QString &value);
+    void appendCompoundValue(const QStringList &values);
+
+    static void escape(const QString &text, QString *out);
+    static QStringList types(const QtContacts::QContactDetail &detail, bool *ok = 0);
+};
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include "qcontactsaverequest-data.h"
 
 #include "common/vcard-parser.h"
+#include "common/contact-codec.h"
 #include "common/filter.h"
 #include "common/fetch-hint.h"
 #include "common/sort-clause.h"
@@ -37,6 +38,7 @@
 #include <QtDBus/QDBusMessage>
 #include <QtDBus/QDBusPendingCallWatcher>
 #include <QtDBus/QDBusPendingReply>
+#include <QtDBus/QDBusReply>
 #include <QtDBus/QDBusConnectionInterface>
 
 #include <QtContacts/QContact>
@@ -53,6 +55,9 @@
 
 #define ALTERNATIVE_CPIM_SERVICE_PAGE_SIZE  "CANONICAL_PIM_SERVICE_PAGE_SIZE"
 #define FETCH_PAGE_SIZE                     25
+// contacts sent on each 'createContacts' call, the server replies after all
+// of them are created and the call must finish before the D-Bus timeout
+#define CREATE_CONTACTS_BATCH_SIZE          100
 
 using namespace QtVersit;
 using namespace QtContacts;
@@ -62,6 +67,9 @@ namespace galera
 GaleraContactsService::GaleraContactsService(const QString &managerUri)
     : m_managerUri(managerUri),
       m_serviceIsReady(false),
+      m_serviceIsQueryReady(false),
+      m_binaryDetails(false),
+      m_batchCreate(false),
       m_iface(0)
 {
     Source::registerMetaType();
@@ -124,8 +132,11 @@ void GaleraContactsService::serviceOwnerChanged(const QString &name, const QStri
 void GaleraContactsService::onServiceReady()
 {
     bool isReady = m_iface.data()->property("isReady").toBool();
-    if (isReady != m_serviceIsReady) {
+    // old services do not implement "isQueryReady"
+    bool isQueryReady = m_iface.data()->property("isQueryReady").toBool();
+    if ((isReady != m_serviceIsReady) || (isQueryReady != m_serviceIsQueryReady)) {
         m_serviceIsReady = isReady;
+        m_serviceIsQueryReady = isQueryReady;
         Q_EMIT serviceChanged();
     }
 }
@@ -138,12 +149,20 @@ void GaleraContactsService::initialize()
                                                                     CPIM_ADDRESSBOOK_IFACE_NAME));
         if (!m_iface->lastError().isValid()) {
             m_serviceIsReady = m_iface.data()->property("isReady").toBool();
+            m_serviceIsQueryReady = m_iface.data()->property("isQueryReady").toBool();
+            // old services do not implement "capabilities"
+            QDBusReply<QStringList> capabilities = m_iface->call("capabilities");
+            m_binaryDetails = capabilities.isValid() &&
+                              capabilities.value().contains(CPIM_CAPABILITY_BINARY_DETAILS);
+            m_batchCreate = capabilities.isValid() &&
+                            capabilities.value().contains(CPIM_CAPABILITY_BATCH_CREATE);
             connect(m_iface.data(), SIGNAL(readyChanged()), this, SLOT(onServiceReady()), Qt::UniqueConnection);
+            connect(m_iface.data(), SIGNAL(queryReadyChanged()), this, SLOT(onServiceReady()), Qt::UniqueConnection);
             connect(m_iface.data(), SIGNAL(safeModeChanged()), this, SIGNAL(serviceChanged()));
             connect(m_iface.data(), SIGNAL(contactsAdded(QStringList)), this, SLOT(onContactsAdded(QStringList)));
             connect(m_iface.data(), SIGNAL(contactsRemoved(QStringList)), this, SLOT(onContactsRemoved(QStringList)));
             connect(m_iface.data(), SIGNAL(contactsUpdated(QStringList)), this, SLOT(onContactsUpdated(QStringList)));
-            if (m_serviceIsReady) {
+            if (m_serviceIsReady || m_serviceIsQueryReady) {
                 Q_EMIT serviceChanged();
             }
         } else {
@@ -167,8 +186,10 @@ void GaleraContactsService::deinitialize()
         qWarning() << m_iface->lastError();
         m_iface.clear();
         m_serviceIsReady = false;
+        m_serviceIsQueryReady = false;
     } else {
         m_serviceIsReady = m_iface.data()->property("isReady").toBool();
+        m_serviceIsQueryReady = m_iface.data()->property("isQueryReady").toBool();
     }
 
     Q_EMIT serviceChanged();
@@ -179,6 +200,12 @@ bool GaleraContactsService::isOnline() const
     return !m_iface.isNull() && m_serviceIsReady;
 }
 
+bool GaleraContactsService::canQuery() const
+{
+    // the service answers queries from its contacts snapshot before it is ready
+    return !m_iface.isNull() && (m_serviceIsReady || m_serviceIsQueryReady);
+}
+
 void GaleraContactsService::fetchCollections(QContactCollectionFetchRequest *request)
 {
     if (!isOnline()) {
@@ -235,7 +262,7 @@ void GaleraContactsService::fetchCollectionsContinue(QContactCollectionFetchRequ
 
 void GaleraContactsService::fetchContactsById(QtContacts::QContactFetchByIdRequest *request)
 {
-    if (!isOnline()) {
+    if (!canQuery()) {
         qWarning() << "Server is not online";
         QContactFetchByIdRequestData::notifyError(request);
         return;
@@ -267,7 +294,7 @@ void GaleraContactsService::fetchContactsById(QtContacts::QContactFetchByIdReque
 
 void GaleraContactsService::fetchContacts(QtContacts::QContactFetchRequest *request)
 {
-    if (!isOnline()) {
+    if (!canQuery()) {
         qWarning() << "Server is not online";
         QContactFetchRequestData::notifyError(request);
         return;
@@ -353,13 +380,13 @@ void GaleraContactsService::fetchContactsContinue(QContactFetchRequestData *data
 
 void GaleraContactsService::fetchContactsPage(QContactFetchRequestData *data)
 {
-    if (!isOnline() || !data->isLive()) {
+    if (!canQuery() || !data->isLive()) {
         destroyRequest(data);
         return;
     }
 
     // Load contacs async
-    QDBusPendingCall pcall = data->view()->asyncCall("contactsDetails",
+    QDBusPendingCall pcall = data->view()->asyncCall(contactsDetailsMethod(),
                                                      data->fields(),
                                                      data->offset(),
                                                      m_pageSize);
@@ -378,6 +405,21 @@ void GaleraContactsService::fetchContactsPage(QContactFetchRequestData *data)
                      });
 }
 
+void GaleraContactsService::prefetchContactsPage(QContactFetchRequestData *data)
+{
+    QDBusPendingCall pcall = data->view()->asyncCall(contactsDetailsMethod(),
+                                                     data->fields(),
+                                                     data->offset() + m_pageSize,
+                                                     m_pageSize);
+    if (pcall.isError()) {
+        // the page will be requested again by fetchContactsPage
+        qWarning() << pcall.error().name() << pcall.error().message();
+        return;
+    }
+
+    data->setNextPageWatcher(new QDBusPendingCallWatcher(pcall, 0));
+}
+
 void GaleraContactsService::fetchContactsDone(QContactFetchRequestData *data,
                                               QDBusPendingCallWatcher *call)
 {
@@ -386,16 +428,37 @@ void GaleraContactsService::fetchContactsDone(QContactFetchRequestData *data,
         return;
     }
 
-    QDBusPendingReply<QStringList> reply = *call;
-    if (reply.isError()) {
-        qWarning() << reply.error().name() << reply.error().message();
+    if (call->isError()) {
+        qWarning() << call->error().name() << call->error().message();
         data->update(QList<QContact>(),
                         QContactAbstractRequest::FinishedState,
                         QContactManager::UnspecifiedError);
         destroyRequest(data);
+    } else if (call->reply().signature() == QStringLiteral("ay")) {
+        // binary page, already decoded contacts
+        QDBusPendingReply<QByteArray> reply = *call;
+        bool ok = false;
+        QList<QContact> contacts = ContactCodec::decode(reply.value(), &ok);
+        if (ok) {
+            if (contacts.size() == m_pageSize) {
+                prefetchContactsPage(data);
+            }
+            fetchContactsPageDone(data, contacts);
+        } else {
+            data->update(QList<QContact>(),
+                            QContactAbstractRequest::FinishedState,
+                            QContactManager::UnspecifiedError);
+            destroyRequest(data);
+        }
     } else {
+        QDBusPendingReply<QStringList> reply = *call;
         const QStringList vcards = reply.value();
         if (vcards.size()) {
+            // request the next page while this one is parsed
+            if (vcards.size() == m_pageSize) {
+                prefetchContactsPage(data);
+            }
+
             VCardParser *parser = new VCardParser;
             parser->setProperty("DATA", QVariant::fromValue<void*>(data));
             data->setVCardParser(parser);
@@ -444,6 +507,18 @@ void GaleraContactsService::onVCardsParsed(QList<QContact> contacts)
         return;
     }
 
+    fetchContactsPageDone(data, contacts);
+    sender->deleteLater();
+}
+
+QString GaleraContactsService::contactsDetailsMethod() const
+{
+    return m_binaryDetails ? QStringLiteral("contactsDetailsBinary") : QStringLiteral("contactsDetails");
+}
+
+void GaleraContactsService::fetchContactsPageDone(QContactFetchRequestData *data,
+                                                  QList<QContact> contacts)
+{
     QList<QContact>::iterator contact;
     for (contact = contacts.begin(); contact != contacts.end(); ++contact) {
         if (!contact->isEmpty()) {
@@ -456,14 +531,25 @@ void GaleraContactsService::onVCardsParsed(QList<QContact> contacts)
     if (contacts.size() == m_pageSize) {
         data->update(contacts, QContactAbstractRequest::ActiveState);
         data->updateOffset(m_pageSize);
-        data->updateWatcher(0);
-        fetchContactsPage(data);
+
+        QDBusPendingCallWatcher *watcher = data->takeNextPageWatcher();
+        if (!watcher) {
+            data->updateWatcher(0);
+            fetchContactsPage(data);
+        } else if (watcher->isFinished()) {
+            data->updateWatcher(watcher);
+            fetchContactsDone(data, watcher);
+        } else {
+            data->updateWatcher(watcher);
+            QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                             [=](QDBusPendingCallWatcher *call) {
+                                this->fetchContactsDone(data, call);
+                             });
+        }
     } else {
         data->update(contacts, QContactAbstractRequest::FinishedState);
         destroyRequest(data);
     }
-
-    sender->deleteLater();
 }
 
 void GaleraContactsService::fetchContactsGroupsContinue(QContactFetchRequestData *data,
@@ -589,8 +675,9 @@ void GaleraContactsService::createGroupDone(QContactSaveRequestData *data,
 /* After handle all contacts with type = 'QContactType::TypeGroup', we need to
  * create the real contacts.
  *
- * Due the Server limitation we will call this function for each contact
- * sequentially.
+ * The contacts are sent in 'createContacts' calls of up to CREATE_CONTACTS_BATCH_SIZE
+ * contacts of the same sync target, old services without it receive one
+ * 'createContact' call for each contact sequentially.
  */
 void GaleraContactsService::createContactsStart(QContactSaveRequestData *data)
 {
@@ -608,6 +695,18 @@ void GaleraContactsService::createContactsStart(QContactSaveRequestData *data)
     }
 
     QString syncSource;
+    if (m_batchCreate) {
+        QStringList contacts = data->nextContacts(&syncSource, CREATE_CONTACTS_BATCH_SIZE);
+        QDBusPendingCall pcall = m_iface->asyncCall("createContacts", contacts, syncSource);
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, 0);
+        data->updateWatcher(watcher);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                         [=](QDBusPendingCallWatcher *call) {
+                            this->createContactsBatchDone(data, call);
+                         });
+        return;
+    }
+
     QString contact = data->nextContact(&syncSource);
 
     QDBusPendingCall pcall = m_iface->asyncCall("createContact", contact, syncSource);
@@ -653,6 +752,30 @@ void GaleraContactsService::createContactsDone(QContactSaveRequestData *data,
     createContactsStart(data);
 }
 
+/* 'createContacts' will call this function when done, the reply contains one
+ * vcard for each contact sent, empty for the contacts that failed.
+ */
+void GaleraContactsService::createContactsBatchDone(QContactSaveRequestData *data,
+                                                    QDBusPendingCallWatcher *call)
+{
+    if (!data->isLive()) {
+        data->finish(QContactManager::UnspecifiedError);
+        destroyRequest(data);
+        return;
+    }
+
+    QDBusPendingReply<QStringList> reply = *call;
+    if (reply.isError()) {
+        qWarning() << reply.error().name() << reply.error().message();
+        data->notifyCurrentContactsError(QContactManager::UnspecifiedError);
+    } else {
+        data->updateCurrentContacts(reply.value(), m_managerUri);
+    }
+
+    // go to the next contacts
+    createContactsStart(data);
+}
+
 /*
  * Our server support update a list of groups, because of that we can handle all
  * pending to update groups in one single call.
@@ -919,7 +1042,10 @@ void GaleraContactsService::setShowInvisibleContacts(bool show)
 
 void GaleraContactsService::addRequest(QtContacts::QContactAbstractRequest *request)
 {
-    if (!isOnline()) {
+    // contact queries are also served while the service only has its snapshot
+    bool isQuery = (request->type() == QContactAbstractRequest::ContactFetchRequest) ||
+                   (request->type() == QContactAbstractRequest::ContactFetchByIdRequest);
+    if (isQuery ? !canQuery() : !isOnline()) {
         qWarning() << "Server is not online";
         QContactManagerEngine::updateRequestState(request, QContactAbstractRequest::FinishedState);
         return;
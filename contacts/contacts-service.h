@@ -88,6 +88,9 @@ private:
     QString m_managerUri;                                       // for faster lookup.
     QDBusServiceWatcher *m_serviceWatcher;
     bool m_serviceIsReady;
+    bool m_serviceIsQueryReady;
+    bool m_binaryDetails;
+    bool m_batchCreate;
     int m_pageSize;
     bool m_showInvisibleContacts;
 
@@ -99,6 +102,7 @@ private:
     Q_INVOKABLE void deinitialize();
 
     bool isOnline() const;
+    bool canQuery() const;
 
     void fetchCollections(QtContacts::QContactCollectionFetchRequest *request);
     void fetchCollectionsContinue(QContactCollectionFetchRequestData *data,
@@ -110,7 +114,10 @@ private:
                                      QDBusPendingCallWatcher *call);
     void fetchContactsById(QtContacts::QContactFetchByIdRequest *request);
     void fetchContactsPage(QContactFetchRequestData *data);
+    void prefetchContactsPage(QContactFetchRequestData *data);
     void fetchContactsDone(QContactFetchRequestData *data, QDBusPendingCallWatcher *call);
+    void fetchContactsPageDone(QContactFetchRequestData *data, QList<QtContacts::QContact> contacts);
+    QString contactsDetailsMethod() const;
 
     void saveContact(QtContacts::QContactSaveRequest *request);
     void createGroupsStart(QContactSaveRequestData *data);
@@ -120,6 +127,7 @@ private:
     void updateContacts(QContactSaveRequestData *data);
     void updateContactDone(QContactSaveRequestData *data, QDBusPendingCallWatcher *call);
     void createContactsDone(QContactSaveRequestData *data, QDBusPendingCallWatcher *call);
+    void createContactsBatchDone(QContactSaveRequestData *data, QDBusPendingCallWatcher *call);
     void createGroupDone(QContactSaveRequestData *data, QDBusPendingCallWatcher *call);
 
     void removeContact(QtContacts::QContactRemoveRequest *request);
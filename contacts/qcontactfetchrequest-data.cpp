@@ -31,6 +31,7 @@ QContactFetchRequestData::QContactFetchRequestData(QContactAbstractRequest *requ
                                                    const FetchHint &hint)
     : QContactRequestData(request),
       m_runningParser(0),
+      m_nextPageWatcher(0),
       m_view(0),
       m_offset(0),
       m_hint(hint)
@@ -44,6 +45,8 @@ QContactFetchRequestData::~QContactFetchRequestData()
 {
     delete m_runningParser;
     m_runningParser = 0;
+    delete m_nextPageWatcher;
+    m_nextPageWatcher = 0;
 }
 
 int QContactFetchRequestData::offset() const
@@ -66,6 +69,19 @@ void QContactFetchRequestData::clearVCardParser()
     m_runningParser = 0;
 }
 
+void QContactFetchRequestData::setNextPageWatcher(QDBusPendingCallWatcher *watcher)
+{
+    delete m_nextPageWatcher;
+    m_nextPageWatcher = watcher;
+}
+
+QDBusPendingCallWatcher *QContactFetchRequestData::takeNextPageWatcher()
+{
+    QDBusPendingCallWatcher *watcher = m_nextPageWatcher;
+    m_nextPageWatcher = 0;
+    return watcher;
+}
+
 void QContactFetchRequestData::updateView(QDBusInterface* view)
 {
     m_view = QSharedPointer<QDBusInterface>(view, QContactFetchRequestData::deleteView);
@@ -111,6 +127,7 @@ void QContactFetchRequestData::cancel()
     if (m_runningParser) {
         m_runningParser->cancel();
     }
+    setNextPageWatcher(0);
     QContactRequestData::cancel();
 }
 
@@ -53,6 +53,9 @@ public:
     void setVCardParser(VCardParser *parser);
     void clearVCardParser();
 
+    void setNextPageWatcher(QDBusPendingCallWatcher *watcher);
+    QDBusPendingCallWatcher *takeNextPageWatcher();
+
     QList<QtContacts::QContact> result() const;
 
     void update(QList<QtContacts::QContact> result,
@@ -78,6 +81,8 @@ protected:
 
 private:
     VCardParser *m_runningParser;
+    // request for the next page sent while the current one is being parsed
+    QDBusPendingCallWatcher *m_nextPageWatcher;
     QSharedPointer<QDBusInterface> m_view;
     int m_offset;
     FetchHint m_hint;
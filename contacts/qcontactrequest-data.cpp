@@ -123,8 +123,9 @@ void QContactRequestData::update(QContactAbstractRequest::State state,
 
 void QContactRequestData::deleteWatcher(QDBusPendingCallWatcher *watcher)
 {
+    // the watcher can be replaced from its own finished signal
     if (watcher) {
-        delete watcher;
+        watcher->deleteLater();
     }
 }
 
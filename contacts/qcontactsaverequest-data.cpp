@@ -21,6 +21,7 @@
 
 #include <QtCore/QDebug>
 
+#include <QtContacts/QContactGuid>
 #include <QtContacts/QContactManagerEngine>
 #include <QtContacts/QContactSyncTarget>
 
@@ -92,6 +93,30 @@ QString QContactSaveRequestData::nextContact(QString *syncTargetName)
     return m_currentContact.value();
 }
 
+// up to maxCount pending contacts with the same sync target of the first one
+QStringList QContactSaveRequestData::nextContacts(QString *syncTargetName, int maxCount)
+{
+    Q_ASSERT(m_pendingContacts.count() > 0);
+    QString syncTarget = m_pendingContactsSyncTarget.begin().value();
+    QStringList vcards;
+
+    m_currentContacts.clear();
+    Q_FOREACH(int key, m_pendingContacts.keys()) {
+        if (m_pendingContactsSyncTarget.value(key) == syncTarget) {
+            m_currentContacts << key;
+            vcards << m_pendingContacts.value(key);
+            if (vcards.size() >= maxCount) {
+                break;
+            }
+        }
+    }
+
+    if (syncTargetName) {
+        *syncTargetName = syncTarget;
+    }
+    return vcards;
+}
+
 Source QContactSaveRequestData::nextGroup()
 {
     Q_ASSERT(m_pendingGroups.count() > 0);
@@ -107,6 +132,49 @@ void QContactSaveRequestData::updateCurrentContact(const QContact &contact)
     m_pendingContactsSyncTarget.remove(m_currentContact.key());
 }
 
+void QContactSaveRequestData::updateCurrentContacts(const QStringList &vcards, const QString &managerUri)
+{
+    if (vcards.size() != m_currentContacts.size()) {
+        qWarning() << "Fail to create contacts";
+        notifyCurrentContactsError(QContactManager::UnspecifiedError);
+        return;
+    }
+
+    // empty vcards are the contacts that the server failed to create
+    QStringList created;
+    Q_FOREACH(const QString &vcard, vcards) {
+        if (!vcard.isEmpty()) {
+            created << vcard;
+        }
+    }
+    QList<QContact> contacts = VCardParser::vcardToContactSync(created);
+    if (contacts.size() != created.size()) {
+        contacts.clear();
+        Q_FOREACH(const QString &vcard, created) {
+            contacts << VCardParser::vcardToContact(vcard);
+        }
+    }
+
+    int parsed = 0;
+    for(int i = 0; i < m_currentContacts.size(); i++) {
+        int key = m_currentContacts.at(i);
+        QContact contact;
+        if (!vcards.at(i).isEmpty()) {
+            contact = contacts.at(parsed++);
+        }
+        if (!contact.isEmpty()) {
+            QContactGuid detailId = contact.detail<QContactGuid>();
+            contact.setId(QContactId(managerUri, detailId.guid().toUtf8()));
+            m_contactsToCreate[key] = contact;
+        } else {
+            m_errorMap.insert(key, QContactManager::UnspecifiedError);
+        }
+        m_pendingContacts.remove(key);
+        m_pendingContactsSyncTarget.remove(key);
+    }
+    m_currentContacts.clear();
+}
+
 void QContactSaveRequestData::updateCurrentGroup(const Source &group, const QString &managerUri)
 {
     QContactId id(managerUri, QByteArray("source@") + group.id().toUtf8());
@@ -154,6 +222,16 @@ void QContactSaveRequestData::notifyUpdateError(QContactManager::Error error)
     m_pendingContactsSyncTarget.remove(m_currentContact.key());
 }
 
+void QContactSaveRequestData::notifyCurrentContactsError(QContactManager::Error error)
+{
+    Q_FOREACH(int key, m_currentContacts) {
+        m_errorMap.insert(key, error);
+        m_pendingContacts.remove(key);
+        m_pendingContactsSyncTarget.remove(key);
+    }
+    m_currentContacts.clear();
+}
+
 QContact QContactSaveRequestData::currentContact() const
 {
     return qobject_cast<QContactSaveRequest*>(request())->contacts().at(m_currentContact.key());
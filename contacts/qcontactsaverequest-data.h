@@ -42,9 +42,11 @@ public:
 
     bool hasNext() const;
     QString nextContact(QString *syncTargetName);
+    QStringList nextContacts(QString *syncTargetName, int maxCount);
     QtContacts::QContact currentContact() const;
     QStringList allPendingContacts() const;
     void updateCurrentContact(const QtContacts::QContact &contact);
+    void updateCurrentContacts(const QStringList &vcards, const QString &managerUri);
     void updatePendingContacts(QStringList vcards);
 
     bool hasNextGroup() const;
@@ -55,6 +57,7 @@ public:
     void updatePendingGroups(const SourceList &groups, const QString &managerUri);
 
     void notifyUpdateError(QtContacts::QContactManager::Error error);
+    void notifyCurrentContactsError(QtContacts::QContactManager::Error error);
     void notifyError(QtContacts::QContactManager::Error error);
     static void notifyError(QtContacts::QContactSaveRequest *request,
                             QtContacts::QContactManager::Error error = QtContacts::QContactManager::NotSupportedError);
@@ -71,6 +74,7 @@ private:
     QMap<int, QString> m_pendingContacts;
     QMap<int, QString> m_pendingContactsSyncTarget;
     QMap<int, QString>::Iterator m_currentContact;
+    QList<int> m_currentContacts;
 
     QMap<int, Source> m_pendingGroups;
     QMap<int, Source>::Iterator m_currentGroup;
@@ -30,6 +30,7 @@ AddressBookAdaptor::AddressBookAdaptor(const QDBusConnection &connection, Addres
 {
     setAutoRelaySignals(true);
     connect(m_addressBook, SIGNAL(readyChanged()), SIGNAL(readyChanged()));
+    connect(m_addressBook, SIGNAL(queryReadyChanged()), SIGNAL(queryReadyChanged()));
     connect(m_addressBook, SIGNAL(safeModeChanged()), SIGNAL(safeModeChanged()));
     connect(m_addressBook, SIGNAL(sourcesChanged()), SIGNAL(sourcesChanged()));
 }
@@ -116,6 +117,17 @@ QString AddressBookAdaptor::createContact(const QString &contact, const QString
     return QString();
 }
 
+QStringList AddressBookAdaptor::createContacts(const QStringList &contacts, const QString &source, const QDBusMessage &message)
+{
+    message.setDelayedReply(true);
+    QMetaObject::invokeMethod(m_addressBook, "createContacts",
+                              Qt::QueuedConnection,
+                              Q_ARG(const QStringList&, contacts),
+                              Q_ARG(const QString&, source),
+                              Q_ARG(const QDBusMessage&, message));
+    return QStringList();
+}
+
 QDBusObjectPath AddressBookAdaptor::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources)
 {
     View *v = m_addressBook->query(clause, sort, maxCount, showInvisible, sources);
@@ -123,6 +135,11 @@ QDBusObjectPath AddressBookAdaptor::query(const QString &clause, const QString &
     return QDBusObjectPath(v->dynamicObjectPath());
 }
 
+PhoneNumberMatchList AddressBookAdaptor::lookupPhoneNumbers(const QStringList &phoneNumbers)
+{
+    return m_addressBook->lookupPhoneNumbers(phoneNumbers);
+}
+
 int AddressBookAdaptor::removeContacts(const QStringList &contactIds, const QDBusMessage &message)
 {
     message.setDelayedReply(true);
@@ -133,6 +150,11 @@ int AddressBookAdaptor::removeContacts(const QStringList &contactIds, const QDBu
     return 0;
 }
 
+QStringList AddressBookAdaptor::capabilities()
+{
+    return m_addressBook->capabilities();
+}
+
 QStringList AddressBookAdaptor::sortFields()
 {
     return m_addressBook->sortFields();
@@ -163,6 +185,11 @@ bool AddressBookAdaptor::isReady()
     return m_addressBook->isReady();
 }
 
+bool AddressBookAdaptor::isQueryReady()
+{
+    return m_addressBook->isQueryReady();
+}
+
 bool AddressBookAdaptor::ping()
 {
     return true;
@@ -26,6 +26,7 @@
 #include <QtCore/QStringList>
 
 #include "common/source.h"
+#include "common/phone-number-match.h"
 #include "common/dbus-service-defs.h"
 
 namespace galera
@@ -38,6 +39,7 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
     Q_CLASSINFO("D-Bus Introspection", ""
 "  <interface name=\"com.canonical.pim.AddressBook\">\n"
 "    <property name=\"isReady\" type=\"b\" access=\"read\"/>\n"
+"    <property name=\"isQueryReady\" type=\"b\" access=\"read\"/>\n"
 "    <property name=\"safeMode\" type=\"b\" access=\"readwrite\"/>\n"
 "    <signal name=\"contactsUpdated\">\n"
 "      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
@@ -52,6 +54,7 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"out\" type=\"a(ss)\" name=\"errorMap\"/>\n"
 "    </signal>\n"
 "    <signal name=\"readyChanged\"/>\n"
+"    <signal name=\"queryReadyChanged\"/>\n"
 "    <signal name=\"safeModeChanged\"/>\n"
 "    <signal name=\"sourcesChanged\"/>\n"
 "    <method name=\"ping\">\n"
@@ -88,6 +91,9 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"s\"/>\n"
 "      <arg direction=\"out\" type=\"b\"/>\n"
 "    </method>\n"
+"    <method name=\"capabilities\">\n"
+"      <arg direction=\"out\" type=\"as\"/>\n"
+"    </method>\n"
 "    <method name=\"sortFields\">\n"
 "      <arg direction=\"out\" type=\"as\"/>\n"
 "    </method>\n"
@@ -99,6 +105,11 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"as\" name=\"sources\"/>\n"
 "      <arg direction=\"out\" type=\"o\"/>\n"
 "    </method>\n"
+"    <method name=\"lookupPhoneNumbers\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"phoneNumbers\"/>\n"
+"      <arg direction=\"out\" type=\"a(sssssi)\"/>\n"
+"      <annotation value=\"PhoneNumberMatchList\" name=\"com.trolltech.QtDBus.QtTypeName.Out0\"/>\n"
+"    </method>\n"
 "    <method name=\"removeContacts\">\n"
 "      <arg direction=\"out\" type=\"i\"/>\n"
 "      <arg direction=\"in\" type=\"as\" name=\"contactIds\"/>\n"
@@ -108,6 +119,11 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"s\" name=\"source\"/>\n"
 "      <arg direction=\"out\" type=\"s\"/>\n"
 "    </method>\n"
+"    <method name=\"createContacts\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"contacts\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"source\"/>\n"
+"      <arg direction=\"out\" type=\"as\"/>\n"
+"    </method>\n"
 "    <method name=\"updateContacts\">\n"
 "      <arg direction=\"out\" type=\"as\"/>\n"
 "      <arg direction=\"in\" type=\"as\" name=\"contacts\"/>\n"
@@ -129,6 +145,7 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "  </interface>\n"
         "")
     Q_PROPERTY(bool isReady READ isReady NOTIFY readyChanged)
+    Q_PROPERTY(bool isQueryReady READ isQueryReady NOTIFY queryReadyChanged)
     Q_PROPERTY(bool safeMode READ safeMode WRITE setSafeMode NOTIFY safeModeChanged)
 
 public:
@@ -147,14 +164,18 @@ public Q_SLOTS:
                                   const QDBusMessage &message);
     SourceList updateSources(const SourceList &sources, const QDBusMessage &message);
     bool removeSource(const QString &sourceId, const QDBusMessage &message);
+    QStringList capabilities();
     QStringList sortFields();
     QDBusObjectPath query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources);
+    PhoneNumberMatchList lookupPhoneNumbers(const QStringList &phoneNumbers);
     int removeContacts(const QStringList &contactIds, const QDBusMessage &message);
     QString createContact(const QString &contact, const QString &source, const QDBusMessage &message);
+    QStringList createContacts(const QStringList &contacts, const QString &source, const QDBusMessage &message);
     QStringList updateContacts(const QStringList &contacts, const QDBusMessage &message);
     QString linkContacts(const QStringList &contacts);
     bool unlinkContacts(const QString &parentId, const QStringList &contactsIds);
     bool isReady();
+    bool isQueryReady();
     bool safeMode() const;
     bool ping();
     void purgeContacts(const QString &since, const QString &sourceId, const QDBusMessage &message);
@@ -167,6 +188,7 @@ Q_SIGNALS:
     void contactsUpdated(const QStringList &ids);
     void asyncOperationResult(QMap<QString, QString> errors);
     void readyChanged();
+    void queryReadyChanged();
     void reloaded();
     void safeModeChanged();
     void sourcesChanged();
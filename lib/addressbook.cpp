@@ -21,20 +21,28 @@
 #include "addressbook-adaptor.h"
 #include "view.h"
 #include "contacts-map.h"
+#include "contacts-snapshot.h"
 #include "qindividual.h"
 #include "dirtycontact-notify.h"
 #include "e-source-ubuntu.h"
+#include "eds-client-cache.h"
 
 #include "common/vcard-parser.h"
 
 #include <QtCore/QPair>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
 #include <QtCore/QUuid>
 
+#include <QtContacts/QContactAvatar>
+#include <QtContacts/QContactDisplayLabel>
 #include <QtContacts/QContactExtendedDetail>
 
 #include <signal.h>
 #include <sys/socket.h>
 
+#include <algorithm>
+
 #include <folks/folks-eds.h>
 
 // Ubuntu
@@ -47,6 +55,14 @@ namespace C {
 }
 
 #define MESSAGING_MENU_SOURCE_ID "address-book-service"
+// time to wait after a contact change to save the contacts snapshot
+#define SNAPSHOT_SAVE_INTERVAL   60000
+// number of personas created at the same time by "createContacts"
+#define CREATE_CONTACTS_MAX_IN_FLIGHT   8
+// number of contacts updated at the same time by all "updateContacts" calls
+#define UPDATE_CONTACTS_MAX_IN_FLIGHT   8
+// max number of EDS contacts saved by a single call during the contacts removal
+#define REMOVE_CONTACTS_BATCH_SIZE      100
 
 using namespace QtContacts;
 
@@ -61,25 +77,117 @@ public:
     galera::AddressBook *m_addressbook;
 };
 
-class UpdateContactsData
+class CreateContactsData
 {
 public:
     QList<QContact> m_contacts;
-    QStringList m_request;
-    int m_currentIndex;
     QStringList m_result;
+    int m_nextIndex;
+    int m_pending;
+    FolksPersonaStore *m_store;
     galera::AddressBook *m_addressbook;
     QDBusMessage m_message;
 };
 
+class CreateContactsItemData
+{
+public:
+    CreateContactsData *m_batch;
+    int m_index;
+};
+
 class RemoveContactsData
 {
 public:
+    // contacts removed through folks, one by one
     QStringList m_request;
+    // contact being removed through folks, empty when no removal is running
+    QString m_removingId;
     galera::AddressBook *m_addressbook;
     QDBusMessage m_message;
     int m_sucessCount;
-    bool m_softRemoval;
+    // contacts already counted, a contact can have personas on more than one source
+    QSet<QString> m_doneIds;
+    // folks removal and EDS batches still running
+    int m_pending;
+};
+
+// EDS contacts of the same source saved or removed in a single call
+class RemoveContactsBatch
+{
+public:
+    RemoveContactsData *m_data;
+    EBookClient *m_client;
+    // contacts marked as deleted
+    GSList *m_contacts;
+    // uids of the contacts to remove
+    GSList *m_uids;
+    QStringList m_ids;
+    QDateTime m_deletedAt;
+};
+
+// return the batch of the source where the contact goes, the full batches are moved to "ready"
+RemoveContactsBatch *removeContactsBatch(RemoveContactsData *data,
+                                         ESource *source,
+                                         const QString &contactId,
+                                         QHash<QString, RemoveContactsBatch*> *batches,
+                                         QList<RemoveContactsBatch*> *ready)
+{
+    QString sourceId = QString::fromUtf8(e_source_get_uid(source));
+    RemoveContactsBatch *batch = batches->value(sourceId, 0);
+    // keep all personas of the contact in the same batch
+    if (batch &&
+        (batch->m_ids.size() >= REMOVE_CONTACTS_BATCH_SIZE) &&
+        (batch->m_ids.last() != contactId)) {
+        *ready << batches->take(sourceId);
+        batch = 0;
+    }
+
+    if (!batch) {
+        EBookClient *client = galera::EdsClientCache::client(source);
+        if (!client) {
+            return 0;
+        }
+        batch = new RemoveContactsBatch;
+        batch->m_data = data;
+        batch->m_client = client;
+        batch->m_contacts = 0;
+        batch->m_uids = 0;
+        batches->insert(sourceId, batch);
+    }
+
+    if (batch->m_ids.isEmpty() || (batch->m_ids.last() != contactId)) {
+        batch->m_ids << contactId;
+    }
+    return batch;
+}
+
+// save the contacts snapshot out of the main loop, the entries are pinned
+// until the snapshot is written
+class SaveSnapshotTask : public QRunnable
+{
+public:
+    SaveSnapshotTask(const QString &path, galera::ContactsMap *contacts, QSemaphore *saved)
+        : m_path(path),
+          m_contacts(contacts),
+          m_entries(contacts->values()),
+          m_saved(saved)
+    {
+        m_contacts->pin();
+    }
+
+    void run()
+    {
+        galera::ContactsSnapshot::save(m_path, m_entries);
+        m_contacts->unpin();
+        m_saved->release();
+    }
+
+private:
+    QString m_path;
+    galera::ContactsMap *m_contacts;
+    QList<galera::ContactEntry*> m_entries;
+    QSemaphore *m_saved;
 };
 
 class CreateSourceData
@@ -153,6 +261,18 @@ ESource* create_esource_from_data(CreateSourceData &data, ESourceRegistry **regi
 
 namespace galera
 {
+
+// one "updateContacts" call, replied when all its contacts are done
+class UpdateContactsData
+{
+public:
+    QList<QContact> m_contacts;
+    QStringList m_result;
+    QStringList m_updatedIds;
+    int m_pending;
+    QDBusMessage m_message;
+};
+
 int AddressBook::m_sigQuitFd[2] = {0, 0};
 QSettings AddressBook::m_settings(SETTINGS_ORG, SETTINGS_APPLICATION);
 
@@ -171,7 +291,10 @@ AddressBook::AddressBook(QObject *parent)
       m_connection(QDBusConnection::sessionBus()),
       m_messagingMenu(0),
       m_messagingMenuMessage(0),
-      m_sourceRegistryListener(0)
+      m_sourceRegistryListener(0),
+      m_schedulingUpdates(false),
+      m_snapshotLoaded(false),
+      m_snapshotSaved(1)
 {
     if (qEnvironmentVariableIsSet(ALTERNATIVE_CPIM_SERVICE_NAME)) {
         m_serviceName = qgetenv(ALTERNATIVE_CPIM_SERVICE_NAME);
@@ -183,6 +306,10 @@ AddressBook::AddressBook(QObject *parent)
     connectWithEDS();
     connect(this, SIGNAL(readyChanged()), SLOT(checkCompatibility()));
     connect(this, SIGNAL(safeModeChanged()), SLOT(onSafeModeChanged()));
+
+    m_snapshotTimer.setSingleShot(true);
+    m_snapshotTimer.setInterval(SNAPSHOT_SAVE_INTERVAL);
+    connect(&m_snapshotTimer, SIGNAL(timeout()), SLOT(saveSnapshot()));
 }
 
 AddressBook::~AddressBook()
@@ -274,6 +401,14 @@ void AddressBook::unprepareFolks()
     // flusing any pending notification
     m_notifyContactUpdate->flush();
 
+    // the last snapshot is saved before the contacts go away
+    m_snapshotTimer.stop();
+    m_snapshotSaved.acquire();
+    if (m_ready && m_contacts && !ContactsSnapshot::path().isEmpty()) {
+        ContactsSnapshot::save(ContactsSnapshot::path(), m_contacts->values());
+    }
+    m_snapshotSaved.release();
+    setSnapshotLoaded(false);
     setIsReady(false);
 
     Q_FOREACH(View* view, m_views) {
@@ -376,8 +511,52 @@ void AddressBook::setIsReady(bool isReady)
 {
     if (isReady != m_ready) {
         m_ready = isReady;
+        if (m_ready) {
+            connectEdsClients();
+        }
+        if (m_ready && m_snapshotLoaded) {
+            // folks delivered all contacts, anything left from the snapshot is gone
+            removeSnapshotEntries();
+            scheduleUpdates();
+        }
         if (m_adaptor) {
             Q_EMIT readyChanged();
+            Q_EMIT queryReadyChanged();
+        }
+    }
+}
+
+// connect the clients of the EDS sources in background, the writes that need them
+// before they are ready go through folks
+void AddressBook::connectEdsClients()
+{
+    FolksBackendStore *backendStore = folks_backend_store_dup();
+    FolksBackend *backend = folks_backend_store_dup_backend_by_name(backendStore, "eds");
+    if (backend) {
+        GeeMap *stores = folks_backend_get_persona_stores(backend);
+        GeeCollection *values = gee_map_get_values(stores);
+        GeeIterator *iter = gee_iterable_iterator(GEE_ITERABLE(values));
+        while(gee_iterator_next(iter)) {
+            FolksPersonaStore *store = FOLKS_PERSONA_STORE(gee_iterator_get(iter));
+            if (EDSF_IS_PERSONA_STORE(store)) {
+                EdsClientCache::connect(edsf_persona_store_get_source(EDSF_PERSONA_STORE(store)));
+            }
+            g_object_unref(store);
+        }
+        g_object_unref(iter);
+        g_object_unref(values);
+        g_object_unref(backend);
+    }
+    g_object_unref(backendStore);
+}
+
+void AddressBook::setSnapshotLoaded(bool loaded)
+{
+    if (loaded != m_snapshotLoaded) {
+        bool wasQueryReady = isQueryReady();
+        m_snapshotLoaded = loaded;
+        if (m_adaptor && (wasQueryReady != isQueryReady())) {
+            Q_EMIT queryReadyChanged();
         }
     }
 }
@@ -405,7 +584,73 @@ void AddressBook::prepareFolks()
     if (ready) {
         qDebug() << "Folks is already in quiescent mode";
         setIsReady(ready);
+    } else {
+        loadSnapshot();
+    }
+}
+
+void AddressBook::loadSnapshot()
+{
+    QString path = ContactsSnapshot::path();
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QList<ContactEntry*> entries = ContactsSnapshot::load(path, m_individualAggregator);
+    if (!entries.isEmpty()) {
+        Q_FOREACH(ContactEntry *entry, entries) {
+            entry->individual()->addListener(this, SLOT(individualChanged(QIndividual*)));
+        }
+        m_contacts->insert(entries);
+        setSnapshotLoaded(true);
+    }
+}
+
+void AddressBook::removeSnapshotEntries()
+{
+    setSnapshotLoaded(false);
+
+    QSet<QString> removedIds;
+    Q_FOREACH(ContactEntry *entry, m_contacts->values()) {
+        if (entry->individual()->individual()) {
+            continue;
+        }
+
+        m_contacts->take(entry->individual()->id());
+        Q_FOREACH(View *view, m_views) {
+            view->removeContact(entry);
+        }
+        if (entry->individual()->isVisible()) {
+            removedIds << entry->individual()->id();
+        }
+        m_contacts->release(entry);
+    }
+
+    if (!removedIds.isEmpty() && m_notifyContactUpdate) {
+        m_notifyContactUpdate->insertRemovedContacts(removedIds);
+    }
+}
+
+void AddressBook::scheduleSnapshot()
+{
+    if (m_ready && !m_snapshotTimer.isActive()) {
+        m_snapshotTimer.start();
+    }
+}
+
+void AddressBook::saveSnapshot()
+{
+    QString path = ContactsSnapshot::path();
+    if (path.isEmpty() || !m_contacts || !m_ready) {
+        return;
+    }
+
+    // try again later if the previous snapshot is still being saved
+    if (!m_snapshotSaved.tryAcquire()) {
+        m_snapshotTimer.start();
+        return;
     }
+    QThreadPool::globalInstance()->start(new SaveSnapshotTask(path, m_contacts, &m_snapshotSaved));
 }
 
 void AddressBook::unprepareEds()
@@ -1094,6 +1339,91 @@ QString AddressBook::createContact(const QString &contact, const QString &source
     return "";
 }
 
+QStringList AddressBook::createContacts(const QStringList &contacts, const QString &source, const QDBusMessage &message)
+{
+    CreateContactsData *data = new CreateContactsData;
+    data->m_addressbook = this;
+    data->m_message = message;
+    data->m_nextIndex = 0;
+    data->m_pending = 0;
+    data->m_store = getFolksStore(source);
+
+    // parse all vcards in one pass, fallback to one by one if any of them fails
+    data->m_contacts = VCardParser::vcardToContactSync(contacts);
+    if (data->m_contacts.size() != contacts.size()) {
+        data->m_contacts.clear();
+        Q_FOREACH(const QString &vcard, contacts) {
+            data->m_contacts << VCardParser::vcardToContact(vcard);
+        }
+    }
+
+    for(int i = 0; i < contacts.size(); i++) {
+        data->m_result << QString();
+        if (m_contacts->valueFromVCard(contacts.at(i))) {
+            qWarning() << "Contact exists";
+            data->m_contacts[i] = QContact();
+        }
+    }
+
+    createContactsNext(data);
+    return QStringList();
+}
+
+void AddressBook::createContactsNext(void *data)
+{
+    CreateContactsData *createData = static_cast<CreateContactsData*>(data);
+
+    while ((createData->m_pending < CREATE_CONTACTS_MAX_IN_FLIGHT) &&
+           (createData->m_nextIndex < createData->m_contacts.size())) {
+        int index = createData->m_nextIndex++;
+        const QContact &qcontact = createData->m_contacts.at(index);
+        if (qcontact.isEmpty()) {
+            continue;
+        }
+
+        GHashTable *details = QIndividual::parseDetails(qcontact);
+        Q_ASSERT(details);
+        CreateContactsItemData *item = new CreateContactsItemData;
+        item->m_batch = createData;
+        item->m_index = index;
+        createData->m_pending++;
+        folks_individual_aggregator_add_persona_from_details(m_individualAggregator,
+                                                             NULL, //parent
+                                                             createData->m_store,
+                                                             details,
+                                                             (GAsyncReadyCallback) createContactsDone,
+                                                             (void*) item);
+        g_hash_table_destroy(details);
+    }
+
+    if ((createData->m_pending == 0) &&
+        (createData->m_nextIndex >= createData->m_contacts.size())) {
+        if (createData->m_message.type() != QDBusMessage::InvalidMessage) {
+            QDBusMessage reply = createData->m_message.createReply(createData->m_result);
+            QDBusConnection::sessionBus().send(reply);
+        }
+        if (createData->m_store) {
+            g_object_unref(createData->m_store);
+        }
+        delete createData;
+    }
+}
+
+QString AddressBook::personaCreated(FolksPersona *persona, const QContact &contact)
+{
+    QIndividual::setExtendedDetails(persona,
+                                    contact.details(QContactExtendedDetail::Type),
+                                    QDateTime::currentDateTime());
+    FolksIndividual *individual = folks_persona_get_individual(persona);
+    ContactEntry *entry = m_contacts->value(QString::fromUtf8(folks_individual_get_id(individual)));
+    if (entry) {
+        // We will need to reload contact due the extended details
+        entry->individual()->flush();
+        return VCardParser::contactToVcard(entry->individual()->contact());
+    }
+    return QString();
+}
+
 FolksPersonaStore * AddressBook::getFolksStore(const QString &source)
 {
     QString sourceId(source);
@@ -1161,7 +1491,9 @@ QString AddressBook::linkContacts(const QStringList &contacts)
 
 View *AddressBook::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources)
 {
-    View *view = new View(clause, sort, maxCount, showInvisible, sources, m_ready ? m_contacts : 0, this);
+    // the views are served from the snapshot until folks is ready
+    View *view = new View(clause, sort, maxCount, showInvisible, sources,
+                          (m_ready || m_snapshotLoaded) ? m_contacts : 0, this);
     m_views << view;
     connect(view, SIGNAL(closed()), this, SLOT(viewClosed()));
     return view;
@@ -1177,6 +1509,44 @@ void AddressBook::individualChanged(QIndividual *individual)
     if (individual->isVisible()) {
         m_notifyContactUpdate->insertChangedContacts(QSet<QString>() << individual->id());
     }
+
+    // this can be called with the contact locked, update the views later
+    scheduleViewUpdate(individual->id());
+}
+
+// the views are updated once for all changes of the contact in the same main loop iteration
+void AddressBook::scheduleViewUpdate(const QString &id)
+{
+    if (m_pendingViewUpdates.isEmpty()) {
+        QMetaObject::invokeMethod(this, "updateViews", Qt::QueuedConnection);
+    }
+    m_pendingViewUpdates << id;
+}
+
+void AddressBook::updateViews()
+{
+    QSet<QString> ids = m_pendingViewUpdates;
+    m_pendingViewUpdates.clear();
+
+    if (!m_contacts) {
+        return;
+    }
+    scheduleSnapshot();
+
+    Q_FOREACH(const QString &id, ids) {
+        ContactEntry *entry = m_contacts->value(id);
+        if (entry) {
+            m_contacts->updatePosition(entry);
+            updateViews(entry);
+        }
+    }
+}
+
+void AddressBook::updateViews(ContactEntry *entry)
+{
+    Q_FOREACH(View *view, m_views) {
+        view->updateContact(entry);
+    }
 }
 
 void AddressBook::onEdsServiceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner)
@@ -1185,6 +1555,7 @@ void AddressBook::onEdsServiceOwnerChanged(const QString &name, const QString &o
         m_edsIsLive = false;
         m_isAboutToReload = true;
         qWarning() << "EDS died: restarting service" << m_individualsChangedDetailedId;
+        EdsClientCache::clear();
         unprepareFolks();
     } else {
         m_edsIsLive = true;
@@ -1233,13 +1604,143 @@ int AddressBook::removeContacts(const QStringList &contactIds, const QDBusMessag
     RemoveContactsData *data = new RemoveContactsData;
     data->m_addressbook = this;
     data->m_message = message;
-    data->m_request = contactIds;
     data->m_sucessCount = 0;
-    data->m_softRemoval = true;
-    removeContactDone(0, 0, data);
+    data->m_pending = 1;
+
+    // EDS contacts are only marked as deleted, they are grouped by source and saved in batches
+    QDateTime deletedAt = QDateTime::currentDateTime();
+    QHash<QString, RemoveContactsBatch*> batches;
+    QList<RemoveContactsBatch*> ready;
+    Q_FOREACH(const QString &contactId, contactIds) {
+        ContactEntry *entry = m_contacts->value(contactId);
+        if (!entry) {
+            continue;
+        }
+
+        QList<QPair<ESource*, EContact*> > contacts = entry->individual()->edsContactsMarkedAsDeleted(deletedAt);
+        if (contacts.isEmpty()) {
+            data->m_request << contactId;
+            continue;
+        }
+
+        for(int i = 0; i < contacts.size(); i++) {
+            RemoveContactsBatch *batch = removeContactsBatch(data, contacts.at(i).first, contactId, &batches, &ready);
+            if (batch) {
+                batch->m_contacts = g_slist_prepend(batch->m_contacts, contacts.at(i).second);
+                batch->m_deletedAt = deletedAt;
+            } else {
+                // the source is not connected yet, remove the contact through folks
+                g_object_unref(contacts.at(i).second);
+                if (data->m_request.isEmpty() || (data->m_request.last() != contactId)) {
+                    data->m_request << contactId;
+                }
+            }
+        }
+    }
+    ready << batches.values();
+
+    Q_FOREACH(RemoveContactsBatch *batch, ready) {
+        data->m_pending++;
+        e_book_client_modify_contacts(batch->m_client,
+                                      batch->m_contacts,
+                                      NULL,
+                                      (GAsyncReadyCallback) removeContactsBatchDone,
+                                      batch);
+    }
+
+    // contacts without EDS personas are removed from folks
+    removeContactDone(m_individualAggregator, 0, data);
     return 0;
 }
 
+void AddressBook::removeContactsBatchDone(GObject *source,
+                                          GAsyncResult *result,
+                                          void *data)
+{
+    RemoveContactsBatch *batch = static_cast<RemoveContactsBatch*>(data);
+    RemoveContactsData *removeData = batch->m_data;
+    AddressBook *self = removeData->m_addressbook;
+
+    GError *error = 0;
+    e_book_client_modify_contacts_finish(E_BOOK_CLIENT(source), result, &error);
+    if (error) {
+        qWarning() << "Fail to mark contacts as deleted, removing them through folks:" << error->message;
+        g_error_free(error);
+        Q_FOREACH(const QString &contactId, batch->m_ids) {
+            if (!removeData->m_doneIds.contains(contactId)) {
+                removeData->m_request << contactId;
+            }
+        }
+        // restart the folks removal if it is not running
+        if (removeData->m_removingId.isEmpty() && !removeData->m_request.isEmpty()) {
+            removeData->m_pending++;
+            removeContactDone(self->m_individualAggregator, 0, removeData);
+        }
+    } else {
+        QSet<QString> removedIds;
+        Q_FOREACH(const QString &contactId, batch->m_ids) {
+            if (removeData->m_doneIds.contains(contactId)) {
+                continue;
+            }
+            ContactEntry *entry = self->m_contacts->value(contactId);
+            if (entry) {
+                entry->individual()->setDeletedAt(batch->m_deletedAt);
+            }
+            removeData->m_doneIds << contactId;
+            removedIds << contactId;
+        }
+        removeData->m_sucessCount += removedIds.size();
+        // since these will not be removed we need to send a removal singal
+        self->m_notifyContactUpdate->insertRemovedContacts(removedIds);
+    }
+
+    g_slist_free_full(batch->m_contacts, g_object_unref);
+    g_object_unref(batch->m_client);
+    delete batch;
+    removeContactsFinished(removeData);
+}
+
+void AddressBook::purgeContactsBatchDone(GObject *source,
+                                         GAsyncResult *result,
+                                         void *data)
+{
+    RemoveContactsBatch *batch = static_cast<RemoveContactsBatch*>(data);
+    RemoveContactsData *removeData = batch->m_data;
+
+    GError *error = 0;
+    e_book_client_remove_contacts_finish(E_BOOK_CLIENT(source), result, &error);
+    if (error) {
+        qWarning() << "Fail to purge contacts:" << error->message;
+        g_error_free(error);
+    } else {
+        // the contacts leave the map when folks notifies the removal
+        Q_FOREACH(const QString &contactId, batch->m_ids) {
+            if (!removeData->m_doneIds.contains(contactId)) {
+                removeData->m_doneIds << contactId;
+                removeData->m_sucessCount++;
+            }
+        }
+    }
+
+    g_slist_free_full(batch->m_uids, g_free);
+    g_object_unref(batch->m_client);
+    delete batch;
+    removeContactsFinished(removeData);
+}
+
+void AddressBook::removeContactsFinished(void *data)
+{
+    RemoveContactsData *removeData = static_cast<RemoveContactsData*>(data);
+    removeData->m_pending--;
+    if (removeData->m_pending == 0) {
+        if (removeData->m_message.type() != QDBusMessage::InvalidMessage) {
+            QDBusMessage reply = removeData->m_message.createReply(removeData->m_sucessCount);
+            QDBusConnection::sessionBus().send(reply);
+        }
+        delete removeData;
+    }
+}
+
 void AddressBook::removeContactDone(FolksIndividualAggregator *individualAggregator,
                                     GAsyncResult *result,
                                     void *data)
@@ -1252,34 +1753,30 @@ void AddressBook::removeContactDone(FolksIndividualAggregator *individualAggrega
         if (error) {
             qWarning() << "Fail to remove contact:" << error->message;
             g_error_free(error);
-        } else {
+        } else if (!removeData->m_doneIds.contains(removeData->m_removingId)) {
+            removeData->m_doneIds << removeData->m_removingId;
             removeData->m_sucessCount++;
         }
+        removeData->m_removingId.clear();
     }
 
-
-    if (!removeData->m_request.isEmpty()) {
+    while (!removeData->m_request.isEmpty()) {
         QString contactId = removeData->m_request.takeFirst();
         ContactEntry *entry = removeData->m_addressbook->m_contacts->value(contactId);
-        if (entry) {
-            if (removeData->m_softRemoval && entry->individual()->markAsDeleted()) {
-                removeContactDone(individualAggregator, 0, data);
-                // since this will not be removed we need to send a removal singal
-                removeData->m_addressbook->m_notifyContactUpdate->insertRemovedContacts(QSet<QString>() << entry->individual()->id());
-            } else {
-                folks_individual_aggregator_remove_individual(individualAggregator,
-                                                              entry->individual()->individual(),
-                                                              (GAsyncReadyCallback) removeContactDone,
-                                                              data);
-            }
-        } else {
-            removeContactDone(individualAggregator, 0, data);
+        // snapshot entries can not be removed until folks loads them
+        if (entry && !entry->individual()->individual()) {
+            qWarning() << "Contact not loaded yet, it can not be removed:" << contactId;
+        } else if (entry) {
+            removeData->m_removingId = contactId;
+            folks_individual_aggregator_remove_individual(individualAggregator,
+                                                          entry->individual()->individual(),
+                                                          (GAsyncReadyCallback) removeContactDone,
+                                                          data);
+            return;
         }
-    } else {
-        QDBusMessage reply = removeData->m_message.createReply(removeData->m_sucessCount);
-        QDBusConnection::sessionBus().send(reply);
-        delete removeData;
     }
+
+    removeContactsFinished(removeData);
 }
 
 QStringList AddressBook::sortFields()
@@ -1287,6 +1784,73 @@ QStringList AddressBook::sortFields()
     return SortClause::supportedFields();
 }
 
+QStringList AddressBook::capabilities() const
+{
+    return QStringList() << CPIM_CAPABILITY_BINARY_DETAILS
+                         << CPIM_CAPABILITY_PHONE_LOOKUP
+                         << CPIM_CAPABILITY_BATCH_CREATE;
+}
+
+bool AddressBook::phoneNumberMatchLessThan(const PhoneNumberMatch &a, const PhoneNumberMatch &b)
+{
+    return (a.matchType() > b.matchType());
+}
+
+PhoneNumberMatchList AddressBook::lookupPhoneNumbers(const QStringList &phoneNumbers)
+{
+    PhoneNumberMatchList result;
+    // same contacts used by the views, the snapshot is used until folks is ready
+    if (!m_contacts || !(m_ready || m_snapshotLoaded)) {
+        return result;
+    }
+
+    QList<QContactDetail::DetailType> types;
+    types << QContactDetail::TypeDisplayLabel
+          << QContactDetail::TypeAvatar;
+
+    Q_FOREACH(const QString &phoneNumber, phoneNumbers) {
+        if (phoneNumber.isEmpty()) {
+            continue;
+        }
+
+        // the phone index returns the contacts with the same number suffix,
+        // the numbers are compared as the phone number filter does
+        ParsedPhoneNumber query(phoneNumber);
+        PhoneNumberMatchList matches;
+        Q_FOREACH(ContactEntry *entry, m_contacts->valueByPhone(phoneNumber)) {
+            QIndividual *individual = entry->individual();
+            if (!individual->isVisible() || individual->deletedAt().isValid()) {
+                continue;
+            }
+
+            int bestMatch = ParsedPhoneNumber::NoMatch;
+            QString matchedNumber;
+            Q_FOREACH(const ParsedPhoneNumber &number, individual->phoneNumbers()) {
+                int match = query.matchType(number);
+                if (match > bestMatch) {
+                    bestMatch = match;
+                    matchedNumber = number.number();
+                }
+            }
+
+            if (bestMatch > ParsedPhoneNumber::NoMatch) {
+                const QContact &contact = individual->contact(types);
+                matches << PhoneNumberMatch(phoneNumber,
+                                            individual->id(),
+                                            contact.detail<QContactDisplayLabel>().label(),
+                                            contact.detail<QContactAvatar>().imageUrl().toString(),
+                                            matchedNumber,
+                                            bestMatch);
+            }
+        }
+
+        // best matches first
+        std::stable_sort(matches.begin(), matches.end(), phoneNumberMatchLessThan);
+        result << matches;
+    }
+    return result;
+}
+
 bool AddressBook::unlinkContacts(const QString &parent, const QStringList &contacts)
 {
     //TODO
@@ -1298,23 +1862,37 @@ bool AddressBook::isReady() const
     return m_ready && m_edsIsLive;
 }
 
+bool AddressBook::isQueryReady() const
+{
+    // contacts loaded from the snapshot can be queried before folks is ready
+    return isReady() || (m_contacts && m_snapshotLoaded);
+}
+
 QStringList AddressBook::updateContacts(const QStringList &contacts, const QDBusMessage &message)
 {
-    //TODO: support multiple update contacts calls
-    Q_ASSERT(m_updateCommandPendingContacts.isEmpty());
-    if (!processUpdates()) {
-        qWarning() << "Fail to process pending updates";
-        QDBusMessage reply = m_updateCommandReplyMessage.createReply(QStringList());
-        QDBusConnection::sessionBus().send(reply);
-        return QStringList();
+    UpdateContactsData *data = new UpdateContactsData;
+    data->m_message = message;
+    data->m_result = contacts;
+    data->m_pending = contacts.size();
+
+    // parse all vcards in one pass, fallback to one by one if any of them fails
+    data->m_contacts = VCardParser::vcardToContactSync(contacts);
+    if (data->m_contacts.size() != contacts.size()) {
+        data->m_contacts.clear();
+        Q_FOREACH(const QString &vcard, contacts) {
+            data->m_contacts << VCardParser::vcardToContact(vcard);
+        }
     }
 
-    m_updatedIds.clear();
-    m_updateCommandReplyMessage = message;
-    m_updateCommandResult = contacts;
-    m_updateCommandPendingContacts = contacts;
+    if (contacts.isEmpty()) {
+        updateContactsFinished(data);
+        return QStringList();
+    }
 
-    updateContactsDone("", "");
+    for(int i = 0; i < contacts.size(); i++) {
+        m_updateQueue << qMakePair(data, i);
+    }
+    scheduleUpdates();
     return QStringList();
 }
 
@@ -1324,74 +1902,147 @@ void AddressBook::purgeContacts(const QDateTime &since, const QString &sourceId,
     data->m_addressbook = this;
     data->m_message = message;
     data->m_sucessCount = 0;
-    data->m_softRemoval = false;
+    data->m_pending = 1;
+
+    // the EDS contacts are removed in batches by source
+    QHash<QString, RemoveContactsBatch*> batches;
+    QList<RemoveContactsBatch*> ready;
+    Q_FOREACH(ContactEntry *entry, m_contacts->valuesDeletedSince(sourceId, since)) {
+        QString contactId = entry->individual()->id();
+        QList<QPair<ESource*, QString> > uids = entry->individual()->edsContactUids();
+        if (uids.isEmpty()) {
+            data->m_request << contactId;
+            continue;
+        }
 
-    Q_FOREACH(const ContactEntry *entry, m_contacts->values()) {
-        if (entry->individual()->deletedAt() > since) {
-            QContactSyncTarget syncTarget = entry->individual()->contact().detail<QContactSyncTarget>();
-            if (syncTarget.value(QContactSyncTarget::FieldSyncTarget + 1).toString() == sourceId) {
-                data->m_request << entry->individual()->id();
+        for(int i = 0; i < uids.size(); i++) {
+            RemoveContactsBatch *batch = removeContactsBatch(data, uids.at(i).first, contactId, &batches, &ready);
+            if (batch) {
+                batch->m_uids = g_slist_prepend(batch->m_uids, g_strdup(uids.at(i).second.toUtf8().constData()));
+            } else if (data->m_request.isEmpty() || (data->m_request.last() != contactId)) {
+                // the source is not connected yet, remove the contact through folks
+                data->m_request << contactId;
             }
         }
     }
+    ready << batches.values();
+
+    Q_FOREACH(RemoveContactsBatch *batch, ready) {
+        data->m_pending++;
+        e_book_client_remove_contacts(batch->m_client,
+                                      batch->m_uids,
+                                      NULL,
+                                      (GAsyncReadyCallback) purgeContactsBatchDone,
+                                      batch);
+    }
+
+    removeContactDone(m_individualAggregator, 0, data);
+}
+
+// start the queued updates, the updates of the same contact run in the request order
+void AddressBook::scheduleUpdates()
+{
+    if (m_schedulingUpdates) {
+        return;
+    }
+    m_schedulingUpdates = true;
+
+    int i = 0;
+    while ((i < m_updateQueue.size()) &&
+           (m_runningUpdates.size() < UPDATE_CONTACTS_MAX_IN_FLIGHT)) {
+        QPair<UpdateContactsData*, int> task = m_updateQueue.at(i);
+        const QContact &newContact = task.first->m_contacts.at(task.second);
+        QString contactId = newContact.detail<QContactGuid>().guid();
+        if (m_runningUpdates.contains(contactId)) {
+            i++;
+            continue;
+        }
+
+        // snapshot entries are updated once folks loads them, see setIsReady
+        ContactEntry *entry = contactId.isEmpty() ? 0 : m_contacts->value(contactId);
+        if (entry && !entry->individual()->individual()) {
+            i++;
+            continue;
+        }
+
+        m_updateQueue.removeAt(i);
+        if (!entry) {
+            qWarning() << "Contact not found for update:" << task.first->m_result.at(task.second);
+            updateContactFinished(task, QString(), "Contact not found!");
+            continue;
+        }
+
+        m_runningUpdates.insert(contactId, task);
+        if (!entry->individual()->update(newContact, this, SLOT(updateContactsDone(QString,QString))) &&
+            m_runningUpdates.contains(contactId)) {
+            // nothing changed, the slot is not called
+            updateContactFinished(m_runningUpdates.take(contactId), contactId, QString());
+        }
+    }
 
-    removeContactDone(0, 0, data);
+    m_schedulingUpdates = false;
 }
 
 void AddressBook::updateContactsDone(const QString &contactId,
                                      const QString &error)
 {
-    int currentContactIndex = m_updateCommandResult.size() - m_updateCommandPendingContacts.size() - 1;
+    if (!m_runningUpdates.contains(contactId)) {
+        qWarning() << "Invalid contact updated" << contactId;
+        return;
+    }
+
+    updateContactFinished(m_runningUpdates.take(contactId),
+                          error.isEmpty() ? contactId : QString(),
+                          error);
+    scheduleUpdates();
+}
 
+void AddressBook::updateContactFinished(const QPair<UpdateContactsData*, int> &task,
+                                        const QString &contactId,
+                                        const QString &error)
+{
+    UpdateContactsData *data = task.first;
     if (!error.isEmpty()) {
         // update the result with the error
-        if (currentContactIndex >= 0 &&
-            currentContactIndex < m_updateCommandResult.size()) {
-            m_updateCommandResult[currentContactIndex] = error;
-        } else {
-            qWarning() << "Invalid contact changed index" << currentContactIndex <<
-                          "Contact list size" << m_updateCommandResult.size();
-        }
-    } else if (!contactId.isEmpty()){
+        data->m_result[task.second] = error;
+    } else if (!contactId.isEmpty() && !m_contacts->value(contactId)) {
+        // the contact was removed while it was updated
+        data->m_result[task.second] = "Contact not found!";
+    } else if (!contactId.isEmpty()) {
         // update the result with the new contact info
         ContactEntry *entry = m_contacts->value(contactId);
-        Q_ASSERT(entry);
-        m_updatedIds << contactId;
-        QContact contact = entry->individual()->contact();
-        QString vcard = VCardParser::contactToVcard(contact);
-        if (!vcard.isEmpty()) {
-            m_updateCommandResult[currentContactIndex] = vcard;
-        } else {
-            m_updateCommandResult[currentContactIndex] = "";
+        data->m_updatedIds << contactId;
+        QList<QContactDetail::DetailType> allFields;
+        QString vcard = entry->individual()->cachedVCard(allFields);
+        if (vcard.isEmpty()) {
+            uint revision = entry->individual()->revision();
+            vcard = VCardParser::contactToVcard(entry->individual()->contact());
+            entry->individual()->cacheVCard(allFields, vcard, revision);
         }
+        data->m_result[task.second] = vcard;
         // update contact position on map
         m_contacts->updatePosition(entry);
+        updateViews(entry);
     }
 
-    if (!m_updateCommandPendingContacts.isEmpty()) {
-        QString vCard = m_updateCommandPendingContacts.takeFirst();
-        QContact newContact = VCardParser::vcardToContact(vCard);
-        ContactEntry *entry = m_contacts->value(newContact.detail<QContactGuid>().guid());
-        if (entry) {
-            entry->individual()->update(newContact, this,
-                                        SLOT(updateContactsDone(QString,QString)));
-        } else {
-            qWarning() << "Contact not found for update:" << vCard;
-            updateContactsDone("", "Contact not found!");
-        }
-    } else {
-        QDBusMessage reply = m_updateCommandReplyMessage.createReply(m_updateCommandResult);
-        QDBusConnection::sessionBus().send(reply);
+    data->m_pending--;
+    if (data->m_pending == 0) {
+        updateContactsFinished(data);
+    }
+}
 
-        // notify about the changes
-        m_notifyContactUpdate->insertChangedContacts(m_updatedIds.toSet());
+void AddressBook::updateContactsFinished(UpdateContactsData *data)
+{
+    if (data->m_message.type() != QDBusMessage::InvalidMessage) {
+        QDBusMessage reply = data->m_message.createReply(data->m_result);
+        QDBusConnection::sessionBus().send(reply);
+    }
 
-        // clear command data
-        m_updatedIds.clear();
-        m_updateCommandResult.clear();
-        m_updateCommandReplyMessage = QDBusMessage();
-        m_updateLock.unlock();
+    // notify about the changes
+    if (!data->m_updatedIds.isEmpty()) {
+        m_notifyContactUpdate->insertChangedContacts(data->m_updatedIds.toSet());
     }
+    delete data;
 }
 
 QString AddressBook::removeContact(FolksIndividual *individual, bool *visible)
@@ -1400,7 +2051,10 @@ QString AddressBook::removeContact(FolksIndividual *individual, bool *visible)
     ContactEntry *ci = m_contacts->take(contactId);
     if (ci) {
         *visible = ci->individual()->isVisible();
-        delete ci;
+        Q_FOREACH(View *view, m_views) {
+            view->removeContact(ci);
+        }
+        m_contacts->release(ci);
         return contactId;
     }
     return QString();
@@ -1414,19 +2068,27 @@ QString AddressBook::addContact(FolksIndividual *individual, bool visible)
         entry->individual()->setIndividual(individual);
         entry->individual()->setVisible(visible);
 
-        // update contact position on map
-        m_contacts->updatePosition(entry);
+        // the contact position on the map is updated with the views
+        scheduleViewUpdate(id);
     } else {
-        QIndividual *i = new QIndividual(individual, m_individualAggregator);
-        i->addListener(this, SLOT(individualChanged(QIndividual*)));
-        i->setVisible(visible);
-        m_contacts->insert(new ContactEntry(i));
-        //TODO: Notify view
+        entry = createEntry(individual, visible);
+        m_contacts->insert(entry);
+        Q_FOREACH(View *view, m_views) {
+            view->appendContact(entry);
+        }
     }
 
     return id;
 }
 
+ContactEntry *AddressBook::createEntry(FolksIndividual *individual, bool visible)
+{
+    QIndividual *i = new QIndividual(individual, m_individualAggregator);
+    i->addListener(this, SLOT(individualChanged(QIndividual*)));
+    i->setVisible(visible);
+    return new ContactEntry(i);
+}
+
 void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggregator,
                                        GeeMultiMap *changes,
                                        AddressBook *self)
@@ -1437,6 +2099,13 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
     QSet<QString> addedIds;
     QSet<QString> updatedIds;
     QStringList invisibleSources;
+    // until the aggregator is quiescent the changes contain the whole address book,
+    // the new contacts are inserted on the map at once
+    bool bulkLoad = !self->m_ready;
+    QList<ContactEntry*> newEntries;
+    QHash<QString, ContactEntry*> newEntriesById;
+    // snapshot entries that got their folks individual
+    QSet<ContactEntry*> snapshotEntries;
 
     if (isSafeMode()) {
         invisibleSources = self->m_settings.value(SETTINGS_INVISIBLE_SOURCES).toStringList();
@@ -1487,8 +2156,34 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
             g_object_unref(iter);
         }
 
-        bool exists = self->m_contacts->contains(id);
-        QString cId = self->addContact(individual, visible);
+        ContactEntry *current = self->m_contacts->value(id);
+        bool exists = (current != 0);
+        QString cId;
+        if (bulkLoad && snapshotEntries.contains(current)) {
+            g_object_unref(individual);
+            continue;
+        } else if (bulkLoad && exists && !current->individual()->individual()) {
+            // the contact is already known by the clients, it is not reported again
+            current->individual()->setIndividual(individual);
+            current->individual()->setVisible(visible);
+            snapshotEntries << current;
+            g_object_unref(individual);
+            continue;
+        } else if (bulkLoad && !exists) {
+            ContactEntry *entry = newEntriesById.value(id, 0);
+            if (entry) {
+                entry->individual()->setIndividual(individual);
+                entry->individual()->setVisible(visible);
+            } else {
+                entry = self->createEntry(individual, visible);
+                newEntriesById.insert(id, entry);
+                newEntries << entry;
+            }
+            cId = id;
+        } else {
+            cId = self->addContact(individual, visible);
+        }
+
         if (visible && exists) {
             updatedIds <<  cId;
         } else if (visible) {
@@ -1502,6 +2197,26 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
     g_object_unref(removed);
     g_object_unref(added);
 
+    if (!snapshotEntries.isEmpty()) {
+        self->m_contacts->reinsert(snapshotEntries.toList());
+        Q_FOREACH(View *view, self->m_views) {
+            Q_FOREACH(ContactEntry *entry, snapshotEntries) {
+                view->updateContact(entry);
+            }
+        }
+    }
+
+    if (!newEntries.isEmpty()) {
+        self->m_contacts->insert(newEntries);
+        Q_FOREACH(View *view, self->m_views) {
+            Q_FOREACH(ContactEntry *entry, newEntries) {
+                view->appendContact(entry);
+            }
+        }
+    }
+
+    self->scheduleSnapshot();
+
     if (!removedIds.isEmpty()) {
         self->m_notifyContactUpdate->insertRemovedContacts(removedIds);
     }
@@ -1542,15 +2257,8 @@ void AddressBook::createContactDone(FolksIndividualAggregator *individualAggrega
         qWarning() << "Failed to create individual from contact: Persona already exists";
         reply = createData->m_message.createErrorReply("Failed to create individual from contact", "Contact already exists");
     } else {
-        QIndividual::setExtendedDetails(persona,
-                                        createData->m_contact.details(QContactExtendedDetail::Type),
-                                        QDateTime::currentDateTime());
-        FolksIndividual *individual = folks_persona_get_individual(persona);
-        ContactEntry *entry = createData->m_addressbook->m_contacts->value(QString::fromUtf8(folks_individual_get_id(individual)));
-        if (entry) {
-            // We will need to reload contact due the extended details
-            entry->individual()->flush();
-            QString vcard = VCardParser::contactToVcard(entry->individual()->contact());
+        QString vcard = createData->m_addressbook->personaCreated(persona, createData->m_contact);
+        if (!vcard.isEmpty()) {
             if (createData->m_message.type() != QDBusMessage::InvalidMessage) {
                 reply = createData->m_message.createReply(vcard);
             }
@@ -1565,6 +2273,31 @@ void AddressBook::createContactDone(FolksIndividualAggregator *individualAggrega
     delete createData;
 }
 
+void AddressBook::createContactsDone(FolksIndividualAggregator *individualAggregator,
+                                     GAsyncResult *res,
+                                     void *data)
+{
+    CreateContactsItemData *item = static_cast<CreateContactsItemData*>(data);
+    CreateContactsData *createData = item->m_batch;
+
+    GError *error = NULL;
+    FolksPersona *persona = folks_individual_aggregator_add_persona_from_details_finish(individualAggregator, res, &error);
+    if (error != NULL) {
+        qWarning() << "Failed to create individual from contact:" << error->message;
+        g_clear_error(&error);
+    } else if (persona == NULL) {
+        qWarning() << "Failed to create individual from contact: Persona already exists";
+    } else {
+        // failures keep an empty vcard in the result
+        createData->m_result[item->m_index] =
+            createData->m_addressbook->personaCreated(persona, createData->m_contacts.at(item->m_index));
+    }
+
+    createData->m_pending--;
+    delete item;
+    createData->m_addressbook->createContactsNext(createData);
+}
+
 void AddressBook::isQuiescentChanged(GObject *source, GParamSpec *param, AddressBook *self)
 {
     Q_UNUSED(param);
@@ -1581,23 +2314,11 @@ void AddressBook::quitSignalHandler(int)
      ::write(m_sigQuitFd[0], &a, sizeof(a));
 }
 
-bool AddressBook::processUpdates()
-{
-    int timeout = 10;
-    while(!m_updateLock.tryLock(1000)) {
-        if (timeout <= 0) {
-            return false;
-        }
-        QCoreApplication::processEvents();
-        timeout--;
-    }
-    return true;
-}
-
 int AddressBook::init()
 {
     struct sigaction quit = { { 0 } };
     Source::registerMetaType();
+    PhoneNumberMatch::registerMetaType();
 
     quit.sa_handler = AddressBook::quitSignalHandler;
     sigemptyset(&quit.sa_mask);
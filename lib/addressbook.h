@@ -20,12 +20,17 @@
 #define __GALERA_ADDRESSBOOK_H__
 
 #include "common/source.h"
+#include "common/phone-number-match.h"
 
+#include <QtCore/QHash>
 #include <QtCore/QObject>
+#include <QtCore/QPair>
+#include <QtCore/QSemaphore>
 #include <QtCore/QSet>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QSettings>
+#include <QtCore/QTimer>
 
 #include <QtDBus/QtDBus>
 
@@ -47,6 +52,8 @@ class ContactsMap;
 class AddressBookAdaptor;
 class QIndividual;
 class DirtyContactsNotify;
+class ContactEntry;
+class UpdateContactsData;
 
 class AddressBook: public QObject
 {
@@ -62,8 +69,11 @@ public:
     QString linkContacts(const QStringList &contacts);
     View *query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources);
     QStringList sortFields();
+    QStringList capabilities() const;
+    PhoneNumberMatchList lookupPhoneNumbers(const QStringList &phoneNumbers);
     bool unlinkContacts(const QString &parent, const QStringList &contacts);
     bool isReady() const;
+    bool isQueryReady() const;
     void setSafeMode(bool flag);
 
     static bool isSafeMode();
@@ -72,6 +82,7 @@ public:
 Q_SIGNALS:
     void stopped();
     void readyChanged();
+    void queryReadyChanged();
     void safeModeChanged();
     void sourcesChanged();
 
@@ -84,6 +95,7 @@ public Q_SLOTS:
     SourceList updateSources(const SourceList &sources, const QDBusMessage &message);
     void removeSource(const QString &sourceId, const QDBusMessage &message);
     QString createContact(const QString &contact, const QString &source, const QDBusMessage &message = QDBusMessage());
+    QStringList createContacts(const QStringList &contacts, const QString &source, const QDBusMessage &message = QDBusMessage());
     int removeContacts(const QStringList &contactIds, const QDBusMessage &message);
     QStringList updateContacts(const QStringList &contacts, const QDBusMessage &message);
     void purgeContacts(const QDateTime &since, const QString &sourceId, const QDBusMessage &message);
@@ -92,6 +104,7 @@ public Q_SLOTS:
 private Q_SLOTS:
     void viewClosed();
     void individualChanged(QIndividual *individual);
+    void updateViews();
     void onEdsServiceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
     void onSafeModeChanged();
 
@@ -105,6 +118,8 @@ private Q_SLOTS:
     // check compatibility and if the safe mode should be enabled
     void checkCompatibility();
 
+    void saveSnapshot();
+
 private:
     FolksIndividualAggregator *m_individualAggregator;
     ContactsMap *m_contacts;
@@ -126,12 +141,19 @@ private:
     gulong m_notifyIsQuiescentHandlerId;
     QDBusConnection m_connection;
 
-    // Update command
-    QMutex m_updateLock;
-    QDBusMessage m_updateCommandReplyMessage;
-    QStringList m_updateCommandResult;
-    QStringList m_updatedIds;
-    QStringList m_updateCommandPendingContacts;
+    // Update commands, the contacts waiting and the running ones by contact id
+    QList<QPair<UpdateContactsData*, int> > m_updateQueue;
+    QHash<QString, QPair<UpdateContactsData*, int> > m_runningUpdates;
+    bool m_schedulingUpdates;
+
+    // contacts changed since the last views update
+    QSet<QString> m_pendingViewUpdates;
+
+    // the contacts map contains the snapshot contacts not reconciled with folks yet
+    bool m_snapshotLoaded;
+    QTimer m_snapshotTimer;
+    // available while no snapshot is being saved by the thread pool
+    QSemaphore m_snapshotSaved;
 
     // Unix signals
     static int m_sigQuitFd[2];
@@ -151,16 +173,31 @@ private:
     void prepareUnixSignals();
     static void quitSignalHandler(int unused);
 
-    bool processUpdates();
+    void scheduleUpdates();
+    void updateContactFinished(const QPair<UpdateContactsData*, int> &task,
+                               const QString &contactId,
+                               const QString &error);
+    void updateContactsFinished(UpdateContactsData *data);
     void prepareFolks();
     void unprepareEds();
     void connectWithEDS();
     void continueShutdown();
     void setIsReady(bool isReady);
+    void connectEdsClients();
+    void setSnapshotLoaded(bool loaded);
     bool registerObject(QDBusConnection &connection);
     QString removeContact(FolksIndividual *individual, bool *visible);
     QString addContact(FolksIndividual *individual, bool visible);
+    ContactEntry *createEntry(FolksIndividual *individual, bool visible);
+    void updateViews(ContactEntry *entry);
+    void scheduleViewUpdate(const QString &id);
+    void loadSnapshot();
+    void removeSnapshotEntries();
+    void scheduleSnapshot();
     FolksPersonaStore *getFolksStore(const QString &source);
+    void createContactsNext(void *data);
+    QString personaCreated(FolksPersona *persona, const QtContacts::QContact &contact);
+    static bool phoneNumberMatchLessThan(const PhoneNumberMatch &a, const PhoneNumberMatch &b);
 
     static void availableSourcesDoneListAllSources(FolksBackendStore *backendStore,
                                                    GAsyncResult *res,
@@ -182,9 +219,19 @@ private:
     static void createContactDone(FolksIndividualAggregator *individualAggregator,
                                   GAsyncResult *res,
                                   void *data);
+    static void createContactsDone(FolksIndividualAggregator *individualAggregator,
+                                   GAsyncResult *res,
+                                   void *data);
     static void removeContactDone(FolksIndividualAggregator *individualAggregator,
                                   GAsyncResult *result,
                                   void *data);
+    static void removeContactsBatchDone(GObject *source,
+                                        GAsyncResult *result,
+                                        void *data);
+    static void purgeContactsBatchDone(GObject *source,
+                                       GAsyncResult *result,
+                                       void *data);
+    static void removeContactsFinished(void *data);
     static void createSourceDone(GObject *source,
                                  GAsyncResult *res,
                                  void *data);
@@ -20,43 +20,12 @@
  */
 
 #include "contact-less-than.h"
-#include "contacts-map.h"
-#include "qindividual.h"
-
-#include <QtCore/QTime>
-#include <QtCore/QDebug>
-
-#include <QtContacts/QContactManagerEngine>
-
-using namespace QtContacts;
 
 namespace galera {
 
-ContactLessThan::ContactLessThan(const galera::SortClause &sortClause)
-    : m_sortClause(sortClause)
-{
-}
-
-bool ContactLessThan::operator()(const QtContacts::QContact &contactA, const QtContacts::QContact &contactB)
-{
-    int r = QContactManagerEngine::compareContact(contactA,
-                                                  contactB,
-                                                  m_sortClause.toContactSortOrder());
-    return (r <= 0);
-}
-
-ContactEntryLessThan::ContactEntryLessThan(const SortClause &sortClause)
-    : m_sortClause(sortClause)
-{
-
-}
-
-bool ContactEntryLessThan::operator()(ContactEntry *entryA, ContactEntry *entryB)
+bool ContactLessThan::operator()(const QByteArray &sortKeyA, const QByteArray &sortKeyB) const
 {
-    int r = QContactManagerEngine::compareContact(entryA->individual()->contact(),
-                                                  entryB->individual()->contact(),
-                                                  m_sortClause.toContactSortOrder());
-    return (r <= 0);
+    return (SortClause::compareSortKeys(sortKeyA, sortKeyB) <= 0);
 }
 
 } // namespace
@@ -21,35 +21,15 @@
 
 #include "common/sort-clause.h"
 
-#include <QtCore/QString>
-#include <QtCore/QVariant>
-
-#include <QtContacts/QContact>
+#include <QtCore/QByteArray>
 
 namespace galera {
 
-class ContactEntry;
-
+// compares the keys created by SortClause::sortKey
 class ContactLessThan
 {
 public:
-    ContactLessThan(const SortClause &sortClause);
-
-    bool operator()(const QtContacts::QContact &contactA, const QtContacts::QContact &contactB);
-
-private:
-    SortClause m_sortClause;
-};
-
-class ContactEntryLessThan
-{
-public:
-    ContactEntryLessThan(const SortClause &sortClause);
-
-    bool operator()(ContactEntry *entryA, ContactEntry *entryB);
-
-private:
-    SortClause m_sortClause;
+    bool operator()(const QByteArray &sortKeyA, const QByteArray &sortKeyB) const;
 };
 
 } // namespace
@@ -16,25 +16,38 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "contact-less-than.h"
 #include "contacts-map.h"
 #include "qindividual.h"
 
+#include "common/filter.h"
+
 #include <QtCore/QDebug>
 
 #include <QtContacts/QContactSortOrder>
 #include <QtContacts/QContactDisplayLabel>
 #include <QtContacts/QContactTag>
 #include <QtContacts/QContactPhoneNumber>
+#include <QtContacts/QContactSyncTarget>
 
 #include <phonenumbers/phonenumberutil.h>
 #include <phonenumbers/region_code.h>
 
+// size of the biggest gram stored on the text index
+#define TEXT_INDEX_GRAM_SIZE 3
+// number of secondary sort orders kept in memory
+#define SORTED_INDEXES_MAX 3
+
 using namespace QtContacts;
 
 namespace galera
 {
 
+static bool sortedEntryLessThan(const QPair<QByteArray, ContactEntry*> &a,
+                                const QPair<QByteArray, ContactEntry*> &b)
+{
+    return (SortClause::compareSortKeys(a.first, b.first) < 0);
+}
+
 //ContactInfo
 ContactEntry::ContactEntry(QIndividual *individual)
     : m_individual(individual)
@@ -52,14 +65,37 @@ QIndividual *ContactEntry::individual() const
     return m_individual;
 }
 
+QByteArray ContactEntry::sortKey() const
+{
+    return m_sortKey;
+}
+
+void ContactEntry::setSortKey(const QByteArray &key)
+{
+    m_sortKey = key;
+}
+
+ContactsMapCleaner::ContactsMapCleaner(ContactsMap *map)
+    : m_map(map)
+{
+}
+
+void ContactsMapCleaner::releaseRetired()
+{
+    m_map->release(0);
+}
+
 //ContactMap
 ContactsMap::ContactsMap()
-    : m_sortClause(defaultSort())
+    : m_sortClause(defaultSort()),
+      m_readers(0),
+      m_cleaner(new ContactsMapCleaner(this))
 {
 }
 
 ContactsMap::~ContactsMap()
 {
+    delete m_cleaner;
     clear();
 }
 
@@ -74,7 +110,81 @@ QList<ContactEntry *> ContactsMap::valueByPhone(const QString &phone) const
         return values();
     }
 
-    return m_phoneToEntry.values(minimalNumber(phone));
+    quint32 key = phoneKey(minimalNumber(phone));
+    if (key == 0) {
+        return QList<ContactEntry*>();
+    }
+    return m_phoneToEntry.values(key);
+}
+
+QList<ContactEntry *> ContactsMap::valuesByText(const QList<QStringList> &terms) const
+{
+    if (terms.isEmpty()) {
+        return values();
+    }
+
+    QSet<ContactEntry*> candidates;
+    for(int i = 0; i < terms.size(); i++) {
+        QSet<ContactEntry*> clauseCandidates;
+        Q_FOREACH(const QString &term, terms.at(i)) {
+            clauseCandidates.unite(valuesByText(term));
+        }
+
+        if (i == 0) {
+            candidates = clauseCandidates;
+        } else {
+            candidates.intersect(clauseCandidates);
+        }
+
+        if (candidates.isEmpty()) {
+            return QList<ContactEntry*>();
+        }
+    }
+
+    // keep the map order
+    QList<QPair<int, ContactEntry*> > sorted;
+    Q_FOREACH(ContactEntry *entry, candidates) {
+        sorted << qMakePair(m_contacts.indexOf(entry), entry);
+    }
+    qSort(sorted);
+
+    QList<ContactEntry*> result;
+    for(int i = 0; i < sorted.size(); i++) {
+        result << sorted.at(i).second;
+    }
+    return result;
+}
+
+QSet<ContactEntry*> ContactsMap::valuesByText(const QString &term) const
+{
+    if (term.size() <= TEXT_INDEX_GRAM_SIZE) {
+        return m_gramToEntry.value(term);
+    }
+
+    // start with the smallest set to keep the intersection cheap
+    QList<QSet<ContactEntry*> > sets;
+    for(int i = 0, iMax = term.size() - TEXT_INDEX_GRAM_SIZE; i <= iMax; i++) {
+        QHash<QString, QSet<ContactEntry*> >::const_iterator it =
+                m_gramToEntry.constFind(term.mid(i, TEXT_INDEX_GRAM_SIZE));
+        if (it == m_gramToEntry.constEnd()) {
+            return QSet<ContactEntry*>();
+        }
+
+        if (!sets.isEmpty() && (it.value().size() < sets.first().size())) {
+            sets.prepend(it.value());
+        } else {
+            sets.append(it.value());
+        }
+    }
+
+    QSet<ContactEntry*> result = sets.takeFirst();
+    Q_FOREACH(const QSet<ContactEntry*> &set, sets) {
+        result.intersect(set);
+        if (result.isEmpty()) {
+            break;
+        }
+    }
+    return result;
 }
 
 QList<ContactEntry *> ContactsMap::values(const QStringList &ids) const
@@ -89,6 +199,21 @@ QList<ContactEntry *> ContactsMap::values(const QStringList &ids) const
     return result;
 }
 
+QList<ContactEntry*> ContactsMap::valuesDeletedSince(const QString &sourceId, const QDateTime &since) const
+{
+    QList<ContactEntry*> result;
+    QHash<QString, QMultiMap<QDateTime, ContactEntry*> >::const_iterator source = m_deletedToEntry.constFind(sourceId);
+    if (source == m_deletedToEntry.constEnd()) {
+        return result;
+    }
+
+    QMultiMap<QDateTime, ContactEntry*>::const_iterator it = source.value().upperBound(since);
+    for(; it != source.value().constEnd(); it++) {
+        result << it.value();
+    }
+    return result;
+}
+
 ContactEntry *ContactsMap::take(FolksIndividual *individual)
 {
     QString contactId = QString::fromUtf8(folks_individual_get_id(individual));
@@ -116,30 +241,71 @@ void ContactsMap::insert(ContactEntry *entry)
     insertData(entry);
 }
 
-void ContactsMap::updatePosition(ContactEntry *entry)
+void ContactsMap::insert(const QList<ContactEntry*> &entries)
 {
     QWriteLocker locker(&m_mutex);
-    if (!m_sortClause.isEmpty()) {
-        int oldPos = m_contacts.indexOf(entry);
+    insertData(entries);
+}
 
-        ContactEntryLessThan lessThan(m_sortClause);
-        QList<ContactEntry*>::iterator it(std::upper_bound(m_contacts.begin(), m_contacts.end(), entry, lessThan));
+void ContactsMap::reinsert(const QList<ContactEntry*> &entries)
+{
+    QWriteLocker locker(&m_mutex);
+    Q_FOREACH(ContactEntry *entry, entries) {
+        removeData(entry, false);
+    }
+    insertData(entries);
+}
 
-        if (it != m_contacts.end()) {
-            int newPos = std::distance(m_contacts.begin(), it);
-            if (oldPos != newPos) {
-                m_contacts.move(oldPos, newPos);
-            }
-        } else if (oldPos != (m_contacts.size() - 1)) {
-            m_contacts.move(oldPos, m_contacts.size() -1);
+void ContactsMap::insertData(const QList<ContactEntry*> &entries)
+{
+    QList<QPair<QByteArray, ContactEntry*> > sorted;
+    Q_FOREACH(ContactEntry *entry, entries) {
+        if (!entry->individual()->id().isEmpty()) {
+            insertIndexData(entry);
+            updateSortKey(entry);
+            sorted << qMakePair(entry->sortKey(), entry);
         }
     }
 
-    // update phone number map
-    Q_FOREACH(const QString &key, m_phoneToEntry.keys(entry)) {
-        m_phoneToEntry.remove(key, entry);
+    // sort the new entries once and merge them with the current ones
+    mergeSorted(&m_contacts, sorted);
+
+    Q_FOREACH(SortedIndex *index, m_sortedIndexes) {
+        QList<QContactDetail::DetailType> detailTypes = index->clause.detailTypes();
+        QList<QPair<QByteArray, ContactEntry*> > indexSorted;
+        for(int i = 0; i < sorted.size(); i++) {
+            ContactEntry *entry = sorted.at(i).second;
+            indexSorted << qMakePair(index->clause.sortKey(entry->individual()->contact(detailTypes)), entry);
+        }
+        mergeSorted(&index->entries, indexSorted);
+    }
+}
+
+void ContactsMap::updatePosition(ContactEntry *entry)
+{
+    QWriteLocker locker(&m_mutex);
+    if (!m_sortClause.isEmpty()) {
+        updateSortKey(entry);
+        m_contacts.update(entry, entry->sortKey());
+    }
+
+    Q_FOREACH(SortedIndex *index, m_sortedIndexes) {
+        updateSorted(index, entry);
     }
-    insertData(entry->individual()->contact().details<QContactPhoneNumber>(), entry);
+
+    // update phone number map
+    removePhoneData(entry);
+    QList<QContactDetail::DetailType> phoneTypes;
+    phoneTypes << QContactDetail::TypePhoneNumber;
+    insertData(entry->individual()->contact(phoneTypes).details<QContactPhoneNumber>(), entry);
+
+    // update text index
+    removeTextData(entry);
+    insertTextData(entry);
+
+    // update deleted index
+    removeDeletedData(entry);
+    insertDeletedData(entry);
 }
 
 int ContactsMap::size() const
@@ -153,8 +319,20 @@ void ContactsMap::clear()
     QList<ContactEntry*> entries = m_idToEntry.values();
     m_idToEntry.clear();
     m_phoneToEntry.clear();
+    m_entryToPhone.clear();
+    m_gramToEntry.clear();
+    m_entryToGram.clear();
+    m_deletedToEntry.clear();
+    m_entryToDeleted.clear();
     m_contacts.clear();
+    qDeleteAll(m_sortedIndexes);
+    m_sortedIndexes.clear();
     qDeleteAll(entries);
+
+    QMutexLocker readersLocker(&m_readersLock);
+    Q_ASSERT(m_readers == 0);
+    qDeleteAll(m_retiredEntries);
+    m_retiredEntries.clear();
 }
 
 void ContactsMap::lockForRead()
@@ -167,15 +345,72 @@ void ContactsMap::unlock()
     m_mutex.unlock();
 }
 
+void ContactsMap::pin()
+{
+    QMutexLocker locker(&m_readersLock);
+    m_readers++;
+}
+
+void ContactsMap::unpin()
+{
+    // the last reader schedules the deletion of the retired entries on the
+    // writer thread, where the map was created
+    QMutexLocker locker(&m_readersLock);
+    m_readers--;
+    if ((m_readers == 0) && !m_retiredEntries.isEmpty()) {
+        QMetaObject::invokeMethod(m_cleaner, "releaseRetired", Qt::QueuedConnection);
+    }
+}
+
+void ContactsMap::release(ContactEntry *entry)
+{
+    QMutexLocker locker(&m_readersLock);
+    if (entry) {
+        m_retiredEntries << entry;
+    }
+    if (m_readers == 0) {
+        qDeleteAll(m_retiredEntries);
+        m_retiredEntries.clear();
+    }
+}
+
 QList<ContactEntry*> ContactsMap::values() const
 {
-    return m_contacts;
+    return m_contacts.values();
+}
+
+int ContactsMap::indexOf(ContactEntry *entry) const
+{
+    return m_contacts.indexOf(entry);
+}
+
+ContactEntry *ContactsMap::at(int pos) const
+{
+    return m_contacts.at(pos);
+}
+
+QList<ContactEntry*> ContactsMap::values(const SortClause &clause, QList<QByteArray> *sortKeys)
+{
+    if (clause.toContactSortOrder() == m_sortClause.toContactSortOrder()) {
+        if (sortKeys) {
+            *sortKeys = m_contacts.sortKeys();
+        }
+        return m_contacts.values();
+    }
+
+    // this is called by the views with the map locked for read
+    QMutexLocker locker(&m_sortedIndexesLock);
+    SortedIndex *index = sortedIndex(clause);
+    if (sortKeys) {
+        *sortKeys = index->entries.sortKeys();
+    }
+    return index->entries.values();
 }
 
 QList<QContact> ContactsMap::contacts() const
 {
     QList<QContact> result;
-    Q_FOREACH(ContactEntry *e, m_contacts) {
+    Q_FOREACH(ContactEntry *e, m_contacts.values()) {
         result << e->individual()->contact();
     }
     return result;
@@ -190,10 +425,37 @@ void ContactsMap::sertSort(const SortClause &clause)
 {
     if (clause.toContactSortOrder() != m_sortClause.toContactSortOrder()) {
         m_sortClause = clause;
-        if (!m_sortClause.isEmpty()) {
-            ContactEntryLessThan lessThan(m_sortClause);
-            qSort(m_contacts.begin(), m_contacts.end(), lessThan);
+
+        // reuse the secondary index if there is one for this sort
+        for(int i = 0; i < m_sortedIndexes.size(); i++) {
+            SortedIndex *index = m_sortedIndexes.at(i);
+            if (index->clause.toContactSortOrder() == clause.toContactSortOrder()) {
+                QList<ContactEntry*> entries = index->entries.values();
+                QList<QByteArray> sortKeys = index->entries.sortKeys();
+                for(int e = 0; e < entries.size(); e++) {
+                    entries.at(e)->setSortKey(sortKeys.at(e));
+                }
+                m_contacts.assign(entries, sortKeys);
+                delete m_sortedIndexes.takeAt(i);
+                return;
+            }
+        }
+
+        // keep the current order for contacts with the same key
+        QList<QPair<QByteArray, ContactEntry*> > sorted;
+        Q_FOREACH(ContactEntry *entry, m_contacts.values()) {
+            updateSortKey(entry);
+            sorted << qMakePair(entry->sortKey(), entry);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), sortedEntryLessThan);
+
+        QList<ContactEntry*> entries;
+        QList<QByteArray> sortKeys;
+        for(int i = 0; i < sorted.size(); i++) {
+            sortKeys << sorted.at(i).first;
+            entries << sorted.at(i).second;
         }
+        m_contacts.assign(entries, sortKeys);
     }
 }
 
@@ -262,12 +524,15 @@ ContactEntry *ContactsMap::value(FolksIndividual *individual) const
 void ContactsMap::removeData(ContactEntry *entry, bool del)
 {
     if (entry) {
-        Q_FOREACH(const QString &key,  m_phoneToEntry.keys(entry)) {
-            m_phoneToEntry.remove(key, entry);
+        removePhoneData(entry);
+        removeTextData(entry);
+        removeDeletedData(entry);
+        m_contacts.remove(entry);
+        Q_FOREACH(SortedIndex *index, m_sortedIndexes) {
+            index->entries.remove(entry);
         }
-        m_contacts.removeOne(entry);
         if (del) {
-            delete entry;
+            release(entry);
         }
     }
 
@@ -275,35 +540,247 @@ void ContactsMap::removeData(ContactEntry *entry, bool del)
 
 void ContactsMap::insertData(ContactEntry *entry)
 {
-    FolksIndividual *fIndividual = entry->individual()->individual();
+    if (!entry->individual()->id().isEmpty()) {
+        insertIndexData(entry);
 
+        // fill contact list
+        // without sort clause all keys are empty and the entry goes to the end
+        updateSortKey(entry);
+        m_contacts.insert(entry, entry->sortKey());
 
-    if (fIndividual) {
-        // fill id map
-        m_idToEntry.insert(folks_individual_get_id(fIndividual), entry);
+        Q_FOREACH(SortedIndex *index, m_sortedIndexes) {
+            updateSorted(index, entry);
+        }
+    }
+}
 
-        // fill contact list
-        if (!m_sortClause.isEmpty()) {
-            ContactEntryLessThan lessThan(m_sortClause);
-            QList<ContactEntry*>::iterator it(std::upper_bound(m_contacts.begin(), m_contacts.end(), entry, lessThan));
-            m_contacts.insert(it, entry);
-        } else {
-            m_contacts.append(entry);
+void ContactsMap::insertIndexData(ContactEntry *entry)
+{
+    // fill id map
+    m_idToEntry.insert(entry->individual()->id(), entry);
+
+    // fill phone map
+    QList<QContactDetail::DetailType> phoneTypes;
+    phoneTypes << QContactDetail::TypePhoneNumber;
+    insertData(entry->individual()->contact(phoneTypes).details<QContactPhoneNumber>(), entry);
+
+    // fill text index
+    insertTextData(entry);
+
+    // fill deleted index
+    insertDeletedData(entry);
+}
+
+void ContactsMap::updateSortKey(ContactEntry *entry)
+{
+    if (m_sortClause.isEmpty()) {
+        entry->setSortKey(QByteArray());
+    } else {
+        // only the details used by the sort are loaded
+        const QContact &contact = entry->individual()->contact(m_sortClause.detailTypes());
+        entry->setSortKey(m_sortClause.sortKey(contact));
+    }
+}
+
+ContactsMap::SortedIndex *ContactsMap::sortedIndex(const SortClause &clause)
+{
+    for(int i = 0; i < m_sortedIndexes.size(); i++) {
+        SortedIndex *index = m_sortedIndexes.at(i);
+        if (index->clause.toContactSortOrder() == clause.toContactSortOrder()) {
+            m_sortedIndexes.move(i, 0);
+            return index;
         }
+    }
 
-        // fill phone map
-        insertData(entry->individual()->contact().details<QContactPhoneNumber>(), entry);
+    // build the index once, after that it is updated with the map changes
+    QList<QContactDetail::DetailType> detailTypes = clause.detailTypes();
+    QList<QPair<QByteArray, ContactEntry*> > sorted;
+    Q_FOREACH(ContactEntry *entry, m_contacts.values()) {
+        sorted << qMakePair(clause.sortKey(entry->individual()->contact(detailTypes)), entry);
     }
+    std::stable_sort(sorted.begin(), sorted.end(), sortedEntryLessThan);
+
+    QList<ContactEntry*> entries;
+    QList<QByteArray> sortKeys;
+    for(int i = 0; i < sorted.size(); i++) {
+        sortKeys << sorted.at(i).first;
+        entries << sorted.at(i).second;
+    }
+
+    SortedIndex *index = new SortedIndex(clause);
+    index->entries.assign(entries, sortKeys);
+
+    m_sortedIndexes.prepend(index);
+    if (m_sortedIndexes.size() > SORTED_INDEXES_MAX) {
+        delete m_sortedIndexes.takeLast();
+    }
+    return index;
+}
+
+void ContactsMap::updateSorted(SortedIndex *index, ContactEntry *entry)
+{
+    QByteArray key = index->clause.sortKey(entry->individual()->contact(index->clause.detailTypes()));
+    index->entries.update(entry, key);
+}
+
+// the list entries go after the current entries with the same key
+void ContactsMap::mergeSorted(SortedEntryList *list, QList<QPair<QByteArray, ContactEntry*> > &entries)
+{
+    if (entries.isEmpty()) {
+        return;
+    }
+    std::stable_sort(entries.begin(), entries.end(), sortedEntryLessThan);
+
+    QList<ContactEntry*> currentEntries = list->values();
+    QList<QByteArray> currentKeys = list->sortKeys();
+    QList<ContactEntry*> mergedEntries;
+    QList<QByteArray> mergedKeys;
+    mergedEntries.reserve(currentEntries.size() + entries.size());
+    mergedKeys.reserve(currentEntries.size() + entries.size());
+
+    int c = 0;
+    int n = 0;
+    while ((c < currentEntries.size()) || (n < entries.size())) {
+        if ((n >= entries.size()) ||
+            ((c < currentEntries.size()) &&
+             (SortClause::compareSortKeys(currentKeys.at(c), entries.at(n).first) <= 0))) {
+            mergedEntries << currentEntries.at(c);
+            mergedKeys << currentKeys.at(c);
+            c++;
+        } else {
+            mergedEntries << entries.at(n).second;
+            mergedKeys << entries.at(n).first;
+            n++;
+        }
+    }
+    list->assign(mergedEntries, mergedKeys);
 }
 
 void ContactsMap::insertData(const QList<QContactPhoneNumber> &numbers, ContactEntry *entry)
 {
+    QList<quint32> keys;
     Q_FOREACH(const QContactPhoneNumber &phone, numbers) {
-        QString mNumber = minimalNumber(phone.number());
-        if (!mNumber.isEmpty()) {
-            m_phoneToEntry.insert(mNumber, entry);
+        quint32 key = phoneKey(minimalNumber(phone.number()));
+        if ((key != 0) && !keys.contains(key)) {
+            m_phoneToEntry.insert(key, entry);
+            keys << key;
+        }
+    }
+    if (!keys.isEmpty()) {
+        m_entryToPhone.insert(entry, keys);
+    }
+}
+
+void ContactsMap::removePhoneData(ContactEntry *entry)
+{
+    Q_FOREACH(quint32 key, m_entryToPhone.take(entry)) {
+        m_phoneToEntry.remove(key, entry);
+    }
+}
+
+void ContactsMap::insertTextData(ContactEntry *entry)
+{
+    const QContact &contact = entry->individual()->contact(Filter::textIndexedDetails());
+
+    QSet<QString> grams;
+    Q_FOREACH(QContactDetail::DetailType type, Filter::textIndexedDetails()) {
+        Q_FOREACH(const QContactDetail &detail, contact.details(type)) {
+            Q_FOREACH(const QVariant &value, detail.values()) {
+                if (value.type() == QVariant::String) {
+                    grams.unite(textGrams(value.toString().toCaseFolded()).toSet());
+                }
+            }
+        }
+    }
+
+    Q_FOREACH(const QString &gram, grams) {
+        m_gramToEntry[gram].insert(entry);
+    }
+    m_entryToGram.insert(entry, grams.toList());
+}
+
+void ContactsMap::removeTextData(ContactEntry *entry)
+{
+    Q_FOREACH(const QString &gram, m_entryToGram.take(entry)) {
+        QHash<QString, QSet<ContactEntry*> >::iterator it = m_gramToEntry.find(gram);
+        if (it != m_gramToEntry.end()) {
+            it.value().remove(entry);
+            if (it.value().isEmpty()) {
+                m_gramToEntry.erase(it);
+            }
+        }
+    }
+}
+
+void ContactsMap::insertDeletedData(ContactEntry *entry)
+{
+    QDateTime deletedAt = entry->individual()->deletedAt();
+    if (!deletedAt.isValid()) {
+        return;
+    }
+
+    // same source id used by the sync targets (see QIndividual::getSyncTargets)
+    QList<QContactDetail::DetailType> syncTargetTypes;
+    syncTargetTypes << QContactDetail::TypeSyncTarget;
+    QContactSyncTarget syncTarget = entry->individual()->contact(syncTargetTypes).detail<QContactSyncTarget>();
+    QString sourceId = syncTarget.value(QContactSyncTarget::FieldSyncTarget + 1).toString();
+
+    m_deletedToEntry[sourceId].insert(deletedAt, entry);
+    m_entryToDeleted.insert(entry, qMakePair(sourceId, deletedAt));
+}
+
+void ContactsMap::removeDeletedData(ContactEntry *entry)
+{
+    QHash<ContactEntry*, QPair<QString, QDateTime> >::iterator deleted = m_entryToDeleted.find(entry);
+    if (deleted == m_entryToDeleted.end()) {
+        return;
+    }
+
+    QHash<QString, QMultiMap<QDateTime, ContactEntry*> >::iterator it = m_deletedToEntry.find(deleted.value().first);
+    if (it != m_deletedToEntry.end()) {
+        it.value().remove(deleted.value().second, entry);
+        if (it.value().isEmpty()) {
+            m_deletedToEntry.erase(it);
+        }
+    }
+    m_entryToDeleted.erase(deleted);
+}
+
+// return all substrings with size up to TEXT_INDEX_GRAM_SIZE, any text that contains
+// a term also contains all grams of this term
+QStringList ContactsMap::textGrams(const QString &text)
+{
+    QStringList grams;
+    for(int i = 0; i < text.size(); i++) {
+        for(int size = 1; (size <= TEXT_INDEX_GRAM_SIZE) && ((i + size) <= text.size()); size++) {
+            grams << text.mid(i, size);
+        }
+    }
+    return grams;
+}
+
+// pack the minimalNumber result (up to 7 diallable chars) in 4 bits per char,
+// no char is encoded as 0 so numbers with different sizes never collide and
+// 0 means an empty number
+quint32 ContactsMap::phoneKey(const QString &minimalNumber)
+{
+    quint32 key = 0;
+    Q_FOREACH(const QChar &c, minimalNumber) {
+        quint32 code;
+        if (c.isDigit()) {
+            code = c.digitValue() + 1;
+        } else if (c == QLatin1Char('+')) {
+            code = 11;
+        } else if (c == QLatin1Char('*')) {
+            code = 12;
+        } else if (c == QLatin1Char('#')) {
+            code = 13;
+        } else {
+            code = 14;
         }
+        key = (key << 4) | code;
     }
+    return key;
 }
 
 QString ContactsMap::minimalNumber(const QString &phone) const
@@ -19,11 +19,19 @@
 #ifndef __GALERA_CONTACTS_MAP_PRIV_H__
 #define __GALERA_CONTACTS_MAP_PRIV_H__
 
+#include "sorted-entry-list.h"
+
 #include "common/sort-clause.h"
 
+#include <QtCore/QObject>
 #include <QtCore/QString>
+#include <QtCore/QDateTime>
 #include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QMutex>
 
 #include <QtContacts/QContactPhoneNumber>
 
@@ -35,6 +43,22 @@ namespace galera
 {
 
 class QIndividual;
+class ContactsMap;
+
+// deletes the retired entries of the map on the thread that writes the map
+class ContactsMapCleaner : public QObject
+{
+    Q_OBJECT
+
+public:
+    ContactsMapCleaner(ContactsMap *map);
+
+public Q_SLOTS:
+    void releaseRetired();
+
+private:
+    ContactsMap *m_map;
+};
 
 class ContactEntry
 {
@@ -44,11 +68,16 @@ public:
 
     QIndividual *individual() const;
 
+    // key for the current ContactsMap sort clause
+    QByteArray sortKey() const;
+    void setSortKey(const QByteArray &key);
+
 private:
     ContactEntry();
     ContactEntry(const ContactEntry &other);
 
     QIndividual *m_individual;
+    QByteArray m_sortKey;
 };
 
 
@@ -66,19 +95,38 @@ public:
     ContactEntry *value(FolksIndividual *individual) const;
     ContactEntry *value(const QString &id) const;
     QList<ContactEntry*> valueByPhone(const QString &phone) const;
+    QList<ContactEntry*> valuesByText(const QList<QStringList> &terms) const;
     QList<ContactEntry*> values(const QStringList &ids) const;
+    // soft deleted entries of the source deleted after the date, the oldest first
+    QList<ContactEntry*> valuesDeletedSince(const QString &sourceId, const QDateTime &since) const;
 
     ContactEntry *take(FolksIndividual *individual);
     ContactEntry *take(const QString &id);
 
     void remove(const QString &id);
     void insert(ContactEntry *entry);
+    // insert all entries at once, used to load the address book
+    void insert(const QList<ContactEntry*> &entries);
+    // index again entries already on the map at once, used when the snapshot
+    // entries get their folks individuals
+    void reinsert(const QList<ContactEntry*> &entries);
     void updatePosition(ContactEntry *entry);
     int size() const;
     void clear();
     void lockForRead();
     void unlock();
+
+    // the entries read while the map is pinned stay alive until unpin, this allows
+    // the readers to release the lock and keep using the entries
+    void pin();
+    void unpin();
+    // delete the entry removed from the map once there is no reader using it
+    void release(ContactEntry *entry);
     QList<ContactEntry*> values() const;
+    // position of the entry in the map sort order
+    int indexOf(ContactEntry *entry) const;
+    ContactEntry *at(int pos) const;
+    QList<ContactEntry*> values(const SortClause &clause, QList<QByteArray> *sortKeys);
     QList<QtContacts::QContact> contacts() const;
     QStringList keys() const;
 
@@ -88,17 +136,58 @@ public:
     static SortClause defaultSort();
 
 private:
+    struct SortedIndex
+    {
+        SortedIndex(const SortClause &sortClause) : clause(sortClause) {}
+
+        SortClause clause;
+        SortedEntryList entries;
+    };
+
     QHash<QString, ContactEntry*> m_idToEntry;
-    QMultiMap<QString, ContactEntry*> m_phoneToEntry;
+    // phone index keyed by the packed minimalNumber suffix, each entry keeps
+    // its own keys to make the removal proportional to its phone count
+    QMultiHash<quint32, ContactEntry*> m_phoneToEntry;
+    QHash<ContactEntry*, QList<quint32> > m_entryToPhone;
+    // n-gram index of the text details used by the filters (see Filter::textToFilter)
+    QHash<QString, QSet<ContactEntry*> > m_gramToEntry;
+    QHash<ContactEntry*, QStringList> m_entryToGram;
+    // soft deleted entries by source id ordered by the deletion date
+    QHash<QString, QMultiMap<QDateTime, ContactEntry*> > m_deletedToEntry;
+    QHash<ContactEntry*, QPair<QString, QDateTime> > m_entryToDeleted;
     // sorted contacts
-    QList<ContactEntry*> m_contacts;
+    SortedEntryList m_contacts;
     SortClause m_sortClause;
+    // secondary sorted lists for the views using other sort clauses,
+    // the most recently used first
+    QList<SortedIndex*> m_sortedIndexes;
+    QMutex m_sortedIndexesLock;
     QReadWriteLock m_mutex;
+    // removed entries waiting for the readers
+    QList<ContactEntry*> m_retiredEntries;
+    int m_readers;
+    QMutex m_readersLock;
+    ContactsMapCleaner *m_cleaner;
 
     void removeData(ContactEntry *entry, bool del);
     void insertData(ContactEntry *entry);
+    void insertData(const QList<ContactEntry*> &entries);
+    void insertIndexData(ContactEntry *entry);
     void insertData(const QList<QtContacts::QContactPhoneNumber> &numbers, ContactEntry *entry);
+    void removePhoneData(ContactEntry *entry);
+    void insertTextData(ContactEntry *entry);
+    void removeTextData(ContactEntry *entry);
+    void insertDeletedData(ContactEntry *entry);
+    void removeDeletedData(ContactEntry *entry);
+    void updateSortKey(ContactEntry *entry);
+    SortedIndex *sortedIndex(const SortClause &clause);
+    void updateSorted(SortedIndex *index, ContactEntry *entry);
+    static void mergeSorted(SortedEntryList *list, QList<QPair<QByteArray, ContactEntry*> > &entries);
+    QSet<ContactEntry*> valuesByText(const QString &term) const;
     QString minimalNumber(const QString &phone) const;
+
+    static QStringList textGrams(const QString &text);
+    static quint32 phoneKey(const QString &minimalNumber);
 };
 
 } //namespace
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "contacts-snapshot.h"
+#include "contacts-map.h"
+#include "qindividual.h"
+
+#include "common/contact-codec.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+
+#define SNAPSHOT_MAGIC      0x47435331 // "GCS1"
+// increase it every time the format changes, old snapshots are ignored
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_STREAM     QDataStream::Qt_5_0
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+QString ContactsSnapshot::path()
+{
+    QString envPath = QString::fromUtf8(qgetenv(ADDRESS_BOOK_SNAPSHOT));
+    if (envPath.toLower() == "off") {
+        return QString();
+    } else if (!envPath.isEmpty()) {
+        return envPath;
+    }
+
+    return QString("%1/address-book-service/contacts.snapshot")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+}
+
+bool ContactsSnapshot::save(const QString &path, const QList<ContactEntry*> &entries)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // the snapshot has the whole address book, only the user can read it
+    QString dirPath = QFileInfo(path).absolutePath();
+    if (!QDir(dirPath).exists() && QDir().mkpath(dirPath)) {
+        QFile::setPermissions(dirPath, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Fail to write contacts snapshot" << path << file.errorString();
+        return false;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    QDataStream stream(&file);
+    stream.setVersion(SNAPSHOT_STREAM);
+    stream << quint32(SNAPSHOT_MAGIC) << quint32(SNAPSHOT_VERSION) << quint32(entries.size());
+    Q_FOREACH(ContactEntry *entry, entries) {
+        QIndividual *individual = entry->individual();
+        QDateTime deletedAt = individual->deletedAt();
+        stream << individual->id()
+               << individual->isVisible()
+               << (deletedAt.isValid() ? deletedAt.toString(Qt::ISODate) : QString())
+               << ContactCodec::encodeContact(individual->contact());
+    }
+
+    if ((stream.status() != QDataStream::Ok) || !file.commit()) {
+        qWarning() << "Fail to write contacts snapshot" << path;
+        return false;
+    }
+    qDebug() << "Contacts snapshot saved:" << entries.size() << "contacts in" << timer.elapsed() << "ms";
+    return true;
+}
+
+QList<ContactEntry*> ContactsSnapshot::load(const QString &path, FolksIndividualAggregator *aggregator)
+{
+    QList<ContactEntry*> entries;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || (file.size() == 0)) {
+        return entries;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the records are decoded straight from the mapped file
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        qWarning() << "Fail to map contacts snapshot" << path;
+        return entries;
+    }
+
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(data), file.size());
+    QDataStream stream(raw);
+    stream.setVersion(SNAPSHOT_STREAM);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    bool valid = (stream.status() == QDataStream::Ok) &&
+                 (magic == SNAPSHOT_MAGIC) &&
+                 (version == SNAPSHOT_VERSION);
+
+    for(quint32 i = 0; valid && (i < count); i++) {
+        QString id;
+        bool visible = true;
+        QString deletedAt;
+        QByteArray record;
+        stream >> id >> visible >> deletedAt >> record;
+        valid = (stream.status() == QDataStream::Ok);
+
+        QContact contact;
+        if (valid) {
+            contact = ContactCodec::decodeContact(record, &valid);
+        }
+        if (valid) {
+            QIndividual *individual = new QIndividual(contact,
+                                                      QDateTime::fromString(deletedAt, Qt::ISODate),
+                                                      aggregator);
+            individual->setVisible(visible);
+            valid = (individual->id() == id);
+            entries << new ContactEntry(individual);
+        }
+    }
+
+    file.unmap(data);
+
+    if (!valid) {
+        qWarning() << "Invalid contacts snapshot" << path;
+        qDeleteAll(entries);
+        entries.clear();
+    } else {
+        qDebug() << "Contacts snapshot loaded:" << entries.size() << "contacts in" << timer.elapsed() << "ms";
+    }
+    return entries;
+}
+
+} //namespace
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_CONTACTS_SNAPSHOT_H__
+#define __GALERA_CONTACTS_SNAPSHOT_H__
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include <folks/folks.h>
+
+namespace galera
+{
+
+class ContactEntry;
+
+// Copy of the contacts map stored on disk, it is used to answer the queries
+// while folks is loading the contacts
+class ContactsSnapshot
+{
+public:
+    // return an empty path if the snapshot is disabled
+    static QString path();
+
+    static bool save(const QString &path, const QList<ContactEntry*> &entries);
+    // the entries are not linked with any folks individual
+    static QList<ContactEntry*> load(const QString &path, FolksIndividualAggregator *aggregator);
+};
+
+} //namespace
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+#include "eds-client-cache.h"
+
+#include <QtCore/QDebug>
+
+#include <libebook/libebook.h>
+
+namespace galera
+{
+
+QHash<QString, EBookClient*> EdsClientCache::m_clients;
+QSet<QString> EdsClientCache::m_connecting;
+
+EBookClient *EdsClientCache::client(ESource *source)
+{
+    QString uid = QString::fromUtf8(e_source_get_uid(source));
+    EBookClient *client = m_clients.value(uid, 0);
+    if (!client) {
+        connect(source);
+        return 0;
+    }
+    return E_BOOK_CLIENT(g_object_ref(client));
+}
+
+void EdsClientCache::connect(ESource *source)
+{
+    QString uid = QString::fromUtf8(e_source_get_uid(source));
+    if (m_clients.contains(uid) || m_connecting.contains(uid)) {
+        return;
+    }
+
+    m_connecting << uid;
+    E_BOOK_CLIENT_CONNECT(source, NULL,
+                          (GAsyncReadyCallback) connectDone,
+                          g_strdup(e_source_get_uid(source)));
+}
+
+void EdsClientCache::connectDone(GObject *source, GAsyncResult *res, gpointer data)
+{
+    Q_UNUSED(source);
+
+    QString uid = QString::fromUtf8(static_cast<gchar*>(data));
+    g_free(data);
+
+    GError *error = NULL;
+    EClient *newClient = e_book_client_connect_finish(res, &error);
+    if (error) {
+        qWarning() << "Fail to connect with EDS" << uid << error->message;
+        g_error_free(error);
+        m_connecting.remove(uid);
+        return;
+    }
+
+    // the cache was cleared while the client was connecting
+    if (!m_connecting.remove(uid)) {
+        g_object_unref(newClient);
+        return;
+    }
+
+    EBookClient *client = E_BOOK_CLIENT(newClient);
+    g_signal_connect(client, "backend-died", (GCallback) backendDied, NULL);
+    m_clients.insert(uid, client);
+}
+
+void EdsClientCache::clear()
+{
+    Q_FOREACH(EBookClient *client, m_clients.values()) {
+        g_signal_handlers_disconnect_by_func(client, (gpointer) backendDied, NULL);
+        g_object_unref(client);
+    }
+    m_clients.clear();
+    m_connecting.clear();
+}
+
+void EdsClientCache::backendDied(EBookClient *client, gpointer data)
+{
+    Q_UNUSED(data);
+
+    QString uid = m_clients.key(client);
+    if (!uid.isEmpty()) {
+        qWarning() << "EDS backend died for source" << uid;
+        m_clients.remove(uid);
+        g_signal_handlers_disconnect_by_func(client, (gpointer) backendDied, NULL);
+        g_object_unref(client);
+    }
+}
+
+} //namespace
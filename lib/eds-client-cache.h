@@ -0,0 +1,58 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __GALERA_EDS_CLIENT_CACHE_H__
+#define __GALERA_EDS_CLIENT_CACHE_H__
+
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+typedef struct _ESource ESource;
+typedef struct _EBookClient EBookClient;
+
+namespace galera
+{
+
+// EDS clients shared by all writes of the same source, it is used only on the main thread
+class EdsClientCache
+{
+public:
+    // return a new reference of the client or 0 if it is not connected yet,
+    // the connection never blocks: it starts in background and the caller
+    // must write through folks until it is done
+    static EBookClient *client(ESource *source);
+    // start the connection with the source in background
+    static void connect(ESource *source);
+    static void clear();
+
+private:
+    static QHash<QString, EBookClient*> m_clients;
+    static QSet<QString> m_connecting;
+
+    static void connectDone(GObject *source, GAsyncResult *res, gpointer data);
+    static void backendDied(EBookClient *client, gpointer data);
+};
+
+} //namespace
+
+#endif
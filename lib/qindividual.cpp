@@ -21,6 +21,7 @@
 #include "gee-utils.h"
 #include "update-contact-request.h"
 #include "e-source-ubuntu.h"
+#include "eds-client-cache.h"
 
 #include "common/vcard-parser.h"
 
@@ -55,6 +56,9 @@
 
 #include "config.h"
 
+// number of different field sets cached for each contact
+#define VCARD_CACHE_SIZE 2
+
 using namespace QtVersit;
 using namespace QtContacts;
 
@@ -155,9 +159,38 @@ QStringList QIndividual::m_supportedExtendedDetails;
 QIndividual::QIndividual(FolksIndividual *individual, FolksIndividualAggregator *aggregator)
     : m_individual(0),
       m_aggregator(aggregator),
-      m_contact(0),
+      m_loadedGroups(0),
+      m_fallbackLabel(false),
       m_currentUpdate(0),
+      m_revision(0),
+      m_phoneNumbersRevision(0),
+      m_phoneNumbersLoaded(false),
       m_visible(true)
+{
+    initSupportedExtendedDetails();
+    setIndividual(individual);
+}
+
+QIndividual::QIndividual(const QContact &contact, const QDateTime &deletedAt, FolksIndividualAggregator *aggregator)
+    : m_individual(0),
+      m_aggregator(aggregator),
+      m_contact(contact),
+      m_loadedGroups(GroupAll),
+      m_fallbackLabel(false),
+      m_currentUpdate(0),
+      m_revision(0),
+      m_phoneNumbersRevision(0),
+      m_phoneNumbersLoaded(false),
+      m_visible(true)
+{
+    initSupportedExtendedDetails();
+    m_id = contact.detail<QContactGuid>().guid();
+    m_contact.setId(QContactId("qtcontacts:galera:", m_id.toUtf8()));
+    // invalid but not null date means not deleted, see deletedAt()
+    m_deletedAt = deletedAt.isValid() ? deletedAt : QDateTime(QDate(), QTime(0, 0, 0));
+}
+
+void QIndividual::initSupportedExtendedDetails()
 {
     if (m_supportedExtendedDetails.isEmpty()) {
         m_supportedExtendedDetails << X_CREATED_AT
@@ -166,7 +199,6 @@ QIndividual::QIndividual(FolksIndividual *individual, FolksIndividualAggregator
                                    << X_GROUP_ID
                                    << X_AVATAR_REV;
     }
-    setIndividual(individual);
 }
 
 void QIndividual::notifyUpdate()
@@ -392,12 +424,17 @@ void QIndividual::folksIndividualChanged(FolksIndividual *individual,
                                          QIndividual *self)
 {
     Q_UNUSED(individual);
-    Q_UNUSED(pspec);
+
+    // properties like presence are not part of the contact
+    int groups = propertyGroups(QByteArray(g_param_spec_get_name(pspec)));
+    if (groups == 0) {
+        return;
+    }
 
     // skip update contact during a contact update, the update will be done after
     if (self->m_contactLock.tryLock()) {
-        // invalidate contact
-        self->markAsDirty();
+        // invalidate only the details built from the changed property
+        self->markAsDirty(groups);
         self->notifyUpdate();
         self->m_contactLock.unlock();
     }
@@ -781,7 +818,16 @@ QList<QContactDetail> QIndividual::getPersonaExtendedDetails(FolksPersona *perso
 
 QtContacts::QContact QIndividual::copy(QList<QContactDetail::DetailType> fields)
 {
-    return copy(contact(), fields);
+    if (fields.isEmpty()) {
+        return copy(contact(), fields);
+    }
+
+    // mandatory details
+    QList<QContactDetail::DetailType> types(fields);
+    types << QContactDetail::TypeGuid
+          << QContactDetail::TypeExtendedDetail
+          << QContactDetail::TypeSyncTarget;
+    return copy(contact(types), fields);
 }
 
 QtContacts::QContact QIndividual::copy(const QContact &c, QList<QContactDetail::DetailType> fields)
@@ -877,18 +923,55 @@ QtContacts::QContact QIndividual::copy(const QContact &c, QList<QContactDetail::
     return result;
 }
 
-QtContacts::QContact &QIndividual::contact()
+QtContacts::QContact QIndividual::contact()
 {
-    if (!m_contact && m_individual) {
-        QMutexLocker locker(&m_contactLock);
-        updatePersonas();
-        // avoid change on m_contact pointer until the contact is fully loaded
+    return loadContact(GroupAll);
+}
+
+QtContacts::QContact QIndividual::contact(const QList<QContactDetail::DetailType> &types)
+{
+    if (types.isEmpty()) {
+        return loadContact(GroupAll);
+    }
+
+    int groups = 0;
+    Q_FOREACH(QContactDetail::DetailType type, types) {
+        groups |= detailTypeGroups(type);
+    }
+    // types not built by any group still get a contact with its id
+    return loadContact(groups ? groups : GroupUid);
+}
+
+QtContacts::QContact QIndividual::loadContact(int groups)
+{
+    QMutexLocker locker(&m_dataLock);
+    int missing = groups & ~m_loadedGroups;
+    if (m_individual && missing) {
+        // the readers keep their own copy, the new details go on a new contact
         QContact contact;
-        contact.setId(QContactId("qtcontacts:galera:", m_id.toUtf8()));
-        updateContact(&contact);
-        m_contact = new QContact(contact);
+        if (m_loadedGroups) {
+            contact = m_contact;
+        } else {
+            updatePersonas();
+            contact.setId(QContactId("qtcontacts:galera:", m_id.toUtf8()));
+        }
+        updateContact(&contact, missing);
+
+        if (missing & GroupName) {
+            // Display label is mandatory, the fallback uses other details
+            m_fallbackLabel = contact.detail<QContactDisplayLabel>().label().isEmpty();
+            if (m_fallbackLabel) {
+                int fallback = GroupLabelFallback & ~(m_loadedGroups | missing);
+                updateContact(&contact, fallback);
+                missing |= fallback;
+            }
+            updateLabel(&contact);
+        }
+
+        m_contact = contact;
+        m_loadedGroups |= missing;
     }
-    return *m_contact;
+    return m_contact;
 }
 
 void QIndividual::updatePersonas()
@@ -912,15 +995,17 @@ void QIndividual::updatePersonas()
     g_object_unref(iter);
 }
 
-void QIndividual::updateContact(QContact *contact) const
+void QIndividual::updateContact(QContact *contact, int groups) const
 {
-    if (!m_individual) {
+    if (!m_individual || (groups == 0)) {
         return;
     }
 
-    contact->appendDetail(getUid());
-    Q_FOREACH(QContactDetail detail, getSyncTargets()) {
-        contact->appendDetail(detail);
+    if (groups & GroupUid) {
+        contact->appendDetail(getUid());
+        Q_FOREACH(QContactDetail detail, getSyncTargets()) {
+            contact->appendDetail(detail);
+        }
     }
 
     int personaIndex = 1;
@@ -939,83 +1024,110 @@ void QIndividual::updateContact(QContact *contact) const
 
         // vcard only support one of these details by contact
         if (personaIndex == 1) {
+            if (groups & GroupTimestamp) {
+                appendDetailsForPersona(contact,
+                                        getTimeStamp(persona, personaIndex),
+                                        true);
+            }
+            if (groups & GroupName) {
+                appendDetailsForPersona(contact,
+                                        getPersonaName(persona, personaIndex),
+                                        !wPropList.contains("structured-name"));
+                appendDetailsForPersona(contact,
+                                        getPersonaFullName(persona, personaIndex),
+                                        !wPropList.contains("full-name"));
+                appendDetailsForPersona(contact,
+                                        getPersonaNickName(persona, personaIndex),
+                                        !wPropList.contains("structured-name"));
+            }
+            if (groups & GroupBirthday) {
+                appendDetailsForPersona(contact,
+                                        getPersonaBirthday(persona, personaIndex),
+                                        !wPropList.contains("birthday"));
+            }
+            if (groups & GroupAvatar) {
+                appendDetailsForPersona(contact,
+                                        getPersonaPhoto(persona, personaIndex),
+                                        !wPropList.contains("avatar"));
+            }
+            if (groups & GroupFavorite) {
+                appendDetailsForPersona(contact,
+                                        getPersonaFavorite(persona, personaIndex),
+                                        !wPropList.contains("is-favourite"));
+            }
+        }
+
+        QList<QContactDetail> details;
+        QContactDetail prefDetail;
+        if (groups & GroupRoles) {
+            details = getPersonaRoles(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getTimeStamp(persona, personaIndex),
-                                    true);
-            appendDetailsForPersona(contact,
-                                    getPersonaName(persona, personaIndex),
-                                    !wPropList.contains("structured-name"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactOrganization::Type],
+                                    prefDetail,
+                                    !wPropList.contains("roles"));
+        }
+
+        if (groups & GroupEmails) {
+            details = getPersonaEmails(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getPersonaFullName(persona, personaIndex),
-                                    !wPropList.contains("full-name"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactEmailAddress::Type],
+                                    prefDetail,
+                                    !wPropList.contains("email-addresses"));
+        }
+
+        if (groups & GroupPhones) {
+            details = getPersonaPhones(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getPersonaNickName(persona, personaIndex),
-                                    !wPropList.contains("structured-name"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactPhoneNumber::Type],
+                                    prefDetail,
+                                    !wPropList.contains("phone-numbers"));
+        }
+
+        if (groups & GroupAddresses) {
+            details = getPersonaAddresses(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getPersonaBirthday(persona, personaIndex),
-                                    !wPropList.contains("birthday"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactAddress::Type],
+                                    prefDetail,
+                                    !wPropList.contains("postal-addresses"));
+        }
+
+        if (groups & GroupIms) {
+            details = getPersonaIms(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getPersonaPhoto(persona, personaIndex),
-                                    !wPropList.contains("avatar"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactOnlineAccount::Type],
+                                    prefDetail,
+                                    !wPropList.contains("im-addresses"));
+        }
+
+        if (groups & GroupUrls) {
+            details = getPersonaUrls(persona, &prefDetail, personaIndex);
             appendDetailsForPersona(contact,
-                                    getPersonaFavorite(persona, personaIndex),
-                                    !wPropList.contains("is-favourite"));
+                                    details,
+                                    VCardParser::PreferredActionNames[QContactUrl::Type],
+                                    prefDetail,
+                                    !wPropList.contains("urls"));
         }
 
-        QList<QContactDetail> details;
-        QContactDetail prefDetail;
-        details = getPersonaRoles(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactOrganization::Type],
-                                prefDetail,
-                                !wPropList.contains("roles"));
-
-        details = getPersonaEmails(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactEmailAddress::Type],
-                                prefDetail,
-                                !wPropList.contains("email-addresses"));
-
-        details = getPersonaPhones(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactPhoneNumber::Type],
-                                prefDetail,
-                                !wPropList.contains("phone-numbers"));
-
-        details = getPersonaAddresses(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactAddress::Type],
-                                prefDetail,
-                                !wPropList.contains("postal-addresses"));
-
-        details = getPersonaIms(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactOnlineAccount::Type],
-                                prefDetail,
-                                !wPropList.contains("im-addresses"));
-
-        details = getPersonaUrls(persona, &prefDetail, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                VCardParser::PreferredActionNames[QContactUrl::Type],
-                                prefDetail,
-                                !wPropList.contains("urls"));
-
-        details = getPersonaExtendedDetails (persona, personaIndex);
-        appendDetailsForPersona(contact,
-                                details,
-                                QString(),
-                                QContactDetail(),
-                                false);
+        if (groups & GroupExtended) {
+            details = getPersonaExtendedDetails (persona, personaIndex);
+            appendDetailsForPersona(contact,
+                                    details,
+                                    QString(),
+                                    QContactDetail(),
+                                    false);
+        }
 
         personaIndex++;
     }
+}
 
+void QIndividual::updateLabel(QContact *contact) const
+{
     // Display label is mandatory
     QContactDisplayLabel dLabel = contact->detail<QContactDisplayLabel>();
     if (dLabel.label().isEmpty()) {
@@ -1046,7 +1158,7 @@ void QIndividual::updateContact(QContact *contact) const
 
 bool QIndividual::update(const QtContacts::QContact &newContact, QObject *object, const char *slot)
 {
-    QContact &originalContact = contact();
+    QContact originalContact = contact();
     if (newContact != originalContact) {
         m_currentUpdate = new UpdateContactRequest(newContact, this, object, slot);
         if (!m_contactLock.tryLock(5000)) {
@@ -1089,6 +1201,7 @@ FolksIndividual *QIndividual::individual() const
 
 QList<FolksPersona *> QIndividual::personas() const
 {
+    QMutexLocker locker(&m_dataLock);
     return m_personas.values();
 }
 
@@ -1102,6 +1215,7 @@ void QIndividual::clearPersonas()
 
 void QIndividual::clear()
 {
+    QMutexLocker locker(&m_dataLock);
     clearPersonas();
     if (m_individual) {
         // disconnect any previous handler
@@ -1113,10 +1227,10 @@ void QIndividual::clear()
         m_individual = 0;
     }
 
-    if (m_contact) {
-        delete m_contact;
-        m_contact = 0;
-    }
+    m_contact = QContact();
+    m_loadedGroups = 0;
+    m_vcardCache.clear();
+    m_revision++;
 }
 
 void QIndividual::addListener(QObject *object, const char *slot)
@@ -1143,62 +1257,75 @@ void QIndividual::flush()
     markAsDirty();
 }
 
-bool QIndividual::markAsDeleted()
+QList<QPair<ESource*, EContact*> > QIndividual::edsContactsMarkedAsDeleted(const QDateTime &deletedAt) const
 {
-    QString currentDate = QDateTime::currentDateTime().toString(Qt::ISODate);
-    GeeSet *personas = folks_individual_get_personas(m_individual);
+    QList<QPair<ESource*, EContact*> > contacts;
+    GeeSet *personas = m_individual ? folks_individual_get_personas(m_individual) : 0;
     if (!personas) {
-        return false;
+        return contacts;
     }
 
+    QByteArray currentDate = deletedAt.toString(Qt::ISODate).toUtf8();
     GeeIterator *iter = gee_iterable_iterator(GEE_ITERABLE(personas));
     while(gee_iterator_next(iter)) {
         FolksPersona *persona = FOLKS_PERSONA(gee_iterator_get(iter));
-        if (EDSF_IS_PERSONA(persona)) {
-            FolksPersonaStore *store = folks_persona_get_store(persona);
-            if (!EDSF_IS_PERSONA_STORE(store)) {
-                continue;
-            }
-
-            GError *error = NULL;
-            ESource *source = edsf_persona_store_get_source(EDSF_PERSONA_STORE(store));
-            EClient *client = E_BOOK_CLIENT_CONNECT_SYNC(source, NULL, &error);
-            if (error) {
-                qWarning() << "Fail to connect with EDS" << error->message;
-                g_error_free(error);
-                continue;
-            }
-
-            EContact *c = edsf_persona_get_contact(EDSF_PERSONA(persona));
+        FolksPersonaStore *store = folks_persona_get_store(persona);
+        if (EDSF_IS_PERSONA(persona) && EDSF_IS_PERSONA_STORE(store)) {
+            EContact *c = e_contact_duplicate(edsf_persona_get_contact(EDSF_PERSONA(persona)));
             EVCardAttribute *attr = e_vcard_get_attribute(E_VCARD(c), X_DELETED_AT);
             if (!attr) {
                 attr = e_vcard_attribute_new("", X_DELETED_AT);
-                e_vcard_add_attribute_with_value(E_VCARD(c), attr,
-                                                 currentDate.toUtf8().constData());
+                e_vcard_add_attribute_with_value(E_VCARD(c), attr, currentDate.constData());
             } else {
-                e_vcard_attribute_add_value(attr, currentDate.toUtf8().constData());
+                e_vcard_attribute_add_value(attr, currentDate.constData());
             }
+            contacts << qMakePair(edsf_persona_store_get_source(EDSF_PERSONA_STORE(store)), c);
+        }
+        g_object_unref(persona);
+    }
+    g_object_unref(iter);
 
-            e_book_client_modify_contact_sync(E_BOOK_CLIENT(client), c, NULL, &error);
-            if (error) {
-                qWarning() << "Fail to update EDS contact:" << error->message;
-                g_error_free(error);
-            } else {
-                m_deletedAt = QDateTime::currentDateTime();
-                notifyUpdate();
-            }
+    return contacts;
+}
 
-            g_object_unref(client);
+QList<QPair<ESource*, QString> > QIndividual::edsContactUids() const
+{
+    QList<QPair<ESource*, QString> > uids;
+    GeeSet *personas = m_individual ? folks_individual_get_personas(m_individual) : 0;
+    if (!personas) {
+        return uids;
+    }
+
+    GeeIterator *iter = gee_iterable_iterator(GEE_ITERABLE(personas));
+    while(gee_iterator_next(iter)) {
+        FolksPersona *persona = FOLKS_PERSONA(gee_iterator_get(iter));
+        FolksPersonaStore *store = folks_persona_get_store(persona);
+        if (EDSF_IS_PERSONA(persona) && EDSF_IS_PERSONA_STORE(store)) {
+            EContact *c = edsf_persona_get_contact(EDSF_PERSONA(persona));
+            const gchar *uid = static_cast<const gchar*>(e_contact_get_const(c, E_CONTACT_UID));
+            if (uid) {
+                uids << qMakePair(edsf_persona_store_get_source(EDSF_PERSONA_STORE(store)),
+                                  QString::fromUtf8(uid));
+            }
         }
-        m_personas.insert(qStringFromGChar(folks_persona_get_iid(persona)), persona);
+        g_object_unref(persona);
     }
     g_object_unref(iter);
 
-    return m_deletedAt.isValid();
+    return uids;
+}
+
+void QIndividual::setDeletedAt(const QDateTime &deletedAt)
+{
+    m_dataLock.lock();
+    m_deletedAt = deletedAt;
+    m_dataLock.unlock();
+    notifyUpdate();
 }
 
 QDateTime QIndividual::deletedAt()
 {
+    QMutexLocker locker(&m_dataLock);
     if (!m_deletedAt.isNull()) {
         return m_deletedAt;
     }
@@ -1249,6 +1376,12 @@ void QIndividual::setIndividual(FolksIndividual *individual)
     static QList<QByteArray> individualProperties;
 
     if (m_individual != individual) {
+        // the snapshot values are replaced by the folks ones
+        m_dataLock.lock();
+        if (!m_individual && m_loadedGroups) {
+            m_deletedAt = QDateTime();
+        }
+        m_dataLock.unlock();
         clear();
 
         if (individual) {
@@ -1756,63 +1889,272 @@ void QIndividual::setExtendedDetails(FolksPersona *persona,
 {
     FolksPersonaStore *store = folks_persona_get_store(persona);
     if (EDSF_IS_PERSONA_STORE(store)) {
-        GError *error = NULL;
         ESource *source = edsf_persona_store_get_source(EDSF_PERSONA_STORE(store));
-        EClient *client = E_BOOK_CLIENT_CONNECT_SYNC(source, NULL, &error);
-        if (error) {
-            qWarning() << "Fail to connect with EDS" << error->message;
-            g_error_free(error);
-        } else {
+        EBookClient *client = EdsClientCache::client(source);
+        if (client) {
+            GError *error = NULL;
             EContact *c = edsf_persona_get_contact(EDSF_PERSONA(persona));
-
-            // create X-CREATED-AT if it does not exists
-            EVCardAttribute *attr = e_vcard_get_attribute(E_VCARD(c), X_CREATED_AT);
-            if (!attr) {
-                QDateTime createdAt = createdAtDate.isValid() ? createdAtDate : QDateTime::currentDateTime();
-                attr = e_vcard_attribute_new("", X_CREATED_AT);
-                e_vcard_add_attribute_with_value(E_VCARD(c),
-                                                 attr,
-                                                 createdAt.toUTC().toString(Qt::ISODate).toUtf8().constData());
+            applyExtendedDetails(c, xDetails, createdAtDate);
+            e_book_client_modify_contact_sync(client, c, NULL, &error);
+            if (error) {
+                qWarning() << "Fail to update EDS contact:" << error->message;
+                g_error_free(error);
             }
+            g_object_unref(client);
+        }
+    }
+}
 
-            Q_FOREACH(const QContactDetail &d, xDetails) {
-                QContactExtendedDetail xd = static_cast<QContactExtendedDetail>(d);
-                // X_CREATED_AT should not be updated
-                if (xd.name() == X_CREATED_AT) {
-                    continue;
-                }
+void QIndividual::applyExtendedDetails(EContact *c,
+                                       const QList<QContactDetail> &xDetails,
+                                       const QDateTime &createdAtDate)
+{
+    // create X-CREATED-AT if it does not exists
+    EVCardAttribute *attr = e_vcard_get_attribute(E_VCARD(c), X_CREATED_AT);
+    if (!attr) {
+        QDateTime createdAt = createdAtDate.isValid() ? createdAtDate : QDateTime::currentDateTime();
+        attr = e_vcard_attribute_new("", X_CREATED_AT);
+        e_vcard_add_attribute_with_value(E_VCARD(c),
+                                         attr,
+                                         createdAt.toUTC().toString(Qt::ISODate).toUtf8().constData());
+    }
 
-                if (m_supportedExtendedDetails.contains(xd.name())) {
-                    // Remove old attribute
-                    attr = e_vcard_get_attribute(E_VCARD(c), xd.name().toUtf8().constData());
-                    if (attr) {
-                        e_vcard_remove_attribute(E_VCARD(c), attr);
-                    }
-
-                    attr = e_vcard_attribute_new("", xd.name().toUtf8().constData());
-                    e_vcard_add_attribute_with_value(E_VCARD(c),
-                                                     attr,
-                                                     xd.data().toString().toUtf8().constData());
-                } else {
-                    qWarning() << "Extended detail not supported" << xd.name();
-                }
-            }
+    Q_FOREACH(const QContactDetail &d, xDetails) {
+        QContactExtendedDetail xd = static_cast<QContactExtendedDetail>(d);
+        // X_CREATED_AT should not be updated
+        if (xd.name() == X_CREATED_AT) {
+            continue;
+        }
 
-            e_book_client_modify_contact_sync(E_BOOK_CLIENT(client), c, NULL, &error);
-            if (error) {
-                qWarning() << "Fail to update EDS contact:" << error->message;
-                g_error_free(error);
+        if (m_supportedExtendedDetails.contains(xd.name())) {
+            // Remove old attribute
+            attr = e_vcard_get_attribute(E_VCARD(c), xd.name().toUtf8().constData());
+            if (attr) {
+                e_vcard_remove_attribute(E_VCARD(c), attr);
             }
+
+            attr = e_vcard_attribute_new("", xd.name().toUtf8().constData());
+            e_vcard_add_attribute_with_value(E_VCARD(c),
+                                             attr,
+                                             xd.data().toString().toUtf8().constData());
+        } else {
+            qWarning() << "Extended detail not supported" << xd.name();
         }
-        g_object_unref(client);
     }
 }
 
 void QIndividual::markAsDirty()
 {
-    delete m_contact;
-    m_contact = 0;
+    QMutexLocker locker(&m_dataLock);
+    m_contact = QContact();
+    m_loadedGroups = 0;
     m_deletedAt = QDateTime();
+    m_vcardCache.clear();
+    m_revision++;
+}
+
+void QIndividual::markAsDirty(int groups)
+{
+    // the fallback label depends on other details
+    if (m_fallbackLabel && (groups & GroupLabelFallback)) {
+        groups |= GroupName;
+    }
+
+    QMutexLocker locker(&m_dataLock);
+    if (!m_loadedGroups || ((groups & GroupAll) == GroupAll)) {
+        locker.unlock();
+        markAsDirty();
+        return;
+    }
+
+    // keep the details of the groups not affected by the change, the readers
+    // keep their own copy of the old contact
+    QContact contact(m_contact);
+    contact.clearDetails();
+    Q_FOREACH(const QContactDetail &detail, m_contact.details()) {
+        if ((detail.type() != QContactDetail::TypeType) &&
+            !(detailGroup(detail) & groups)) {
+            contact.appendDetail(detail);
+        }
+    }
+
+    m_contact = contact;
+    m_loadedGroups &= ~groups;
+    m_deletedAt = QDateTime();
+    m_vcardCache.clear();
+    m_revision++;
+}
+
+int QIndividual::detailGroup(const QContactDetail &detail)
+{
+    if (detail.type() == QContactDetail::TypeExtendedDetail) {
+        // normalized label is built together with the display label
+        QContactExtendedDetail xDetail = static_cast<QContactExtendedDetail>(detail);
+        return (xDetail.name() == "X-NORMALIZED_FN") ? GroupName : GroupExtended;
+    }
+    return detailTypeGroups(detail.type());
+}
+
+int QIndividual::detailTypeGroups(QContactDetail::DetailType type)
+{
+    switch(type) {
+    case QContactDetail::TypeGuid:
+    case QContactDetail::TypeSyncTarget:
+        return GroupUid;
+    case QContactDetail::TypeTimestamp:
+        return GroupTimestamp;
+    case QContactDetail::TypeName:
+    case QContactDetail::TypeDisplayLabel:
+    case QContactDetail::TypeNickname:
+    case QContactDetail::TypeTag:
+        return GroupName;
+    case QContactDetail::TypeBirthday:
+        return GroupBirthday;
+    case QContactDetail::TypeAvatar:
+        return GroupAvatar;
+    case QContactDetail::TypeFavorite:
+        return GroupFavorite;
+    case QContactDetail::TypeOrganization:
+        return GroupRoles;
+    case QContactDetail::TypeEmailAddress:
+        return GroupEmails;
+    case QContactDetail::TypePhoneNumber:
+        return GroupPhones;
+    case QContactDetail::TypeAddress:
+        return GroupAddresses;
+    case QContactDetail::TypeOnlineAccount:
+        return GroupIms;
+    case QContactDetail::TypeUrl:
+        return GroupUrls;
+    case QContactDetail::TypeExtendedDetail:
+        return GroupName | GroupExtended;
+    default:
+        return 0;
+    }
+}
+
+int QIndividual::propertyGroups(const QByteArray &property)
+{
+    static QMap<QByteArray, int> groups;
+    static QList<QByteArray> ignoredProperties;
+
+    if (groups.isEmpty()) {
+        groups.insert("alias", GroupName);
+        groups.insert("full-name", GroupName);
+        groups.insert("nickname", GroupName);
+        groups.insert("structured-name", GroupName);
+        groups.insert("birthday", GroupBirthday);
+        groups.insert("avatar", GroupAvatar);
+        groups.insert("is-favourite", GroupFavorite);
+        groups.insert("roles", GroupRoles);
+        groups.insert("email-addresses", GroupEmails);
+        groups.insert("phone-numbers", GroupPhones);
+        groups.insert("postal-addresses", GroupAddresses);
+        groups.insert("im-addresses", GroupIms);
+        groups.insert("web-service-addresses", GroupIms);
+        groups.insert("urls", GroupUrls);
+
+        ignoredProperties << "calendar-event-id"
+                          << "call-interaction-count"
+                          << "client-types"
+                          << "gender"
+                          << "groups"
+                          << "im-interaction-count"
+                          << "is-user"
+                          << "last-call-interaction-datetime"
+                          << "last-im-interaction-datetime"
+                          << "location"
+                          << "notes"
+                          << "presence-message"
+                          << "presence-status"
+                          << "presence-type"
+                          << "trust-level";
+    }
+
+    if (ignoredProperties.contains(property)) {
+        return 0;
+    }
+
+    // unknown properties like "personas" reload the whole contact
+    int result = groups.value(property, GroupAll);
+
+    // the revision and the extended details are stored with any change
+    return result | GroupTimestamp | GroupExtended;
+}
+
+uint QIndividual::revision() const
+{
+    return m_revision;
+}
+
+QList<ParsedPhoneNumber> QIndividual::phoneNumbers()
+{
+    QMutexLocker locker(&m_phoneNumbersLock);
+    if (!m_phoneNumbersLoaded || (m_phoneNumbersRevision != m_revision)) {
+        uint revision = m_revision;
+        QList<QContactDetail::DetailType> phoneTypes;
+        phoneTypes << QContactDetail::TypePhoneNumber;
+
+        m_phoneNumbers.clear();
+        Q_FOREACH(const QContactPhoneNumber &phone, contact(phoneTypes).details<QContactPhoneNumber>()) {
+            m_phoneNumbers << ParsedPhoneNumber(phone.number());
+        }
+        m_phoneNumbersRevision = revision;
+        m_phoneNumbersLoaded = true;
+    }
+    return m_phoneNumbers;
+}
+
+QString QIndividual::cachedVCard(const QList<QContactDetail::DetailType> &fields) const
+{
+    QString key = vcardCacheKey(fields);
+    for(int i = 0; i < m_vcardCache.size(); i++) {
+        if (m_vcardCache.at(i).first == key) {
+            return m_vcardCache.at(i).second;
+        }
+    }
+    return QString();
+}
+
+void QIndividual::cacheVCard(const QList<QContactDetail::DetailType> &fields,
+                             const QString &vcard,
+                             uint revision)
+{
+    // the contact changed since the vcard was exported
+    if ((revision != m_revision) || vcard.isEmpty()) {
+        return;
+    }
+
+    QString key = vcardCacheKey(fields);
+    for(int i = 0; i < m_vcardCache.size(); i++) {
+        if (m_vcardCache.at(i).first == key) {
+            m_vcardCache.removeAt(i);
+            break;
+        }
+    }
+
+    if (m_vcardCache.size() >= VCARD_CACHE_SIZE) {
+        m_vcardCache.removeLast();
+    }
+    m_vcardCache.prepend(qMakePair(key, vcard));
+}
+
+QString QIndividual::vcardCacheKey(const QList<QContactDetail::DetailType> &fields)
+{
+    // empty list means all fields
+    QList<int> sortedFields;
+    Q_FOREACH(QContactDetail::DetailType field, fields) {
+        if (!sortedFields.contains(field)) {
+            sortedFields << field;
+        }
+    }
+    qSort(sortedFields);
+
+    QStringList key;
+    Q_FOREACH(int field, sortedFields) {
+        key << QString::number(field);
+    }
+    return key.join(",");
 }
 
 void QIndividual::enableAutoLink(bool flag)
@@ -1836,7 +2178,8 @@ FolksPersona* QIndividual::primaryPersona()
 
 QtContacts::QContactDetail QIndividual::detailFromUri(QtContacts::QContactDetail::DetailType type, const QString &uri) const
 {
-    Q_FOREACH(QContactDetail detail, m_contact->details(type)) {
+    QMutexLocker locker(&m_dataLock);
+    Q_FOREACH(QContactDetail detail, m_contact.details(type)) {
         if (detail.detailUri() == uri) {
             return detail;
         }
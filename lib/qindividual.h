@@ -23,6 +23,7 @@
 #include <QtCore/QList>
 #include <QtCore/QMultiHash>
 #include <QtCore/QMutex>
+#include <QtCore/QPair>
 #include <QtCore/QDateTime>
 
 #include <QVersitProperty>
@@ -30,8 +31,13 @@
 #include <QtContacts/QContact>
 #include <QtContacts/QContactDetail>
 
+#include "common/parsed-phone-number.h"
+
 #include <folks/folks.h>
 
+typedef struct _EContact EContact;
+typedef struct _ESource ESource;
+
 namespace galera
 {
 typedef GHashTable* (*ParseDetailsFunc)(GHashTable*, const QList<QtContacts::QContactDetail> &);
@@ -42,10 +48,15 @@ class QIndividual
 {
 public:
     QIndividual(FolksIndividual *individual, FolksIndividualAggregator *aggregator);
+    // contact loaded from the snapshot, it is replaced by the folks data on setIndividual
+    QIndividual(const QtContacts::QContact &contact, const QDateTime &deletedAt, FolksIndividualAggregator *aggregator);
     ~QIndividual();
 
     QString id() const;
-    QtContacts::QContact &contact();
+    // the contact is returned by value, the copy shares the data with the loaded
+    // contact and stays valid if the individual changes on other thread
+    QtContacts::QContact contact();
+    QtContacts::QContact contact(const QList<QtContacts::QContactDetail::DetailType> &types);
     QtContacts::QContact copy(QList<QtContacts::QContactDetail::DetailType> fields);
     bool update(const QString &vcard, QObject *object, const char *slot);
     bool update(const QtContacts::QContact &contact, QObject *object, const char *slot);
@@ -55,26 +66,68 @@ public:
     void addListener(QObject *object, const char *slot);
     bool isValid() const;
     void flush();
-    bool markAsDeleted();
+    // copies of the EDS contacts with X-DELETED-AT set and their sources, the
+    // caller saves and unrefs them, see AddressBook::removeContacts
+    QList<QPair<ESource*, EContact*> > edsContactsMarkedAsDeleted(const QDateTime &deletedAt) const;
+    // uids of the EDS contacts and their sources, see AddressBook::purgeContacts
+    QList<QPair<ESource*, QString> > edsContactUids() const;
+    void setDeletedAt(const QDateTime &deletedAt);
     QDateTime deletedAt();
     bool setVisible(bool visible);
     bool isVisible() const;
 
+    // phone numbers parsed once for the filters, parsed again if the contact changes
+    QList<ParsedPhoneNumber> phoneNumbers();
+
+    // exported vcard cache, it is dropped every time the contact changes
+    uint revision() const;
+    QString cachedVCard(const QList<QtContacts::QContactDetail::DetailType> &fields) const;
+    void cacheVCard(const QList<QtContacts::QContactDetail::DetailType> &fields,
+                    const QString &vcard,
+                    uint revision);
+
     static QtContacts::QContact copy(const QtContacts::QContact &c, QList<QtContacts::QContactDetail::DetailType> fields);
     static GHashTable *parseDetails(const QtContacts::QContact &contact);
     static QString displayName(const QtContacts::QContact &contact);
     static void setExtendedDetails(FolksPersona *persona,
                                    const QList<QtContacts::QContactDetail> &xDetails,
                                    const QDateTime &createdAt = QDateTime());
+    // write the extended details into the EDS contact, without saving it
+    static void applyExtendedDetails(EContact *contact,
+                                     const QList<QtContacts::QContactDetail> &xDetails,
+                                     const QDateTime &createdAt = QDateTime());
 
     // enable or disable auto-link
     static void enableAutoLink(bool flag);
     static bool autoLinkEnabled();
 
 private:
+    // details are loaded on demand by group, each group is filled by a
+    // single folks property
+    enum DetailGroup {
+        GroupUid            = 0x0001,
+        GroupTimestamp      = 0x0002,
+        GroupName           = 0x0004,
+        GroupBirthday       = 0x0008,
+        GroupAvatar         = 0x0010,
+        GroupFavorite       = 0x0020,
+        GroupRoles          = 0x0040,
+        GroupEmails         = 0x0080,
+        GroupPhones         = 0x0100,
+        GroupAddresses      = 0x0200,
+        GroupIms            = 0x0400,
+        GroupUrls           = 0x0800,
+        GroupExtended       = 0x1000,
+        GroupAll            = 0x1fff,
+        // details used to build the display label when the full name is empty
+        GroupLabelFallback  = GroupRoles | GroupEmails | GroupPhones | GroupIms
+    };
+
     FolksIndividual *m_individual;
     FolksIndividualAggregator *m_aggregator;
-    QtContacts::QContact *m_contact;
+    QtContacts::QContact m_contact;
+    int m_loadedGroups;
+    bool m_fallbackLabel;
     UpdateContactRequest *m_currentUpdate;
     QList<QPair<QObject*, QMetaMethod> > m_listeners;
     QMap<QString, FolksPersona*> m_personas;
@@ -82,7 +135,15 @@ private:
     QString m_id;
     QMetaObject::Connection m_updateConnection;
     QMutex m_contactLock;
+    // protects the loaded contact and the folks data read by the filter threads
+    mutable QMutex m_dataLock;
     QDateTime m_deletedAt;
+    QList<QPair<QString, QString> > m_vcardCache;
+    uint m_revision;
+    QMutex m_phoneNumbersLock;
+    QList<ParsedPhoneNumber> m_phoneNumbers;
+    uint m_phoneNumbersRevision;
+    bool m_phoneNumbersLoaded;
     bool m_visible;
     static bool m_autoLink;
     static QStringList m_supportedExtendedDetails;
@@ -91,10 +152,15 @@ private:
     QIndividual(const QIndividual &);
 
     void notifyUpdate();
+    static void initSupportedExtendedDetails();
 
     QMultiHash<QString, QString> parseDetails(FolksAbstractFieldDetails *details) const;
+    static QString vcardCacheKey(const QList<QtContacts::QContactDetail::DetailType> &fields);
     void markAsDirty();
-    void updateContact(QtContacts::QContact *contact) const;
+    void markAsDirty(int groups);
+    QtContacts::QContact loadContact(int groups);
+    void updateContact(QtContacts::QContact *contact, int groups) const;
+    void updateLabel(QtContacts::QContact *contact) const;
     void updatePersonas();
     void clearPersonas();
     void clear();
@@ -185,6 +251,10 @@ private:
                                                  QIndividual *self);
 
     static QString qStringFromGChar             (const gchar *str);
+
+    static int detailGroup(const QtContacts::QContactDetail &detail);
+    static int detailTypeGroups(QtContacts::QContactDetail::DetailType type);
+    static int propertyGroups(const QByteArray &property);
 };
 
 } //namespace
@@ -0,0 +1,330 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sorted-entry-list.h"
+
+#include "common/sort-clause.h"
+
+namespace galera
+{
+
+SortedEntryList::SortedEntryList()
+    : m_root(0),
+      m_nextSeq(0),
+      m_seed(2463534242u)
+{
+}
+
+SortedEntryList::~SortedEntryList()
+{
+    clear();
+}
+
+int SortedEntryList::insert(ContactEntry *entry, const QByteArray &sortKey)
+{
+    if (m_nodes.contains(entry)) {
+        return update(entry, sortKey);
+    }
+
+    Node *node = createNode(entry, sortKey);
+    m_nodes.insert(entry, node);
+
+    Node *left = 0;
+    Node *right = 0;
+    split(m_root, node, &left, &right);
+    int pos = size(left);
+    m_root = merge(merge(left, node), right);
+    return pos;
+}
+
+int SortedEntryList::remove(ContactEntry *entry)
+{
+    Node *node = m_nodes.take(entry);
+    if (!node) {
+        return -1;
+    }
+
+    int pos = rank(node);
+    erase(&m_root, node);
+    delete node;
+    return pos;
+}
+
+int SortedEntryList::update(ContactEntry *entry, const QByteArray &sortKey)
+{
+    Node *node = m_nodes.value(entry, 0);
+    if (!node) {
+        return insert(entry, sortKey);
+    }
+
+    if (node->key == sortKey) {
+        return rank(node);
+    }
+
+    // re-insert the node as the last one with the new key
+    erase(&m_root, node);
+    node->key = sortKey;
+    node->seq = m_nextSeq++;
+    node->size = 1;
+    node->left = 0;
+    node->right = 0;
+
+    Node *left = 0;
+    Node *right = 0;
+    split(m_root, node, &left, &right);
+    int pos = size(left);
+    m_root = merge(merge(left, node), right);
+    return pos;
+}
+
+void SortedEntryList::assign(const QList<ContactEntry*> &entries, const QList<QByteArray> &sortKeys)
+{
+    clear();
+
+    // build the tree in O(n), the nodes are already sorted so only
+    // the heap order of the priorities need to be fixed
+    QList<Node*> rightSpine;
+    for(int i = 0; i < entries.size(); i++) {
+        Node *node = createNode(entries.at(i), sortKeys.value(i));
+        m_nodes.insert(node->entry, node);
+
+        Node *last = 0;
+        while (!rightSpine.isEmpty() && (rightSpine.last()->priority < node->priority)) {
+            last = rightSpine.takeLast();
+            updateSize(last);
+        }
+        node->left = last;
+        if (!rightSpine.isEmpty()) {
+            rightSpine.last()->right = node;
+        }
+        rightSpine << node;
+    }
+
+    // the first node of the right spine is the root
+    m_root = rightSpine.isEmpty() ? 0 : rightSpine.first();
+    while (!rightSpine.isEmpty()) {
+        updateSize(rightSpine.takeLast());
+    }
+}
+
+void SortedEntryList::clear()
+{
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_root = 0;
+    m_nextSeq = 0;
+}
+
+bool SortedEntryList::contains(ContactEntry *entry) const
+{
+    return m_nodes.contains(entry);
+}
+
+int SortedEntryList::indexOf(ContactEntry *entry) const
+{
+    const Node *node = m_nodes.value(entry, 0);
+    return node ? rank(node) : -1;
+}
+
+ContactEntry *SortedEntryList::at(int pos) const
+{
+    const Node *node = m_root;
+    while (node) {
+        int leftSize = size(node->left);
+        if (pos < leftSize) {
+            node = node->left;
+        } else if (pos == leftSize) {
+            return node->entry;
+        } else {
+            pos -= (leftSize + 1);
+            node = node->right;
+        }
+    }
+    return 0;
+}
+
+QByteArray SortedEntryList::sortKey(ContactEntry *entry) const
+{
+    const Node *node = m_nodes.value(entry, 0);
+    return node ? node->key : QByteArray();
+}
+
+int SortedEntryList::size() const
+{
+    return m_nodes.size();
+}
+
+QList<ContactEntry*> SortedEntryList::values() const
+{
+    QList<const Node*> nodes;
+    inOrder(&nodes);
+
+    QList<ContactEntry*> result;
+    result.reserve(nodes.size());
+    Q_FOREACH(const Node *node, nodes) {
+        result << node->entry;
+    }
+    return result;
+}
+
+QList<QByteArray> SortedEntryList::sortKeys() const
+{
+    QList<const Node*> nodes;
+    inOrder(&nodes);
+
+    QList<QByteArray> result;
+    result.reserve(nodes.size());
+    Q_FOREACH(const Node *node, nodes) {
+        result << node->key;
+    }
+    return result;
+}
+
+SortedEntryList::Node *SortedEntryList::createNode(ContactEntry *entry, const QByteArray &sortKey)
+{
+    Node *node = new Node;
+    node->entry = entry;
+    node->key = sortKey;
+    node->seq = m_nextSeq++;
+    node->priority = nextPriority();
+    node->size = 1;
+    node->left = 0;
+    node->right = 0;
+    return node;
+}
+
+// xorshift, the priorities only need to be well distributed
+quint32 SortedEntryList::nextPriority()
+{
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+int SortedEntryList::rank(const Node *node) const
+{
+    int pos = 0;
+    const Node *current = m_root;
+    while (current) {
+        if (current == node) {
+            return pos + size(current->left);
+        } else if (lessThan(node, current)) {
+            current = current->left;
+        } else {
+            pos += size(current->left) + 1;
+            current = current->right;
+        }
+    }
+    return -1;
+}
+
+void SortedEntryList::inOrder(QList<const Node*> *nodes) const
+{
+    nodes->reserve(m_nodes.size());
+
+    QList<const Node*> stack;
+    const Node *current = m_root;
+    while (current || !stack.isEmpty()) {
+        while (current) {
+            stack << current;
+            current = current->left;
+        }
+        current = stack.takeLast();
+        *nodes << current;
+        current = current->right;
+    }
+}
+
+bool SortedEntryList::lessThan(const Node *a, const Node *b)
+{
+    int result = SortClause::compareSortKeys(a->key, b->key);
+    if (result != 0) {
+        return (result < 0);
+    }
+    return (a->seq < b->seq);
+}
+
+int SortedEntryList::size(const Node *node)
+{
+    return node ? node->size : 0;
+}
+
+void SortedEntryList::updateSize(Node *node)
+{
+    node->size = size(node->left) + size(node->right) + 1;
+}
+
+// split the tree in the nodes before and after the node
+void SortedEntryList::split(Node *tree, const Node *node, Node **left, Node **right)
+{
+    if (!tree) {
+        *left = 0;
+        *right = 0;
+    } else if (lessThan(tree, node)) {
+        split(tree->right, node, &tree->right, right);
+        *left = tree;
+        updateSize(tree);
+    } else {
+        split(tree->left, node, left, &tree->left);
+        *right = tree;
+        updateSize(tree);
+    }
+}
+
+SortedEntryList::Node *SortedEntryList::merge(Node *left, Node *right)
+{
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        updateSize(left);
+        return left;
+    } else {
+        right->left = merge(left, right->left);
+        updateSize(right);
+        return right;
+    }
+}
+
+void SortedEntryList::erase(Node **tree, const Node *node)
+{
+    Node *current = *tree;
+    if (!current) {
+        return;
+    }
+
+    if (current == node) {
+        *tree = merge(current->left, current->right);
+        return;
+    }
+
+    if (lessThan(node, current)) {
+        erase(&current->left, node);
+    } else {
+        erase(&current->right, node);
+    }
+    updateSize(current);
+}
+
+} //namespace
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_SORTED_ENTRY_LIST_H__
+#define __GALERA_SORTED_ENTRY_LIST_H__
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+
+namespace galera
+{
+
+class ContactEntry;
+
+// List of contact entries ordered by the keys created by SortClause::sortKey.
+// Entries with the same key keep the insertion order.
+// It is implemented as a treap with the subtree sizes, insert, remove and
+// position lookups (rank/select) are O(log n).
+class SortedEntryList
+{
+public:
+    SortedEntryList();
+    ~SortedEntryList();
+
+    // return the entry position
+    int insert(ContactEntry *entry, const QByteArray &sortKey);
+    // return the old entry position or -1 if the entry is not in the list
+    int remove(ContactEntry *entry);
+    // move the entry to the position of the new key, return the new position
+    int update(ContactEntry *entry, const QByteArray &sortKey);
+    // replace the list contents, the entries must be already sorted
+    void assign(const QList<ContactEntry*> &entries, const QList<QByteArray> &sortKeys);
+    void clear();
+
+    bool contains(ContactEntry *entry) const;
+    int indexOf(ContactEntry *entry) const;
+    ContactEntry *at(int pos) const;
+    QByteArray sortKey(ContactEntry *entry) const;
+    int size() const;
+
+    QList<ContactEntry*> values() const;
+    QList<QByteArray> sortKeys() const;
+
+private:
+    struct Node
+    {
+        ContactEntry *entry;
+        QByteArray key;
+        quint64 seq;
+        quint32 priority;
+        int size;
+        Node *left;
+        Node *right;
+    };
+
+    Node *m_root;
+    QHash<ContactEntry*, Node*> m_nodes;
+    quint64 m_nextSeq;
+    quint32 m_seed;
+
+    SortedEntryList(const SortedEntryList &other);
+    SortedEntryList &operator=(const SortedEntryList &other);
+
+    Node *createNode(ContactEntry *entry, const QByteArray &sortKey);
+    quint32 nextPriority();
+    int rank(const Node *node) const;
+    void inOrder(QList<const Node*> *nodes) const;
+
+    static bool lessThan(const Node *a, const Node *b);
+    static int size(const Node *node);
+    static void updateSize(Node *node);
+    static void split(Node *tree, const Node *node, Node **left, Node **right);
+    static Node *merge(Node *left, Node *right);
+    static void erase(Node **tree, const Node *node);
+};
+
+} //namespace
+
+#endif
@@ -16,15 +16,23 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
 #include "update-contact-request.h"
 #include "qindividual.h"
 #include "detail-context-parser.h"
 #include "gee-utils.h"
+#include "eds-client-cache.h"
 
 #include "common/vcard-parser.h"
 
 #include <QtContacts/qcontactdetails.h>
 
+#include <folks/folks-eds.h>
+#include <libebook/libebook.h>
+
+// time to wait for folks to reload the EDS contact after a write
+#define EDS_CONTACT_RELOAD_TIMEOUT  5000
+
 using namespace QtContacts;
 
 namespace galera {
@@ -51,8 +59,19 @@ UpdateContactRequest::UpdateContactRequest(QtContacts::QContact newContact, QInd
       m_currentPersona(0),
       m_eventLoop(0),
       m_newContact(newContact),
-      m_currentPersonaIndex(0)
+      m_currentPersonaIndex(0),
+      m_edsWritten(false),
+      m_edsContactHandlerId(0),
+      m_edsModifyDone(false),
+      m_edsContactChanged(false)
 {
+    m_edsContactTimer.setSingleShot(true);
+    m_edsContactTimer.setInterval(EDS_CONTACT_RELOAD_TIMEOUT);
+    QObject::connect(&m_edsContactTimer, &QTimer::timeout, [this]() {
+        qWarning() << "Timeout waiting for the EDS contact reload";
+        edsPersonaDone();
+    });
+
     int slotIndex = listener->metaObject()->indexOfSlot(++slot);
     if (slotIndex == -1) {
         qWarning() << "Invalid slot:" << slot << "for object" << listener;
@@ -237,21 +256,39 @@ QList<QtContacts::QContactDetail> UpdateContactRequest::detailsFromPersona(QtCon
     return detailsFromPersona(m_newContact, type, persona, (persona==1), pref);
 }
 
+// the new details of the current persona for 'type', return false if they are the same of the original contact
+bool UpdateContactRequest::detailsChanged(QtContacts::QContactDetail::DetailType type,
+                                          QList<QtContacts::QContactDetail> *newDetails,
+                                          QtContacts::QContactDetail *prefDetail) const
+{
+    if (prefDetail) {
+        *prefDetail = QContactDetail();
+        QContactDetail originalPref;
+        QList<QContactDetail> originalDetails = originalDetailsFromPersona(type, m_currentPersonaIndex, &originalPref);
+        *newDetails = detailsFromPersona(type, m_currentPersonaIndex, prefDetail);
+        return !isEqual(originalDetails, originalPref, *newDetails, *prefDetail);
+    }
+
+    QList<QContactDetail> originalDetails = originalDetailsFromPersona(type, m_currentPersonaIndex, 0);
+    *newDetails = detailsFromPersona(type, m_currentPersonaIndex, 0);
+    return !isEqual(originalDetails, *newDetails);
+}
+
+bool UpdateContactRequest::fullNameChanged(const QString &fullName) const
+{
+    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeDisplayLabel, m_currentPersonaIndex, 0);
+    return (originalDetails.size() > 0) &&
+           (originalDetails[0].value(QContactDisplayLabel::FieldLabel).toString() != fullName);
+}
+
 void UpdateContactRequest::updateAddress()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeAddress,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeAddress,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_POSTAL_ADDRESS_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
-        qDebug() << "Adderess diff";
+        detailsChanged(QContactDetail::TypeAddress, &newDetails, &prefDetail)) {
+        qDebug() << "Address diff";
         GeeSet *newSet = SET_AFD_NEW();
 
         Q_FOREACH(QContactDetail newDetail, newDetails) {
@@ -292,6 +329,31 @@ void UpdateContactRequest::updateAddress()
     }
 }
 
+// if the avatar changed and the rev still the same we need to reset it to force a sync
+void UpdateContactRequest::updateAvatarRevision()
+{
+    QContactExtendedDetail originalAvatarRev;
+    QContactExtendedDetail newAvatarRev;
+    Q_FOREACH(const QContactExtendedDetail &det,
+              originalDetailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0)) {
+        if (det.name() == "X-AVATAR-REV") {
+            originalAvatarRev = det;
+            break;
+        }
+    }
+    Q_FOREACH(const QContactExtendedDetail &det,
+              detailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0)) {
+        if (det.name() == "X-AVATAR-REV") {
+            newAvatarRev = det;
+            break;
+        }
+    }
+    if (originalAvatarRev.data() == newAvatarRev.data()) {
+        newAvatarRev.setData("");
+        m_newContact.saveDetail(&newAvatarRev);
+    }
+}
+
 void UpdateContactRequest::updateAvatar()
 {
     QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeAvatar, m_currentPersonaIndex, 0);
@@ -304,28 +366,7 @@ void UpdateContactRequest::updateAvatar()
                  << "\n\t" << originalDetails.size() << (originalDetails.size() > 0 ? originalDetails[0] : QContactDetail()) << "\n"
                  << "\n\t" << newDetails.size() << (newDetails.size() > 0 ? newDetails[0] : QContactDetail());
 
-        // update avatar version if necessary
-        QContactExtendedDetail originalAvatarRev;
-        QContactExtendedDetail newAvatarRev;
-        Q_FOREACH(const QContactExtendedDetail &det,
-                  originalDetailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0)) {
-            if (det.name() == "X-AVATAR-REV") {
-                originalAvatarRev = det;
-                break;
-            }
-        }
-        Q_FOREACH(const QContactExtendedDetail &det,
-                  detailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0)) {
-            if (det.name() == "X-AVATAR-REV") {
-                newAvatarRev = det;
-                break;
-            }
-        }
-        // if the avatar changed and the rev still the same we need to reset it to force a sync
-        if (originalAvatarRev.data() == newAvatarRev.data()) {
-            newAvatarRev.setData("");
-            m_newContact.saveDetail(&newAvatarRev);
-        }
+        updateAvatarRevision();
 
         //Only supports one avatar
         QUrl avatarUri;
@@ -370,12 +411,10 @@ void UpdateContactRequest::updateAvatar()
 
 void UpdateContactRequest::updateBirthday()
 {
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeBirthday, m_currentPersonaIndex, 0);
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeBirthday, m_currentPersonaIndex, 0);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_BIRTHDAY_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, newDetails)) {
+        detailsChanged(QContactDetail::TypeBirthday, &newDetails, 0)) {
         qDebug() << "birthday diff";
         //Only supports one birthday
         QDateTime dateTimeBirthday;
@@ -404,14 +443,10 @@ void UpdateContactRequest::updateBirthday()
 
 void UpdateContactRequest::updateFullName(const QString &fullName)
 {
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeDisplayLabel, m_currentPersonaIndex, 0);
     if (m_currentPersona &&
         FOLKS_IS_NAME_DETAILS(m_currentPersona) &&
-        originalDetails.size() > 0 &&
-        (originalDetails[0].value(QContactDisplayLabel::FieldLabel).toString() != fullName)) {
-        qDebug() << "Full Name diff:"
-                 << "\n\t" << originalDetails.size() << (originalDetails.size() > 0 ? originalDetails[0] : QContactDetail()) << "\n"
-                 << "\n\t" << fullName;
+        fullNameChanged(fullName)) {
+        qDebug() << "Full Name diff:" << fullName;
         //Only supports one fullName
         QByteArray fullNameUtf8 = fullName.toUtf8();
         folks_name_details_change_full_name(FOLKS_NAME_DETAILS(m_currentPersona),
@@ -425,19 +460,11 @@ void UpdateContactRequest::updateFullName(const QString &fullName)
 
 void UpdateContactRequest::updateEmail()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeEmailAddress,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
-
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeEmailAddress,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_EMAIL_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
+        detailsChanged(QContactDetail::TypeEmailAddress, &newDetails, &prefDetail)) {
         qDebug() << "email diff";
         GeeSet *newSet = SET_AFD_NEW();
 
@@ -464,12 +491,10 @@ void UpdateContactRequest::updateEmail()
 
 void UpdateContactRequest::updateName()
 {
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeName, m_currentPersonaIndex, 0);
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeName, m_currentPersonaIndex, 0);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_NAME_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, newDetails)) {
+        detailsChanged(QContactDetail::TypeName, &newDetails, 0)) {
         //Only supports one fullName
         FolksStructuredName *sn = 0;
         if (newDetails.count()) {
@@ -501,12 +526,10 @@ void UpdateContactRequest::updateName()
 
 void UpdateContactRequest::updateNickname()
 {
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeNickname, m_currentPersonaIndex, 0);
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeNickname, m_currentPersonaIndex, 0);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_NAME_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, newDetails)) {
+        detailsChanged(QContactDetail::TypeNickname, &newDetails, 0)) {
         qDebug() << "Nickname diff";
         //Only supports one fullName
         QString nicknameValue;
@@ -527,14 +550,11 @@ void UpdateContactRequest::updateNickname()
 
 void UpdateContactRequest::updateNote()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeNote, m_currentPersonaIndex, &originalPref);
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeNote, m_currentPersonaIndex, &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_EMAIL_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
+        detailsChanged(QContactDetail::TypeNote, &newDetails, &prefDetail)) {
         qDebug() << "notes diff";
         GeeSet *newSet = SET_AFD_NEW();
 
@@ -561,18 +581,11 @@ void UpdateContactRequest::updateNote()
 
 void UpdateContactRequest::updateOnlineAccount()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeOnlineAccount,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeOnlineAccount,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_IM_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
+        detailsChanged(QContactDetail::TypeOnlineAccount, &newDetails, &prefDetail)) {
         qDebug() << "OnlineAccounts diff";
         GeeMultiMap *imMap = GEE_MULTI_MAP_AFD_NEW(FOLKS_TYPE_IM_FIELD_DETAILS);
 
@@ -606,18 +619,11 @@ void UpdateContactRequest::updateOnlineAccount()
 
 void UpdateContactRequest::updateOrganization()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeOrganization,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeOrganization,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_ROLE_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
+        detailsChanged(QContactDetail::TypeOrganization, &newDetails, &prefDetail)) {
         qDebug() << "Organization diff";
         GeeSet *newSet = SET_AFD_NEW();
 
@@ -653,22 +659,12 @@ void UpdateContactRequest::updateOrganization()
 
 void UpdateContactRequest::updatePhone()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypePhoneNumber,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypePhoneNumber,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_PHONE_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
-        qDebug() << "Phone diff:"
-                 << "\n\t" << originalDetails.size() << (originalDetails.size() > 0 ? originalDetails[0] : QContactDetail()) << "\n"
-                 << "\n\t" << newDetails.size() << (newDetails.size() > 0 ? newDetails[0] : QContactDetail());
-
+        detailsChanged(QContactDetail::TypePhoneNumber, &newDetails, &prefDetail)) {
+        qDebug() << "Phone diff";
         GeeSet *newSet = SET_AFD_NEW();
 
         Q_FOREACH(QContactDetail newDetail, newDetails) {
@@ -694,19 +690,11 @@ void UpdateContactRequest::updatePhone()
 
 void UpdateContactRequest::updateUrl()
 {
-    QContactDetail originalPref;
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeUrl,
-                                                                       m_currentPersonaIndex,
-                                                                       &originalPref);
-
     QContactDetail prefDetail;
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeUrl,
-                                                          m_currentPersonaIndex,
-                                                          &prefDetail);
-
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
         FOLKS_IS_URL_DETAILS(m_currentPersona) &&
-        !isEqual(originalDetails, originalPref, newDetails, prefDetail)) {
+        detailsChanged(QContactDetail::TypeUrl, &newDetails, &prefDetail)) {
         qDebug() << "Url diff";
         GeeSet *newSet = SET_AFD_NEW();
 
@@ -767,16 +755,430 @@ void UpdateContactRequest::updateFavorite()
 
 void UpdateContactRequest::updateExtendedDetails()
 {
-    QList<QContactDetail> originalDetails = originalDetailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0);
-    QList<QContactDetail> newDetails = detailsFromPersona(QContactDetail::TypeExtendedDetail, m_currentPersonaIndex, 0);
+    QList<QContactDetail> newDetails;
     if (m_currentPersona &&
-        !isEqual(originalDetails, newDetails)) {
+        detailsChanged(QContactDetail::TypeExtendedDetail, &newDetails, 0)) {
         qDebug() << "Extended details diff";
         QIndividual::setExtendedDetails(m_currentPersona, newDetails);
     }
     updateDetailsDone(0, 0, this);
 }
 
+EVCardAttribute *UpdateContactRequest::edsAttribute(const char *name,
+                                                    const QtContacts::QContactDetail &detail,
+                                                    bool isPref)
+{
+    // same parameters that folks writes for the field details
+    EVCardAttribute *attr = e_vcard_attribute_new(NULL, name);
+    QStringList context = DetailContextParser::listContext(detail);
+    if (!context.isEmpty()) {
+        EVCardAttributeParam *param = e_vcard_attribute_param_new(EVC_TYPE);
+        Q_FOREACH(const QString &value, context) {
+            e_vcard_attribute_param_add_value(param, value.toUtf8().constData());
+        }
+        e_vcard_attribute_add_param(attr, param);
+    }
+    if (isPref) {
+        e_vcard_attribute_add_param_with_value(attr,
+                                               e_vcard_attribute_param_new(VCardParser::PrefParamName.toUtf8().constData()),
+                                               "1");
+    }
+    return attr;
+}
+
+// the TYPE and PREF params of the attribute, in a form that does not depend on the writer
+QStringList UpdateContactRequest::edsAttributeParams(EVCardAttribute *attr)
+{
+    QStringList params;
+    for(GList *l = e_vcard_attribute_get_params(attr); l; l = l->next) {
+        EVCardAttributeParam *param = static_cast<EVCardAttributeParam*>(l->data);
+        QString name = QString::fromUtf8(e_vcard_attribute_param_get_name(param)).toUpper();
+        if ((name != QLatin1String(EVC_TYPE)) && (name != VCardParser::PrefParamName)) {
+            continue;
+        }
+        for(GList *v = e_vcard_attribute_param_get_values(param); v; v = v->next) {
+            QString value = QString::fromUtf8(static_cast<const char*>(v->data)).toLower();
+            if ((name == VCardParser::PrefParamName) || (value == QStringLiteral("pref"))) {
+                params << VCardParser::PrefParamName;
+            } else {
+                params << value;
+            }
+        }
+    }
+    params.sort();
+    return params;
+}
+
+bool UpdateContactRequest::edsIsSameAttribute(EVCardAttribute *attrA, EVCardAttribute *attrB)
+{
+    GList *valuesA = e_vcard_attribute_get_values(attrA);
+    GList *valuesB = e_vcard_attribute_get_values(attrB);
+    for(; valuesA && valuesB; valuesA = valuesA->next, valuesB = valuesB->next) {
+        if (g_strcmp0(static_cast<const char*>(valuesA->data),
+                      static_cast<const char*>(valuesB->data)) != 0) {
+            return false;
+        }
+    }
+    if (valuesA || valuesB) {
+        return false;
+    }
+    return edsAttributeParams(attrA) == edsAttributeParams(attrB);
+}
+
+// replace the attributes, the ones that did not change are kept as they are
+// in the contact to preserve the params written by other clients
+void UpdateContactRequest::edsReplaceAttributes(EContact *contact,
+                                                const char *name,
+                                                const QList<EVCardAttribute*> &attributes)
+{
+    QList<EVCardAttribute*> oldAttributes;
+    for(GList *l = e_vcard_get_attributes(E_VCARD(contact)); l; l = l->next) {
+        EVCardAttribute *attr = static_cast<EVCardAttribute*>(l->data);
+        if (g_ascii_strcasecmp(e_vcard_attribute_get_name(attr), name) == 0) {
+            oldAttributes << attr;
+        }
+    }
+
+    QList<EVCardAttribute*> newAttributes;
+    Q_FOREACH(EVCardAttribute *attr, attributes) {
+        EVCardAttribute *newAttr = attr;
+        for(int i = 0; i < oldAttributes.size(); i++) {
+            if (edsIsSameAttribute(oldAttributes.at(i), attr)) {
+                newAttr = e_vcard_attribute_copy(oldAttributes.takeAt(i));
+                e_vcard_attribute_free(attr);
+                break;
+            }
+        }
+        newAttributes << newAttr;
+    }
+
+    e_vcard_remove_attributes(E_VCARD(contact), NULL, name);
+    Q_FOREACH(EVCardAttribute *attr, newAttributes) {
+        e_vcard_append_attribute(E_VCARD(contact), attr);
+    }
+}
+
+// the values of the vCard attribute that EDS uses for the detail
+QStringList UpdateContactRequest::edsAttributeValues(const QtContacts::QContactDetail &detail)
+{
+    QStringList values;
+    switch(detail.type()) {
+    case QContactDetail::TypeAddress:
+    {
+        QContactAddress addr = static_cast<QContactAddress>(detail);
+        values << addr.postOfficeBox()
+               << QString()
+               << addr.street()
+               << addr.locality()
+               << addr.region()
+               << addr.postcode()
+               << addr.country();
+        break;
+    }
+    case QContactDetail::TypeEmailAddress:
+        values << static_cast<QContactEmailAddress>(detail).emailAddress();
+        break;
+    case QContactDetail::TypeNote:
+        values << static_cast<QContactNote>(detail).note();
+        break;
+    case QContactDetail::TypeOnlineAccount:
+        values << static_cast<QContactOnlineAccount>(detail).accountUri();
+        break;
+    case QContactDetail::TypePhoneNumber:
+        values << static_cast<QContactPhoneNumber>(detail).number();
+        break;
+    case QContactDetail::TypeUrl:
+        values << static_cast<QContactUrl>(detail).url();
+        break;
+    default:
+        qWarning() << "No EDS attribute for detail" << detail.type();
+        break;
+    }
+    return values;
+}
+
+void UpdateContactRequest::edsReplaceDetails(EContact *contact,
+                                             const char *name,
+                                             const QList<QtContacts::QContactDetail> &details,
+                                             const QtContacts::QContactDetail &prefDetail)
+{
+    QList<EVCardAttribute*> attrs;
+    Q_FOREACH(const QContactDetail &detail, details) {
+        EVCardAttribute *attr = edsAttribute(name, detail, detail == prefDetail);
+        Q_FOREACH(const QString &value, edsAttributeValues(detail)) {
+            e_vcard_attribute_add_value(attr, value.toUtf8().constData());
+        }
+        attrs << attr;
+    }
+    edsReplaceAttributes(contact, name, attrs);
+}
+
+// apply the diff of the current persona into the EDS contact, return false if nothing changed,
+// 'reload' is false if only details not loaded by folks changed
+bool UpdateContactRequest::updateEdsContact(EContact *contact, bool *reload)
+{
+    bool changed = false;
+    QContactDetail prefDetail;
+    QList<QContactDetail> newDetails;
+
+    if (detailsChanged(QContactDetail::TypeAddress, &newDetails, &prefDetail)) {
+        edsReplaceDetails(contact, EVC_ADR, newDetails, prefDetail);
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeBirthday, &newDetails, 0)) {
+        EContactDate *date = 0;
+        if (newDetails.count()) {
+            QDate birthday = static_cast<QContactBirthday>(newDetails[0]).dateTime().toUTC().date();
+            if (birthday.isValid()) {
+                date = e_contact_date_new();
+                date->year = birthday.year();
+                date->month = birthday.month();
+                date->day = birthday.day();
+            }
+        }
+        e_contact_set(contact, E_CONTACT_BIRTH_DATE, date);
+        if (date) {
+            e_contact_date_free(date);
+        }
+        changed = true;
+    }
+
+    QString fullName = QIndividual::displayName(m_newContact);
+    if (fullNameChanged(fullName)) {
+        e_contact_set(contact, E_CONTACT_FULL_NAME, fullName.toUtf8().constData());
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeEmailAddress, &newDetails, &prefDetail)) {
+        edsReplaceDetails(contact, EVC_EMAIL, newDetails, prefDetail);
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeName, &newDetails, 0)) {
+        EContactName *name = 0;
+        if (newDetails.count()) {
+            QContactName qname = static_cast<QContactName>(newDetails[0]);
+            name = e_contact_name_new();
+            name->family = g_strdup(qname.lastName().toUtf8().constData());
+            name->given = g_strdup(qname.firstName().toUtf8().constData());
+            name->additional = g_strdup(qname.middleName().toUtf8().constData());
+            name->prefixes = g_strdup(qname.prefix().toUtf8().constData());
+            name->suffixes = g_strdup(qname.suffix().toUtf8().constData());
+        }
+        e_contact_set(contact, E_CONTACT_NAME, name);
+        if (name) {
+            e_contact_name_free(name);
+        }
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeNickname, &newDetails, 0)) {
+        QByteArray nickname;
+        if (newDetails.count()) {
+            nickname = static_cast<QContactNickname>(newDetails[0]).nickname().toUtf8();
+        }
+        e_contact_set(contact, E_CONTACT_NICKNAME, nickname.isEmpty() ? NULL : nickname.constData());
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeNote, &newDetails, &prefDetail)) {
+        edsReplaceDetails(contact, EVC_NOTE, newDetails, prefDetail);
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeOnlineAccount, &newDetails, &prefDetail)) {
+        // protocols saved by EDS in its own attributes
+        static QMap<int, const char*> imAttributes;
+        if (imAttributes.isEmpty()) {
+            imAttributes[QContactOnlineAccount::ProtocolAim] = EVC_X_AIM;
+            imAttributes[QContactOnlineAccount::ProtocolIcq] = EVC_X_ICQ;
+            imAttributes[QContactOnlineAccount::ProtocolJabber] = EVC_X_JABBER;
+            imAttributes[QContactOnlineAccount::ProtocolMsn] = EVC_X_MSN;
+            imAttributes[QContactOnlineAccount::ProtocolSkype] = EVC_X_SKYPE;
+            imAttributes[QContactOnlineAccount::ProtocolYahoo] = EVC_X_YAHOO;
+        }
+
+        bool supported = true;
+        QMap<int, QList<QContactDetail> > accounts;
+        Q_FOREACH(const QContactDetail &newDetail, newDetails) {
+            int protocol = static_cast<QContactOnlineAccount>(newDetail).protocol();
+            if (protocol == QContactOnlineAccount::ProtocolUnknown) {
+                continue;
+            }
+            if (!imAttributes.contains(protocol)) {
+                supported = false;
+                break;
+            }
+            accounts[protocol] << newDetail;
+        }
+
+        if (supported) {
+            Q_FOREACH(int protocol, imAttributes.keys()) {
+                edsReplaceDetails(contact, imAttributes[protocol], accounts.value(protocol), prefDetail);
+            }
+            changed = true;
+        } else {
+            // updateOnlineAccount runs on the TypeEmailAddress step, see updateDetailsDone
+            m_folksDetailTypes << QContactDetail::TypeEmailAddress;
+        }
+    }
+
+    if (detailsChanged(QContactDetail::TypeOrganization, &newDetails, &prefDetail)) {
+        if (newDetails.size() <= 1) {
+            QContactOrganization org;
+            if (newDetails.count()) {
+                org = static_cast<QContactOrganization>(newDetails[0]);
+            }
+            QByteArray name = org.name().toUtf8();
+            QByteArray title = org.title().toUtf8();
+            QByteArray role = org.role().toUtf8();
+            e_contact_set(contact, E_CONTACT_ORG, name.isEmpty() ? NULL : name.constData());
+            e_contact_set(contact, E_CONTACT_TITLE, title.isEmpty() ? NULL : title.constData());
+            e_contact_set(contact, E_CONTACT_ROLE, role.isEmpty() ? NULL : role.constData());
+            changed = true;
+        } else {
+            // folks keeps the extra organizations in its own attributes
+            m_folksDetailTypes << QContactDetail::TypeOrganization;
+        }
+    }
+
+    if (detailsChanged(QContactDetail::TypePhoneNumber, &newDetails, &prefDetail)) {
+        edsReplaceDetails(contact, EVC_TEL, newDetails, prefDetail);
+        changed = true;
+    }
+
+    if (detailsChanged(QContactDetail::TypeUrl, &newDetails, &prefDetail)) {
+        edsReplaceDetails(contact, EVC_URL, newDetails, prefDetail);
+        changed = true;
+    }
+
+    // folks does not load the extended details
+    *reload = changed;
+    // the avatar is written later by folks, but its revision goes with the extended details
+    if (FOLKS_IS_AVATAR_DETAILS(m_currentPersona) &&
+        detailsChanged(QContactDetail::TypeAvatar, &newDetails, 0)) {
+        updateAvatarRevision();
+    }
+    if (detailsChanged(QContactDetail::TypeExtendedDetail, &newDetails, 0)) {
+        QIndividual::applyExtendedDetails(contact, newDetails);
+        changed = true;
+    }
+
+    return changed;
+}
+
+// write all details of an EDS persona with a single contact modification,
+// return false if the persona is not from EDS or nothing changed
+bool UpdateContactRequest::updateEdsPersona()
+{
+    m_edsWritten = false;
+    // avatar and favorite are stored by folks in its own format
+    m_folksDetailTypes.clear();
+    m_folksDetailTypes << QContactDetail::TypeAvatar
+                       << QContactDetail::TypeFavorite;
+
+    FolksPersonaStore *store = folks_persona_get_store(m_currentPersona);
+    if (!EDSF_IS_PERSONA(m_currentPersona) || !EDSF_IS_PERSONA_STORE(store)) {
+        return false;
+    }
+
+    EContact *contact = e_contact_duplicate(edsf_persona_get_contact(EDSF_PERSONA(m_currentPersona)));
+    bool reload = false;
+    m_edsWritten = true;
+    if (!updateEdsContact(contact, &reload)) {
+        g_object_unref(contact);
+        return false;
+    }
+
+    ESource *source = edsf_persona_store_get_source(EDSF_PERSONA_STORE(store));
+    EBookClient *client = EdsClientCache::client(source);
+    if (!client) {
+        g_object_unref(contact);
+        // write the details through folks
+        m_edsWritten = false;
+        return false;
+    }
+
+    // wait for folks to reload the persona when EDS notifies the change,
+    // as the folks property changes do
+    m_edsModifyDone = false;
+    m_edsContactChanged = !reload;
+    if (reload) {
+        m_edsContactHandlerId = g_signal_connect(m_currentPersona,
+                                                 "notify::contact",
+                                                 (GCallback) edsContactChanged,
+                                                 this);
+    }
+    e_book_client_modify_contact(client,
+                                 contact,
+                                 NULL,
+                                 (GAsyncReadyCallback) edsModifyContactDone,
+                                 this);
+    g_object_unref(contact);
+    g_object_unref(client);
+    return true;
+}
+
+void UpdateContactRequest::edsPersonaDone(const QString &errorMessage)
+{
+    m_edsContactTimer.stop();
+    if (m_edsContactHandlerId) {
+        g_signal_handler_disconnect(m_currentPersona, m_edsContactHandlerId);
+        m_edsContactHandlerId = 0;
+    }
+
+    if (!errorMessage.isEmpty()) {
+        qWarning() << "Fail to update contact" << errorMessage;
+        invokeSlot(errorMessage);
+    } else {
+        // continue with the details updated through folks
+        updateDetailsDone(0, 0, this);
+    }
+}
+
+void UpdateContactRequest::edsModifyContactDone(GObject *source, GAsyncResult *result, gpointer userdata)
+{
+    UpdateContactRequest *self = static_cast<UpdateContactRequest*>(userdata);
+
+    GError *error = NULL;
+    e_book_client_modify_contact_finish(E_BOOK_CLIENT(source), result, &error);
+    if (error) {
+        QString errorMessage = QString::fromUtf8(error->message);
+        g_error_free(error);
+        self->edsPersonaDone(errorMessage);
+        return;
+    }
+
+    self->m_edsModifyDone = true;
+    if (self->m_edsContactChanged) {
+        self->edsPersonaDone();
+    } else {
+        self->m_edsContactTimer.start();
+    }
+}
+
+void UpdateContactRequest::edsContactChanged(GObject *persona, GParamSpec *pspec, gpointer userdata)
+{
+    Q_UNUSED(persona);
+    Q_UNUSED(pspec);
+    UpdateContactRequest *self = static_cast<UpdateContactRequest*>(userdata);
+
+    // only the first reload matters
+    g_signal_handler_disconnect(self->m_currentPersona, self->m_edsContactHandlerId);
+    self->m_edsContactHandlerId = 0;
+
+    self->m_edsContactChanged = true;
+    if (self->m_edsModifyDone) {
+        // folks updates the persona properties after the contact, continue
+        // once it is done
+        self->m_edsContactTimer.stop();
+        QTimer::singleShot(0, self, [self]() {
+            self->edsPersonaDone();
+        });
+    }
+}
+
 void UpdateContactRequest::updatePersona()
 {
     if (m_personas.size() <= m_currentPersonaIndex) {
@@ -790,7 +1192,9 @@ void UpdateContactRequest::updatePersona()
         g_object_ref(m_currentPersona);
         m_currentDetailType = QContactDetail::TypeUndefined;
         m_currentPersonaIndex++;
-        updateDetailsDone(0, 0, this);
+        if (!updateEdsPersona()) {
+            updateDetailsDone(0, 0, this);
+        }
     }
 }
 
@@ -873,7 +1277,13 @@ void UpdateContactRequest::updateDetailsDone(GObject *detail, GAsyncResult *resu
         }
     }
 
-    self->m_currentDetailType += 1;
+    // the details of EDS personas were already written, except the ones left to folks
+    do {
+        self->m_currentDetailType += 1;
+    } while (self->m_edsWritten &&
+             (self->m_currentDetailType < QContactDetail::TypeVersion) &&
+             !self->m_folksDetailTypes.contains(self->m_currentDetailType));
+
     switch(static_cast<QContactDetail::DetailType>(self->m_currentDetailType)) {
     case QContactDetail::TypeAddress:
         self->updateAddress();
@@ -21,15 +21,21 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QList>
 #include <QtCore/QMetaMethod>
 #include <QtCore/QEventLoop>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
 
 #include <QtContacts/QContact>
 #include <QtContacts/QContactDetail>
 
 #include <folks/folks.h>
 
+typedef struct _EContact EContact;
+typedef struct _EVCardAttribute EVCardAttribute;
+
 namespace galera {
 
 class QIndividual;
@@ -68,6 +74,15 @@ private:
     QMetaMethod m_slot;
     int m_currentPersonaIndex;
 
+    // EDS personas receive all details in a single contact write, the
+    // details listed in m_folksDetailTypes are still updated through folks
+    bool m_edsWritten;
+    QSet<int> m_folksDetailTypes;
+    gulong m_edsContactHandlerId;
+    bool m_edsModifyDone;
+    bool m_edsContactChanged;
+    QTimer m_edsContactTimer;
+
     void invokeSlot(const QString &errorMessage = QString());
     static bool isEqual(QList<QtContacts::QContactDetail> listA,
                         const QtContacts::QContactDetail &prefA,
@@ -89,11 +104,32 @@ private:
     QList<QtContacts::QContactDetail> detailsFromPersona(QtContacts::QContactDetail::DetailType type,
                                                          int persona,
                                                          QtContacts::QContactDetail *pref) const;
+    bool detailsChanged(QtContacts::QContactDetail::DetailType type,
+                        QList<QtContacts::QContactDetail> *newDetails,
+                        QtContacts::QContactDetail *prefDetail) const;
+    bool fullNameChanged(const QString &fullName) const;
 
 
     void updatePersona();
+    bool updateEdsPersona();
+    bool updateEdsContact(EContact *contact, bool *reload);
+    void edsPersonaDone(const QString &errorMessage = QString());
+    static EVCardAttribute *edsAttribute(const char *name,
+                                         const QtContacts::QContactDetail &detail,
+                                         bool isPref);
+    static QStringList edsAttributeParams(EVCardAttribute *attr);
+    static bool edsIsSameAttribute(EVCardAttribute *attrA, EVCardAttribute *attrB);
+    static void edsReplaceAttributes(EContact *contact,
+                                     const char *name,
+                                     const QList<EVCardAttribute*> &attributes);
+    static QStringList edsAttributeValues(const QtContacts::QContactDetail &detail);
+    static void edsReplaceDetails(EContact *contact,
+                                  const char *name,
+                                  const QList<QtContacts::QContactDetail> &details,
+                                  const QtContacts::QContactDetail &prefDetail);
     void updateAddress();
     void updateAvatar();
+    void updateAvatarRevision();
     void updateBirthday();
     void updateFullName(const QString &fullName);
     void updateEmail();
@@ -112,6 +148,8 @@ private:
                                    GAsyncResult *result);
 
     static void updateDetailsDone(GObject *detail, GAsyncResult *result, gpointer userdata);
+    static void edsModifyContactDone(GObject *source, GAsyncResult *result, gpointer userdata);
+    static void edsContactChanged(GObject *persona, GParamSpec *pspec, gpointer userdata);
 };
 
 }
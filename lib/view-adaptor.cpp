@@ -59,6 +59,15 @@ QStringList ViewAdaptor::contactsDetails(const QStringList &fields, int startInd
     return QStringList();
 }
 
+QByteArray ViewAdaptor::contactsDetailsBinary(const QStringList &fields, int startIndex, int pageSize)
+{
+    if (m_view) {
+        return m_view->contactsDetailsBinary(fields, startIndex, pageSize);
+    } else {
+        return QByteArray();
+    }
+}
+
 int ViewAdaptor::count()
 {
     if (m_view) {
@@ -59,6 +59,12 @@ class ViewAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"i\" name=\"pageSize\"/>\n"
 "      <arg direction=\"out\" type=\"as\"/>\n"
 "    </method>\n"
+"    <method name=\"contactsDetailsBinary\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"startIndex\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"pageSize\"/>\n"
+"      <arg direction=\"out\" type=\"ay\"/>\n"
+"    </method>\n"
 "    <method name=\"contactDetails\">\n"
 "      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
 "      <arg direction=\"in\" type=\"s\" name=\"id\"/>\n"
@@ -76,6 +82,7 @@ public:
 public Q_SLOTS:
     QString contactDetails(const QStringList &fields, const QString &id);
     QStringList contactsDetails(const QStringList &fields, int startIndex, int pageSize, const QDBusMessage &message);
+    QByteArray contactsDetailsBinary(const QStringList &fields, int startIndex, int pageSize);
     int count();
     void sort(const QString &field);
     void close();
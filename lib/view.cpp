@@ -23,6 +23,7 @@
 #include "qindividual.h"
 
 #include "common/vcard-parser.h"
+#include "common/contact-codec.h"
 #include "common/filter.h"
 #include "common/fetch-hint.h"
 #include "common/dbus-service-defs.h"
@@ -31,17 +32,79 @@
 
 #include <QtVersit/QVersitDocument>
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QSemaphore>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
 #include <QtCore/QCoreApplication>
 
 using namespace QtContacts;
 using namespace QtVersit;
 
+#define FILTER_CHUNK_SIZE   256
+
 namespace galera
 {
 
+class FilterThread;
+
+// contact matched by the view filter, index is the entry position on the scan
+struct FilterMatch
+{
+    int index;
+    QContact contact;
+    QByteArray sortKey;
+};
+
+// entries scanned by the filter thread and its helpers, each thread claims the
+// next chunk not filtered yet and keeps the matches of it in 'results'.
+// If 'topK' is set the chunk results only keep the best topK matches
+struct FilterScan
+{
+    FilterScan(const QList<ContactEntry*> &entries, bool preSorted, int topK)
+        : entries(entries),
+          preSorted(preSorted),
+          topK(topK),
+          chunks((entries.size() + FILTER_CHUNK_SIZE - 1) / FILTER_CHUNK_SIZE),
+          results(chunks),
+          nextChunk(0),
+          matches(0)
+    {
+    }
+
+    const QList<ContactEntry*> entries;
+    const bool preSorted;
+    const int topK;
+    const int chunks;
+    QVector<QList<FilterMatch> > results;
+    QAtomicInt nextChunk;
+    QAtomicInt matches;
+    QSemaphore helpersDone;
+};
+
+class FilterHelper : public QRunnable
+{
+public:
+    FilterHelper(FilterThread *filter, FilterScan *scan)
+        : m_filter(filter),
+          m_scan(scan)
+    {
+    }
+
+    void run();
+
+private:
+    FilterThread *m_filter;
+    FilterScan *m_scan;
+};
+
 class FilterThread: public QRunnable
 {
+    friend class FilterHelper;
+
 public:
     FilterThread(QString filter, QString sort, int maxCount, bool showInvisible, ContactsMap *allContacts, QObject *parent)
         : m_parent(parent),
@@ -51,56 +114,211 @@ public:
           m_allContacts(allContacts),
           m_showInvisible(showInvisible),
           m_canceled(false),
-          m_running(false),
-          m_done(false)
+          m_done(0)
     {
         setAutoDelete(false);
+        updateLoadTypes();
     }
 
     QList<QContact> result() const
     {
-        if (isRunning()) {
+        if (!done()) {
             return QList<QContact>();
         } else {
             return m_contacts;
         }
     }
 
-    bool appendContact(const QContact &contact, const QDateTime &deteletedAt)
+    // return the contact position or -1 if the contact does not match the view filter
+    int appendContact(ContactEntry *entry)
     {
-        if (checkContact(contact, deteletedAt)) {
-            addSorted(&m_contacts, contact, m_sortClause);
-            return true;
+        QIndividual *individual = entry->individual();
+        QContact contact = individual->contact(m_loadTypes);
+        if ((m_showInvisible || individual->isVisible()) &&
+            checkContact(individual, contact, individual->deletedAt())) {
+            return addSorted(contact);
         }
-        return false;
+        return -1;
     }
 
-    bool removeContact(const QContact &contact)
+    // return the old contact position or -1 if the contact was not part of the view
+    int removeContact(const QString &contactId)
     {
-        return m_contacts.removeAll(contact);
+        QByteArray localId = contactId.toUtf8();
+        int begin = 0;
+        int end = m_contacts.size();
+
+        // sorted views only look at the rows with the key the contact was added with
+        if (!m_sortKeys.isEmpty()) {
+            QHash<QByteArray, QByteArray>::iterator key = m_sortKeysById.find(localId);
+            if (key == m_sortKeysById.end()) {
+                return -1;
+            }
+            ContactLessThan lessThan;
+            QList<QByteArray>::iterator first(std::lower_bound(m_sortKeys.begin(), m_sortKeys.end(), key.value(), lessThan));
+            QList<QByteArray>::iterator last(std::upper_bound(first, m_sortKeys.end(), key.value(), lessThan));
+            begin = std::distance(m_sortKeys.begin(), first);
+            end = std::distance(m_sortKeys.begin(), last);
+            m_sortKeysById.erase(key);
+        }
+
+        for(int i = begin; i < end; i++) {
+            if (m_contacts.at(i).id().localId() == localId) {
+                m_contacts.removeAt(i);
+                if (!m_sortKeys.isEmpty()) {
+                    m_sortKeys.removeAt(i);
+                }
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // limited views with all rows used, a row that leaves them is replaced
+    bool isFull() const
+    {
+        return (m_maxCount > 0) && (m_contacts.size() >= m_maxCount);
+    }
+
+    // remove the rows after maxCount, return the position of the first row removed or -1
+    int trim()
+    {
+        if ((m_maxCount <= 0) || (m_contacts.size() <= m_maxCount)) {
+            return -1;
+        }
+
+        while (m_contacts.size() > m_maxCount) {
+            m_sortKeysById.remove(m_contacts.takeLast().id().localId());
+            if (!m_sortKeys.isEmpty()) {
+                m_sortKeys.removeLast();
+            }
+        }
+        return m_maxCount;
+    }
+
+    // add the best contact of the map that is not on the view to a limited view with
+    // a free row, return its position or -1. It runs on the main thread, that is the
+    // only one that changes the map
+    int refill()
+    {
+        if ((m_maxCount <= 0) || (m_contacts.size() >= m_maxCount) || !m_allContacts) {
+            return -1;
+        }
+
+        QSet<QByteArray> ids;
+        Q_FOREACH(const QContact &contact, m_contacts) {
+            ids << contact.id().localId();
+        }
+
+        bool found = false;
+        QContact best;
+        QByteArray bestKey;
+        Q_FOREACH(ContactEntry *entry, m_allContacts->values()) {
+            QIndividual *individual = entry->individual();
+            if (ids.contains(individual->id().toUtf8()) ||
+                !(m_showInvisible || individual->isVisible())) {
+                continue;
+            }
+
+            QContact contact = individual->contact(m_loadTypes);
+            if (!checkContact(individual, contact, individual->deletedAt())) {
+                continue;
+            }
+
+            if (m_sortClause.isEmpty()) {
+                // the first match on the map order
+                best = contact;
+                found = true;
+                break;
+            }
+
+            QByteArray sortKey = m_sortClause.sortKey(contact);
+            if (!found || (SortClause::compareSortKeys(sortKey, bestKey) < 0)) {
+                best = contact;
+                bestKey = sortKey;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            return -1;
+        }
+        return m_sortClause.isEmpty() ? addSorted(best) : addSorted(best, bestKey);
     }
 
     void chageSort(SortClause clause)
     {
         m_sortClause = clause;
+        m_sortKeys.clear();
+        m_sortKeysById.clear();
+        updateLoadTypes();
         if (!clause.isEmpty()) {
-            ContactLessThan lessThan(m_sortClause);
-            qSort(m_contacts.begin(), m_contacts.end(), lessThan);
+            // the keys are created once and the contacts are sorted by them,
+            // the view contacts may not have the details used by the new sort
+            QList<QContactDetail::DetailType> sortTypes = clause.detailTypes();
+            QList<QPair<QByteArray, QContact> > sorted;
+            Q_FOREACH(const QContact &contact, m_contacts) {
+                ContactEntry *entry = m_allContacts ? m_allContacts->value(QString::fromUtf8(contact.id().localId())) : 0;
+                QByteArray sortKey = entry ?
+                            m_sortClause.sortKey(entry->individual()->contact(sortTypes)) :
+                            m_sortClause.sortKey(contact);
+                sorted << qMakePair(sortKey, contact);
+            }
+            std::stable_sort(sorted.begin(), sorted.end(), sortKeyLessThan);
+
+            m_contacts.clear();
+            for(int i = 0; i < sorted.size(); i++) {
+                m_sortKeys << sorted.at(i).first;
+                m_contacts << sorted.at(i).second;
+                m_sortKeysById.insert(sorted.at(i).second.id().localId(), sorted.at(i).first);
+            }
         }
     }
 
-    void addSorted(QList<QContact> *sorted, const QContact &toAdd, const SortClause& sortOrder)
+    int addSorted(const QContact &toAdd)
     {
-        if (!sortOrder.isEmpty()) {
-            ContactLessThan lessThan(sortOrder);
-            QList<QContact>::iterator it(std::upper_bound(sorted->begin(), sorted->end(), toAdd, lessThan));
-            sorted->insert(it, toAdd);
+        if (!m_sortClause.isEmpty()) {
+            return addSorted(toAdd, m_sortClause.sortKey(toAdd));
         } else {
             // no sort order just add it to the end
-            sorted->append(toAdd);
+            m_contacts.append(toAdd);
+            return m_contacts.size() - 1;
         }
     }
 
+    int addSorted(const QContact &toAdd, const QByteArray &sortKey)
+    {
+        ContactLessThan lessThan;
+        QList<QByteArray>::iterator it(std::upper_bound(m_sortKeys.begin(), m_sortKeys.end(), sortKey, lessThan));
+        int pos = std::distance(m_sortKeys.begin(), it);
+        m_sortKeys.insert(it, sortKey);
+        m_contacts.insert(pos, toAdd);
+        m_sortKeysById.insert(toAdd.id().localId(), sortKey);
+        return pos;
+    }
+
+    // contacts already sorted by the contacts map
+    void append(const QContact &contact, const QByteArray &sortKey)
+    {
+        m_contacts.append(contact);
+        if (!m_sortClause.isEmpty()) {
+            m_sortKeys.append(sortKey);
+            m_sortKeysById.insert(contact.id().localId(), sortKey);
+        }
+    }
+
+    static bool sortKeyLessThan(const QPair<QByteArray, QContact> &a, const QPair<QByteArray, QContact> &b)
+    {
+        return (SortClause::compareSortKeys(a.first, b.first) < 0);
+    }
+
+    // the scan position keeps the order of the matches with the same key
+    static bool filterMatchLessThan(const FilterMatch &a, const FilterMatch &b)
+    {
+        int result = SortClause::compareSortKeys(a.sortKey, b.sortKey);
+        return (result < 0) || ((result == 0) && (a.index < b.index));
+    }
+
     void cancel()
     {
         m_canceledLock.lockForWrite();
@@ -108,105 +326,199 @@ public:
         m_canceledLock.unlock();
     }
 
-    bool isRunning() const
+    // the filter results can only be read after this returns true
+    bool done() const
     {
-        return m_running;
+        return (m_done.loadAcquire() != 0);
     }
 
-    bool done() const
+    // block until run() returns, the thread can be deleted after that
+    void wait()
     {
-        return m_done;
+        m_finished.acquire();
     }
 
 protected:
-    void notifyFinished()
+    void run()
     {
-        m_running = false;
-        m_done = true;
+        filter();
+
+        // the results are published by m_done, the View waits for m_finished
+        // before deleting the thread, no member is used after the release
+        m_done.storeRelease(1);
         QMetaObject::invokeMethod(m_parent, "onFilterDone", Qt::QueuedConnection);
+        m_finished.release();
     }
 
-    void run()
+    void filter()
     {
-        if (m_canceled || !m_allContacts) {
-            notifyFinished();
+        if (isCanceled() || !m_allContacts) {
             return;
         }
 
+        // the map is only locked to collect the entries, after that the entries
+        // are pinned and the map can be changed while the contacts are filtered.
+        // The View keeps the changes done during the filter and apply them later
         m_allContacts->lockForRead();
-        // only sort contacts if the contacts was stored in a different order into the contacts map
-        bool needSort = (!m_sortClause.isEmpty() &&
-                         (m_sortClause.toContactSortOrder() != m_allContacts->sort().toContactSortOrder()));
+        // the contacts map keeps the contacts sorted by the view sort clause
+        QList<QByteArray> sortKeys;
+        QList<ContactEntry*> sortedEntries;
+        QList<ContactEntry *> preFilter;
+        // filters without optimization check all contacts in the map order
+        bool preSorted = m_filter.isValid() && !m_filter.isEmpty() && !prefilter(&preFilter);
+        if (m_filter.isValid() && (m_filter.isEmpty() || preSorted)) {
+            sortedEntries = m_sortClause.isEmpty() ?
+                        m_allContacts->values() :
+                        m_allContacts->values(m_sortClause, &sortKeys);
+        }
+        m_allContacts->pin();
+        m_allContacts->unlock();
+
         // filter contacts if necessary
         if (m_filter.isValid() && m_filter.isEmpty()) {
-            Q_FOREACH(ContactEntry *entry, m_allContacts->values()) {
+            for(int i = 0; i < sortedEntries.size(); i++) {
+                ContactEntry *entry = sortedEntries.at(i);
                 if ((m_showInvisible || entry->individual()->isVisible()) &&
                     !entry->individual()->deletedAt().isValid()) {
 
-                    QContact contact = entry->individual()->contact();
-
-                    if (needSort) {
-                        addSorted(&m_contacts, contact, m_sortClause);
-                    } else {
-                        m_contacts.append(contact);
-                    }
+                    QContact contact = entry->individual()->contact(m_loadTypes);
+                    append(contact, sortKeys.value(i));
 
-                    if ((m_maxCount > 0) && (m_maxCount >= m_contacts.size())) {
+                    if ((m_maxCount > 0) && (m_contacts.size() >= m_maxCount)) {
                         break;
                     }
                 }
             }
         } else if (m_filter.isValid()) {
-            // optmization
-            QList<ContactEntry *> preFilter;
+            if (preSorted) {
+                qDebug() << "Filter not optimized" << m_filter.toContactFilter();
+                preFilter = sortedEntries;
+            }
+
+            // the matches of a limited view not sorted by the map are selected
+            // by the sort clause, otherwise the scan stops after maxCount matches
+            int topK = (!preSorted && !m_sortClause.isEmpty() && (m_maxCount > 0)) ? m_maxCount : 0;
+
+            // big scans are split between the threads available on the pool,
+            // the helpers that can not start now are not waited for
+            FilterScan scan(preFilter, preSorted, topK);
+            int helpers = qMin(QThread::idealThreadCount(), scan.chunks) - 1;
+            int started = 0;
+            for(; started < helpers; started++) {
+                FilterHelper *helper = new FilterHelper(this, &scan);
+                if (!QThreadPool::globalInstance()->tryStart(helper)) {
+                    delete helper;
+                    break;
+                }
+            }
+            filterChunks(&scan);
+            scan.helpersDone.acquire(started);
 
-            // check if is a query by id
-            QStringList idsToFilter = m_filter.idsToFilter();
-            if (!idsToFilter.isEmpty()) {
-                preFilter = m_allContacts->values(idsToFilter);
+            if (isCanceled()) {
+                m_allContacts->unpin();
+                return;
+            }
+
+            // the chunks are merged in the scan order, that is the same result
+            // of filtering the entries one by one
+            QList<FilterMatch> matches;
+            for(int c = 0; c < scan.chunks; c++) {
+                matches << scan.results.at(c);
+            }
+            if (topK > 0) {
+                int count = qMin(topK, matches.size());
+                std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), filterMatchLessThan);
+                matches = matches.mid(0, count);
             } else {
-                // check if is a phone number query
-                QString phoneToFilter = m_filter.phoneNumberToFilter();
-                if (!phoneToFilter.isEmpty()) {
-                    preFilter = m_allContacts->valueByPhone(phoneToFilter);
-                } else {
-                    qDebug() << "Filter not optimized" << m_filter.toContactFilter();
-                    preFilter = m_allContacts->values();
+                if (m_maxCount > 0) {
+                    matches = matches.mid(0, m_maxCount);
+                }
+                if (!preSorted && !m_sortClause.isEmpty()) {
+                    std::sort(matches.begin(), matches.end(), filterMatchLessThan);
                 }
             }
+            Q_FOREACH(const FilterMatch &match, matches) {
+                append(match.contact, preSorted ? sortKeys.value(match.index) : match.sortKey);
+            }
+        } else {
+            // invalid filter
+            m_contacts.clear();
+            m_sortKeys.clear();
+            m_sortKeysById.clear();
+        }
+
+        m_allContacts->unpin();
+    }
+
+    // filter the chunks not claimed by other thread until the scan ends, the
+    // view is canceled or the view already has enough contacts
+    void filterChunks(FilterScan *scan)
+    {
+        bool createKeys = !scan->preSorted && !m_sortClause.isEmpty();
+        while ((scan->topK > 0) || (m_maxCount <= 0) || (scan->matches.load() < m_maxCount)) {
+            int chunk = scan->nextChunk.fetchAndAddOrdered(1);
+            if (chunk >= scan->chunks) {
+                return;
+            }
 
-            Q_FOREACH(ContactEntry *entry, preFilter) {
-                m_canceledLock.lockForRead();
-                if (m_canceled) {
-                    m_canceledLock.unlock();
-                    m_allContacts->unlock();
-                    notifyFinished();
+            QList<FilterMatch> &result = scan->results[chunk];
+            int end = qMin(scan->entries.size(), (chunk + 1) * FILTER_CHUNK_SIZE);
+            for(int i = chunk * FILTER_CHUNK_SIZE; i < end; i++) {
+                if (isCanceled()) {
                     return;
                 }
 
-                QContact contact = entry->individual()->contact();
-                QDateTime deletedAt = entry->individual()->deletedAt();
-                m_canceledLock.unlock();
-
+                ContactEntry *entry = scan->entries.at(i);
+                QContact contact = entry->individual()->contact(m_loadTypes);
                 if ((m_showInvisible || entry->individual()->isVisible()) &&
-                    checkContact(contact, deletedAt)) {
-                    if (needSort) {
-                        addSorted(&m_contacts, contact, m_sortClause);
-                    } else {
-                        m_contacts.append(contact);
+                    checkContact(entry->individual(), contact, entry->individual()->deletedAt())) {
+                    FilterMatch match;
+                    match.index = i;
+                    match.contact = contact;
+                    if (createKeys) {
+                        match.sortKey = m_sortClause.sortKey(contact);
                     }
-                    if ((m_maxCount > 0) && (m_contacts.size() >= m_maxCount)) {
-                        break;
+                    result << match;
+
+                    // bounded heap with the best matches, the worst one is on the top
+                    if (scan->topK > 0) {
+                        std::push_heap(result.begin(), result.end(), filterMatchLessThan);
+                        if (result.size() > scan->topK) {
+                            std::pop_heap(result.begin(), result.end(), filterMatchLessThan);
+                            result.removeLast();
+                        }
                     }
                 }
             }
-        } else {
-            // invalid filter
-            m_contacts.clear();
+            scan->matches.fetchAndAddOrdered(result.size());
         }
+    }
 
-        m_allContacts->unlock();
-        notifyFinished();
+    // collect the entries of the optimized filters, return false if the filter
+    // can not use any map index
+    bool prefilter(QList<ContactEntry*> *entries)
+    {
+        // check if is a query by id
+        QStringList idsToFilter = m_filter.idsToFilter();
+        if (!idsToFilter.isEmpty()) {
+            *entries = m_allContacts->values(idsToFilter);
+            return true;
+        }
+
+        // check if is a phone number query
+        QString phoneToFilter = m_filter.phoneNumberToFilter();
+        if (!phoneToFilter.isEmpty()) {
+            *entries = m_allContacts->valueByPhone(phoneToFilter);
+            return true;
+        }
+
+        // check if is a text query
+        QList<QStringList> textToFilter = m_filter.textToFilter();
+        if (!textToFilter.isEmpty()) {
+            *entries = m_allContacts->valuesByText(textToFilter);
+            return true;
+        }
+        return false;
     }
 
 private:
@@ -215,32 +527,67 @@ private:
     SortClause m_sortClause;
     ContactsMap *m_allContacts;
     QList<QContact> m_contacts;
+    // sort keys of m_contacts, empty if there is no sort clause
+    QList<QByteArray> m_sortKeys;
+    // sort key of each contact on the view, used to find its row
+    QHash<QByteArray, QByteArray> m_sortKeysById;
 
+    // details loaded by the scans, empty to load the whole contact
+    QList<QContactDetail::DetailType> m_loadTypes;
     int m_maxCount;
     bool m_showInvisible;
     bool m_canceled;
     QReadWriteLock m_canceledLock;
-    bool m_running;
-    bool m_done;
+    QAtomicInt m_done;
+    QSemaphore m_finished;
 
-    bool checkContact(const QContact &contact, const QDateTime &deletedAt)
+    // only the details tested by the filter and used by the sort are loaded
+    void updateLoadTypes()
     {
+        m_loadTypes = m_filter.detailTypes();
+        if (!m_loadTypes.isEmpty()) {
+            Q_FOREACH(QContactDetail::DetailType type, m_sortClause.detailTypes()) {
+                if (!m_loadTypes.contains(type)) {
+                    m_loadTypes << type;
+                }
+            }
+        }
+    }
+
+    bool isCanceled()
+    {
+        QReadLocker locker(&m_canceledLock);
+        return m_canceled;
+    }
+
+    bool checkContact(QIndividual *individual, const QContact &contact, const QDateTime &deletedAt)
+    {
+        if (m_filter.hasPhoneNumberTest()) {
+            // avoid parse the contact phone numbers for every view
+            QList<ParsedPhoneNumber> phoneNumbers = individual->phoneNumbers();
+            return m_filter.test(contact, deletedAt, &phoneNumbers);
+        }
         return m_filter.test(contact, deletedAt);
     }
 };
 
+void FilterHelper::run()
+{
+    m_filter->filterChunks(m_scan);
+    m_scan->helpersDone.release();
+}
+
 View::View(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
            const QStringList &sources, ContactsMap *allContacts,
            QObject *parent)
     : QObject(parent),
       m_sources(sources),
+      m_allContacts(allContacts),
       m_filterThread(new FilterThread(clause, sort, maxCount, showInvisible, allContacts, this)),
       m_adaptor(0),
       m_waiting(0)
 {
-    if (allContacts) {
-        QThreadPool::globalInstance()->start(m_filterThread);
-    }
+    QThreadPool::globalInstance()->start(m_filterThread);
 }
 
 View::~View()
@@ -261,10 +608,9 @@ void View::close()
     }
 
     if (m_filterThread) {
-        if (!m_filterThread->done()) {
-            m_filterThread->cancel();
-            waitFilter();
-        }
+        // the runnable can still be running after done() returns true
+        m_filterThread->cancel();
+        m_filterThread->wait();
         delete m_filterThread;
         m_filterThread = 0;
     }
@@ -298,29 +644,113 @@ QStringList View::contactsDetails(const QStringList &fields, int startIndex, int
         pageSize = contacts.count() - startIndex;
     }
 
+    QList<QContactDetail::DetailType> fieldTypes = FetchHint::parseFieldNames(fields);
+    QStringList vcards;
     QList<QContact> pageOfContacts;
+    QVariantList missingIndexes;
+    QStringList missingIds;
+    QVariantList missingRevisions;
     for(int i = startIndex, iMax = (startIndex + pageSize); i < iMax; i++) {
-        pageOfContacts << QIndividual::copy(contacts.at(i), FetchHint::parseFieldNames(fields));
+        const QContact &contact = contacts.at(i);
+        ContactEntry *entry = m_allContacts ? m_allContacts->value(QString::fromUtf8(contact.id().localId())) : 0;
+        QString vcard = entry ? entry->individual()->cachedVCard(fieldTypes) : QString();
+
+        if (vcard.isEmpty()) {
+            missingIndexes << vcards.size();
+            if (entry) {
+                missingIds << entry->individual()->id();
+                missingRevisions << entry->individual()->revision();
+                pageOfContacts << entry->individual()->copy(fieldTypes);
+            } else {
+                missingIds << QString();
+                missingRevisions << 0;
+                pageOfContacts << QIndividual::copy(contact, fieldTypes);
+            }
+        }
+        vcards << vcard;
+    }
+
+    // all contacts were exported before
+    if (pageOfContacts.isEmpty()) {
+        QDBusConnection::sessionBus().send(message.createReply(vcards));
+        return vcards;
     }
 
     VCardParser *parser = new VCardParser(this);
     parser->setProperty("DATA", QVariant::fromValue<QDBusMessage>(message));
+    parser->setProperty("FIELDS", fields);
+    parser->setProperty("VCARDS", vcards);
+    parser->setProperty("MISSING_INDEXES", missingIndexes);
+    parser->setProperty("MISSING_IDS", missingIds);
+    parser->setProperty("MISSING_REVISIONS", missingRevisions);
     connect(parser, &VCardParser::vcardParsed,
             this, &View::onVCardParsed);
     parser->contactToVcard(pageOfContacts);
     return QStringList();
 }
 
+QByteArray View::contactsDetailsBinary(const QStringList &fields, int startIndex, int pageSize)
+{
+    if (!m_filterThread || !isOpen()) {
+        return QByteArray();
+    }
+
+    waitFilter();
+
+    const QList<QContact> &contacts = m_filterThread->result();
+    if (startIndex < 0) {
+        startIndex = 0;
+    }
+
+    if ((pageSize < 0) || ((startIndex + pageSize) >= contacts.count())) {
+        pageSize = contacts.count() - startIndex;
+    }
+
+    QList<QContactDetail::DetailType> fieldTypes = FetchHint::parseFieldNames(fields);
+    QList<QContact> pageOfContacts;
+    for(int i = startIndex, iMax = (startIndex + pageSize); i < iMax; i++) {
+        const QContact &contact = contacts.at(i);
+        ContactEntry *entry = m_allContacts ? m_allContacts->value(QString::fromUtf8(contact.id().localId())) : 0;
+        pageOfContacts << (entry ? entry->individual()->copy(fieldTypes) : QIndividual::copy(contact, fieldTypes));
+    }
+
+    return ContactCodec::encode(pageOfContacts);
+}
+
 void View::onVCardParsed(const QStringList &vcards)
 {
     QObject *sender = QObject::sender();
-    QDBusMessage reply = sender->property("DATA").value<QDBusMessage>().createReply(vcards);
+    QStringList result = sender->property("VCARDS").toStringList();
+    QVariantList missingIndexes = sender->property("MISSING_INDEXES").toList();
+    QStringList missingIds = sender->property("MISSING_IDS").toStringList();
+    QVariantList missingRevisions = sender->property("MISSING_REVISIONS").toList();
+
+    if (vcards.size() == missingIndexes.size()) {
+        QList<QContactDetail::DetailType> fieldTypes =
+                FetchHint::parseFieldNames(sender->property("FIELDS").toStringList());
+        for(int i = 0; i < vcards.size(); i++) {
+            const QString &vcard = vcards.at(i);
+            result[missingIndexes.at(i).toInt()] = vcard;
+
+            // store the new vcard on the contact cache
+            ContactEntry *entry = m_allContacts ? m_allContacts->value(missingIds.at(i)) : 0;
+            if (entry) {
+                entry->individual()->cacheVCard(fieldTypes, vcard, missingRevisions.at(i).toUInt());
+            }
+        }
+    } else {
+        qWarning() << "Fail to export contacts" << vcards.size() << "of" << missingIndexes.size();
+        result = vcards;
+    }
+
+    QDBusMessage reply = sender->property("DATA").value<QDBusMessage>().createReply(result);
     QDBusConnection::sessionBus().send(reply);
     sender->deleteLater();
 }
 
 void View::onFilterDone()
 {
+    applyPendingChanges();
     if (m_waiting) {
         m_waiting->quit();
         m_waiting = 0;
@@ -334,6 +764,25 @@ void View::waitFilter()
         m_waiting = &loop;
         loop.exec();
     }
+    applyPendingChanges();
+}
+
+void View::applyPendingChanges()
+{
+    if (m_pendingChanges.isEmpty() || !m_filterThread || !m_filterThread->done()) {
+        return;
+    }
+
+    QSet<QString> ids = m_pendingChanges;
+    m_pendingChanges.clear();
+    Q_FOREACH(const QString &id, ids) {
+        ContactEntry *entry = m_allContacts ? m_allContacts->value(id) : 0;
+        if (entry) {
+            updateContact(entry);
+        } else {
+            removeContact(id);
+        }
+    }
 }
 
 int View::count()
@@ -391,30 +840,91 @@ void View::unregisterObject(QDBusConnection &connection)
 }
 
 bool View::appendContact(ContactEntry *entry)
+{
+    // the same contact can be appended by the filter thread, update avoids duplicates
+    return updateContact(entry);
+}
+
+bool View::removeContact(ContactEntry *entry)
+{
+    return removeContact(entry->individual()->id());
+}
+
+bool View::removeContact(const QString &contactId)
 {
     if (!isOpen()) {
         return false;
     }
 
-    if (m_filterThread->appendContact(entry->individual()->contact(),
-                                      entry->individual()->deletedAt())) {
-        Q_EMIT countChanged(m_filterThread->result().count());
+    // the filter thread may have read the contact before the change, apply it later
+    if (!m_filterThread->done()) {
+        m_pendingChanges << contactId;
+        return false;
+    }
+
+    bool wasFull = m_filterThread->isFull();
+    int pos = m_filterThread->removeContact(contactId);
+    if (pos >= 0) {
+        Q_EMIT m_adaptor->contactsRemoved(pos, 1);
+        // limited views take the next contact of the map
+        int refillPos = wasFull ? m_filterThread->refill() : -1;
+        if (refillPos >= 0) {
+            Q_EMIT m_adaptor->contactsAdded(refillPos, 1);
+        } else {
+            Q_EMIT countChanged(m_filterThread->result().count());
+        }
         return true;
     }
     return false;
 }
 
-bool View::removeContact(ContactEntry *entry)
+bool View::updateContact(ContactEntry *entry)
 {
     if (!isOpen()) {
         return false;
     }
 
-    if (m_filterThread->removeContact(entry->individual()->contact())) {
-        Q_EMIT countChanged(m_filterThread->result().count());
+    // the filter thread may have read the contact before the change, apply it later
+    if (!m_filterThread->done()) {
+        m_pendingChanges << entry->individual()->id();
+        return false;
+    }
+
+    int oldCount = m_filterThread->result().count();
+    bool wasFull = m_filterThread->isFull();
+    int oldPos = m_filterThread->removeContact(entry->individual()->id());
+    int newPos = m_filterThread->appendContact(entry);
+
+    // limited views keep only the first maxCount rows
+    int droppedPos = m_filterThread->trim();
+    if ((droppedPos >= 0) && (droppedPos == newPos)) {
+        // the contact is after the last row
+        newPos = -1;
+        droppedPos = -1;
+    }
+    int refillPos = wasFull ? m_filterThread->refill() : -1;
+
+    if ((oldPos >= 0) && (oldPos == newPos)) {
+        Q_EMIT m_adaptor->contactsUpdated(newPos, 1);
         return true;
     }
-    return false;
+
+    if (oldPos >= 0) {
+        Q_EMIT m_adaptor->contactsRemoved(oldPos, 1);
+    }
+    if (newPos >= 0) {
+        Q_EMIT m_adaptor->contactsAdded(newPos, 1);
+    }
+    if (droppedPos >= 0) {
+        Q_EMIT m_adaptor->contactsRemoved(droppedPos, 1);
+    }
+    if (refillPos >= 0) {
+        Q_EMIT m_adaptor->contactsAdded(refillPos, 1);
+    }
+    if (m_filterThread->result().count() != oldCount) {
+        Q_EMIT countChanged(m_filterThread->result().count());
+    }
+    return ((oldPos >= 0) || (newPos >= 0));
 }
 
 QObject *View::adaptor() const
@@ -22,6 +22,7 @@
 #include <common/sort-clause.h>
 #include <common/filter.h>
 
+#include <QtCore/QSet>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtDBus/QtDBus>
@@ -54,9 +55,11 @@ public:
     // contacts
     bool appendContact(ContactEntry *entry);
     bool removeContact(ContactEntry *entry);
+    bool updateContact(ContactEntry *entry);
 
     // Adaptor
     QString contactDetails(const QStringList &fields, const QString &id);
+    QByteArray contactsDetailsBinary(const QStringList &fields, int startIndex, int pageSize);
     int count();
     void sort(const QString &field);
     void close();
@@ -76,11 +79,16 @@ Q_SIGNALS:
 
 private:
     QStringList m_sources;
+    ContactsMap *m_allContacts;
     FilterThread *m_filterThread;
     ViewAdaptor *m_adaptor;
     QEventLoop *m_waiting;
+    // contacts changed while the filter was running
+    QSet<QString> m_pendingChanges;
 
     void waitFilter();
+    void applyPendingChanges();
+    bool removeContact(const QString &contactId);
 };
 
 } //namespace
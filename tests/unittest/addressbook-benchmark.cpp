@@ -0,0 +1,311 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base-client-test.h"
+#include "dummy-backend.h"
+
+#include "common/dbus-service-defs.h"
+#include "common/filter.h"
+#include "common/vcard-parser.h"
+#include "lib/contacts-map.h"
+#include "lib/qindividual.h"
+
+#include <QObject>
+#include <QtDBus>
+#include <QtTest>
+#include <QDebug>
+
+#include <QtContacts>
+
+// number of contacts used by the benchmark, can be changed with the
+// ADDRESS_BOOK_BENCHMARK_SIZE environment variable
+#define BENCHMARK_DEFAULT_SIZE      1000
+#define BENCHMARK_PAGE_SIZE         100
+#define BENCHMARK_UPDATE_SIZE       50
+#define BENCHMARK_VIEWS             5
+
+using namespace QtContacts;
+
+// Run with "make benchmark", the results are written in the QTest xml format.
+class AddressBookBenchmark : public BaseClientTest
+{
+    Q_OBJECT
+private:
+    DummyBackendProxy *m_dummy;
+    int m_size;
+    int m_updateCount;
+
+    QContact generateContact(int index) const
+    {
+        QContact contact;
+        QContactName name;
+        name.setFirstName(QString("Name_%1").arg(index));
+        name.setLastName(QString("Surname_%1").arg(m_size - index));
+        contact.saveDetail(&name);
+
+        QContactEmailAddress email;
+        email.setEmailAddress(QString("name_%1@ubuntu.com").arg(index));
+        contact.saveDetail(&email);
+
+        QContactPhoneNumber phone;
+        phone.setNumber(QString("+55813%1").arg(index, 7, 10, QChar('0')));
+        contact.saveDetail(&phone);
+
+        QContactOrganization org;
+        org.setName(QString("Company_%1").arg(index % 100));
+        contact.saveDetail(&org);
+        return contact;
+    }
+
+    QString filterString(const QString &name) const
+    {
+        if (name == "phone") {
+            return galera::Filter(QContactPhoneNumber::match("+558130000042")).toString();
+        } else if (name == "label") {
+            QContactDetailFilter filter;
+            filter.setDetailType(QContactDetail::TypeDisplayLabel, QContactDisplayLabel::FieldLabel);
+            filter.setValue("name_4");
+            filter.setMatchFlags(QContactFilter::MatchContains);
+            return galera::Filter(filter).toString();
+        } else if (name == "favorite") {
+            QContactDetailFilter filter;
+            filter.setDetailType(QContactDetail::TypeFavorite, QContactFavorite::FieldFavorite);
+            filter.setValue(true);
+            return galera::Filter(filter).toString();
+        }
+        return QString();
+    }
+
+    QDBusInterface *openView(const QString &filter, const QString &sort)
+    {
+        QDBusReply<QDBusObjectPath> reply = m_serverIface->call("query", filter, sort, 0, false, QStringList());
+        if (!reply.isValid()) {
+            return 0;
+        }
+        return new QDBusInterface(m_serverIface->service(),
+                                  reply.value().path(),
+                                  CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+    }
+
+    void closeView(QDBusInterface *view)
+    {
+        view->call("close");
+        delete view;
+    }
+
+    QStringList contactsPage(int startIndex)
+    {
+        QDBusInterface *view = openView("", "");
+        QDBusReply<QStringList> reply = view->call("contactsDetails", QStringList(), startIndex, BENCHMARK_PAGE_SIZE);
+        closeView(view);
+        return reply.value();
+    }
+
+    QStringList changedVCards(const QStringList &vcards)
+    {
+        m_updateCount++;
+        QList<QContact> contacts;
+        Q_FOREACH(const QString &vcard, vcards) {
+            QContact contact = galera::VCardParser::vcardToContact(vcard);
+            QContactNickname nickname = contact.detail<QContactNickname>();
+            nickname.setNickname(QString("Nick_%1").arg(m_updateCount));
+            contact.saveDetail(&nickname);
+            contacts << contact;
+        }
+        return galera::VCardParser::contactToVcardSync(contacts);
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        BaseClientTest::initTestCase();
+
+        m_updateCount = 0;
+        m_size = BENCHMARK_DEFAULT_SIZE;
+        if (qEnvironmentVariableIsSet("ADDRESS_BOOK_BENCHMARK_SIZE")) {
+            m_size = qgetenv("ADDRESS_BOOK_BENCHMARK_SIZE").toInt();
+        }
+        qDebug() << "Benchmark with" << m_size << "contacts";
+
+        // local backend used to measure the contacts map load
+        m_dummy = new DummyBackendProxy();
+        m_dummy->start();
+        QTRY_VERIFY(m_dummy->isReady());
+
+        for(int i = 0; i < m_size; i++) {
+            QContact contact = generateContact(i);
+            m_dummy->createContact(contact);
+            m_dummyIface->call("createContact", galera::VCardParser::contactToVcard(contact));
+        }
+
+        // wait for the service to load all contacts
+        QDBusInterface *view = openView("", "");
+        QVERIFY(view);
+        QTRY_COMPARE_WITH_TIMEOUT(QDBusReply<int>(view->call("count")).value(), m_size, 60000);
+        closeView(view);
+    }
+
+    void cleanupTestCase()
+    {
+        m_dummy->shutdown();
+        delete m_dummy;
+        BaseClientTest::cleanupTestCase();
+    }
+
+    // keep the contacts between the benchmarks
+    void cleanup()
+    {
+    }
+
+    // same work done by the service when the individuals are loaded on startup
+    void benchmarkStartup()
+    {
+        QList<galera::QIndividual*> individuals = m_dummy->individuals();
+        QCOMPARE(individuals.size(), m_size);
+
+        QBENCHMARK {
+            galera::ContactsMap map;
+            Q_FOREACH(galera::QIndividual *i, individuals) {
+                map.insert(new galera::ContactEntry(new galera::QIndividual(i->individual(), m_dummy->aggregator())));
+            }
+            QCOMPARE(map.size(), m_size);
+        }
+    }
+
+    void benchmarkViewCreation_data()
+    {
+        QTest::addColumn<QString>("filter");
+        QTest::addColumn<QString>("sort");
+
+        QTest::newRow("all contacts") << "" << "";
+        QTest::newRow("all contacts by first name") << "" << "FIRST_NAME ASC";
+        QTest::newRow("phone number") << "phone" << "";
+        QTest::newRow("display label") << "label" << "";
+        QTest::newRow("favorites") << "favorite" << "";
+    }
+
+    void benchmarkViewCreation()
+    {
+        QFETCH(QString, filter);
+        QFETCH(QString, sort);
+        QString filterStr = filterString(filter);
+
+        QBENCHMARK {
+            QDBusInterface *view = openView(filterStr, sort);
+            QVERIFY(view);
+            // count waits for the view filter
+            QDBusReply<int> count = view->call("count");
+            QVERIFY(count.isValid());
+            closeView(view);
+        }
+    }
+
+    void benchmarkContactsDetails_data()
+    {
+        QTest::addColumn<QString>("method");
+        QTest::addColumn<QStringList>("fields");
+
+        QTest::newRow("vcard all fields") << "contactsDetails" << QStringList();
+        QTest::newRow("vcard list fields") << "contactsDetails" << (QStringList() << "FULL_NAME" << "TAG" << "PHONE");
+        QTest::newRow("binary all fields") << "contactsDetailsBinary" << QStringList();
+        QTest::newRow("binary list fields") << "contactsDetailsBinary" << (QStringList() << "FULL_NAME" << "TAG" << "PHONE");
+    }
+
+    void benchmarkContactsDetails()
+    {
+        QFETCH(QString, method);
+        QFETCH(QStringList, fields);
+
+        QDBusInterface *view = openView("", "");
+        QVERIFY(view);
+
+        // fetch all pages
+        QBENCHMARK {
+            for(int i = 0; i < m_size; i += BENCHMARK_PAGE_SIZE) {
+                QDBusMessage reply = view->call(method, fields, i, BENCHMARK_PAGE_SIZE);
+                QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+            }
+        }
+        closeView(view);
+    }
+
+    void benchmarkUpdateContacts()
+    {
+        QStringList vcards = contactsPage(0).mid(0, BENCHMARK_UPDATE_SIZE);
+        QVERIFY(!vcards.isEmpty());
+
+        QBENCHMARK {
+            QStringList changed = changedVCards(vcards);
+            QDBusReply<QStringList> reply = m_serverIface->call("updateContacts", changed);
+            QCOMPARE(reply.value().size(), changed.size());
+        }
+    }
+
+    // time between the update and the notifications of the service and the open views,
+    // this includes the service notification timeout
+    void benchmarkNotifyFanOut()
+    {
+        QStringList vcards = contactsPage(BENCHMARK_PAGE_SIZE).mid(0, BENCHMARK_UPDATE_SIZE);
+        QVERIFY(!vcards.isEmpty());
+
+        QList<QDBusInterface*> views;
+        for(int i = 0; i < BENCHMARK_VIEWS; i++) {
+            views << openView("", (i % 2) ? "FIRST_NAME ASC" : "");
+            QDBusReply<int> count = views.last()->call("count");
+            QCOMPARE(count.value(), m_size);
+        }
+
+        QBENCHMARK {
+            QSignalSpy updatedSpy(m_serverIface, SIGNAL(contactsUpdated(QStringList)));
+            QList<QSignalSpy*> viewSpies;
+            Q_FOREACH(QDBusInterface *view, views) {
+                viewSpies << new QSignalSpy(view, SIGNAL(contactsUpdated(int, int)));
+            }
+
+            m_serverIface->call("updateContacts", changedVCards(vcards));
+            QTRY_VERIFY_WITH_TIMEOUT(updatedSpy.count() > 0, 10000);
+            Q_FOREACH(QSignalSpy *spy, viewSpies) {
+                QTRY_VERIFY_WITH_TIMEOUT(spy->count() > 0, 10000);
+            }
+            qDeleteAll(viewSpies);
+        }
+
+        Q_FOREACH(QDBusInterface *view, views) {
+            closeView(view);
+        }
+    }
+
+    // this removes contacts, keep it as the last benchmark
+    void benchmarkRemoveContacts()
+    {
+        QStringList ids;
+        Q_FOREACH(const QString &vcard, contactsPage(0)) {
+            ids << galera::VCardParser::vcardToContact(vcard).detail<QContactGuid>().guid();
+        }
+        QVERIFY(!ids.isEmpty());
+
+        QBENCHMARK_ONCE {
+            QDBusReply<int> reply = m_serverIface->call("removeContacts", ids);
+            QVERIFY(reply.isValid());
+        }
+    }
+};
+
+QTEST_MAIN(AddressBookBenchmark)
+
+#include "addressbook-benchmark.moc"
@@ -18,7 +18,10 @@
 
 #include "base-client-test.h"
 #include "common/source.h"
+#include "common/parsed-phone-number.h"
+#include "common/phone-number-match.h"
 #include "common/dbus-service-defs.h"
+#include "common/filter.h"
 #include "common/vcard-parser.h"
 
 #include <QObject>
@@ -95,10 +98,44 @@ private:
         }
     }
 
+    QStringList viewFirstNames(QDBusInterface &view)
+    {
+        QDBusReply<QStringList> reply = view.call("contactsDetails", QStringList(), 0, -1);
+
+        QStringList firstNames;
+        Q_FOREACH(const QtContacts::QContact &contact, galera::VCardParser::vcardToContactSync(reply.value())) {
+            firstNames << contact.detail<QtContacts::QContactName>().firstName();
+        }
+        return firstNames;
+    }
+
+    QStringList viewFirstNames(const QString &clause, const QString &sort, int maxCount)
+    {
+        QDBusReply<QDBusObjectPath> replyQuery = m_serverIface->call("query", clause, sort, maxCount, false, QStringList());
+        QDBusInterface view(m_serverIface->service(),
+                            replyQuery.value().path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QStringList firstNames = viewFirstNames(view);
+        view.call("close");
+        return firstNames;
+    }
+
+    QString createNamedContact(const QString &name)
+    {
+        QString vcard = QString("BEGIN:VCARD\n"
+                                "VERSION:3.0\n"
+                                "N:Tal;%1;;;\n"
+                                "EMAIL:%1@ubuntu.com\n"
+                                "END:VCARD").arg(name);
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", vcard, "dummy-store");
+        return galera::VCardParser::vcardToContact(replyAdd.value()).detail<QContactGuid>().guid();
+    }
+
 private Q_SLOTS:
     void initTestCase()
     {
         BaseClientTest::initTestCase();
+        galera::PhoneNumberMatch::registerMetaType();
         m_basicVcard = QStringLiteral("BEGIN:VCARD\n"
                                       "VERSION:3.0\n"
                                       "N:Tal;Fulano_;de;;\n"
@@ -120,6 +157,15 @@ private Q_SLOTS:
                                        "END:VCARD\r\n");
     }
 
+    void testCapabilities()
+    {
+        QDBusReply<QStringList> reply = m_serverIface->call("capabilities");
+        QVERIFY(reply.isValid());
+        QVERIFY(reply.value().contains(CPIM_CAPABILITY_BINARY_DETAILS));
+        QVERIFY(reply.value().contains(CPIM_CAPABILITY_PHONE_LOOKUP));
+        QVERIFY(reply.value().contains(CPIM_CAPABILITY_BATCH_CREATE));
+    }
+
     void testSortFields()
     {
         QStringList defaultSortFields;
@@ -240,6 +286,31 @@ private Q_SLOTS:
         QCOMPARE(addedContactSpy.count(), 0);
     }
 
+    void testCreateContacts()
+    {
+        // spy 'contactsAdded' signal
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+
+        QString secondVcard = m_basicVcard;
+        secondVcard.replace("Fulano", "Beltrano");
+        QStringList vcards;
+        vcards << m_basicVcard << "INVALID VCARD" << secondVcard;
+
+        // the result keeps the request order, failures are empty
+        QDBusReply<QStringList> reply = m_serverIface->call("createContacts", vcards, "dummy-store");
+        QStringList result = reply.value();
+        QCOMPARE(result.count(), 3);
+        QVERIFY(!result[0].isEmpty());
+        QVERIFY(result[1].isEmpty());
+        QVERIFY(!result[2].isEmpty());
+        QCOMPARE(galera::VCardParser::vcardToContact(result[2]).detail<QContactName>().firstName(),
+                 QStringLiteral("Beltrano_"));
+
+        QDBusReply<QStringList> reply2 = m_dummyIface->call("listContacts");
+        QCOMPARE(reply2.value().count(), 2);
+        QTRY_VERIFY(addedContactSpy.count() > 0);
+    }
+
     void testRemoveContact()
     {
         // create a basic contact
@@ -271,6 +342,28 @@ private Q_SLOTS:
         QCOMPARE(replyList.value().count(), 0);
     }
 
+    void testLookupPhoneNumbers()
+    {
+        // create a basic contact
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QString newContactId = galera::VCardParser::vcardToContact(replyAdd.value()).detail<QContactGuid>().guid();
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        // the numbers are answered in a single call
+        QDBusReply<galera::PhoneNumberMatchList> reply =
+                m_serverIface->call("lookupPhoneNumbers", QStringList() << "3333-1410" << "99999999");
+        QVERIFY(reply.isValid());
+        QCOMPARE(reply.value().size(), 1);
+
+        galera::PhoneNumberMatch match = reply.value().first();
+        QCOMPARE(match.phoneNumber(), QString("3333-1410"));
+        QCOMPARE(match.contactId(), newContactId);
+        QCOMPARE(match.displayLabel(), QString("Fulano_ Tal"));
+        QCOMPARE(match.matchedNumber(), QString("33331410"));
+        QVERIFY(match.matchType() > galera::ParsedPhoneNumber::NoMatch);
+    }
+
     void testUpdateContact()
     {
         // create a basic contact
@@ -314,6 +407,142 @@ private Q_SLOTS:
         contactUpdatedResult = contacts[0];
         compareContact(contactUpdatedResult, contactUpdated);
     }
+
+    void testUpdateContactsConcurrently()
+    {
+        QString secondVcard = m_basicVcard;
+        secondVcard.replace("Fulano", "Beltrano");
+        QDBusReply<QStringList> replyAdd = m_serverIface->call("createContacts",
+                                                               QStringList() << m_basicVcard << secondVcard,
+                                                               "dummy-store");
+        QStringList created = replyAdd.value();
+        QCOMPARE(created.size(), 2);
+
+        // overlapping calls are replied independently
+        QDBusPendingCall first = m_serverIface->asyncCall("updateContacts",
+                                                          QStringList() << QString(created[0]).replace("8888888", "0000000"));
+        QDBusPendingCall second = m_serverIface->asyncCall("updateContacts",
+                                                           QStringList() << QString(created[1]).replace("8888888", "1111111")
+                                                                         << QString(created[1]).replace("8888888", "2222222"));
+        first.waitForFinished();
+        second.waitForFinished();
+
+        QDBusPendingReply<QStringList> firstReply = first;
+        QDBusPendingReply<QStringList> secondReply = second;
+        QCOMPARE(firstReply.value().size(), 1);
+        QVERIFY(firstReply.value()[0].contains("0000000"));
+        QCOMPARE(secondReply.value().size(), 2);
+
+        // the updates of the same contact run in the request order
+        QVERIFY(secondReply.value()[1].contains("2222222"));
+        QDBusReply<QStringList> replyList = m_dummyIface->call("listContacts");
+        QVERIFY(replyList.value().join("").contains("2222222"));
+        QVERIFY(!replyList.value().join("").contains("1111111"));
+    }
+
+    void testViewPositionalSignals()
+    {
+        // open a view with all contacts
+        QDBusReply<QDBusObjectPath> replyQuery = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QVERIFY(replyQuery.isValid());
+
+        QDBusInterface view(m_serverIface->service(),
+                            replyQuery.value().path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QSignalSpy viewAddedSpy(&view, SIGNAL(contactsAdded(int, int)));
+        QSignalSpy viewRemovedSpy(&view, SIGNAL(contactsRemoved(int, int)));
+
+        // create a contact, the view should receive it without a new query
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+        QTRY_COMPARE(viewAddedSpy.count(), 1);
+        QList<QVariant> args = viewAddedSpy.takeFirst();
+        QCOMPARE(args[0].toInt(), 0);
+        QCOMPARE(args[1].toInt(), 1);
+
+        // remove the contact
+        QContact newContact = galera::VCardParser::vcardToContact(replyAdd.value());
+        QString newContactId = newContact.detail<QContactGuid>().guid();
+        QDBusReply<int> replyRemove = m_serverIface->call("removeContacts", QStringList() << newContactId);
+        QCOMPARE(replyRemove.value(), 1);
+        QTRY_COMPARE(viewRemovedSpy.count(), 1);
+        args = viewRemovedSpy.takeFirst();
+        QCOMPARE(args[0].toInt(), 0);
+        QCOMPARE(args[1].toInt(), 1);
+
+        view.call("close");
+    }
+
+    void testViewMaxCountSorted()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QStringList names;
+        names << "Zeca" << "Maria" << "Ana";
+        Q_FOREACH(const QString &name, names) {
+            QString vcard = QString("BEGIN:VCARD\n"
+                                    "VERSION:3.0\n"
+                                    "N:Tal;%1;;;\n"
+                                    "EMAIL:%1@ubuntu.com\n"
+                                    "END:VCARD").arg(name);
+            QDBusReply<QString> replyAdd = m_serverIface->call("createContact", vcard, "dummy-store");
+            QVERIFY(!replyAdd.value().isEmpty());
+        }
+        QTRY_VERIFY(addedContactSpy.count() > 0);
+
+        // the text filter matches are not sorted by the contacts map, the view
+        // must keep the first contacts by name and not the first ones found
+        QContactDetailFilter emailFilter;
+        emailFilter.setDetailType(QContactDetail::TypeEmailAddress, QContactEmailAddress::FieldEmailAddress);
+        emailFilter.setMatchFlags(QContactFilter::MatchContains);
+        emailFilter.setValue("ubuntu.com");
+        QString clause = galera::Filter(emailFilter).toString();
+
+        QTRY_COMPARE_WITH_TIMEOUT(viewFirstNames(clause, "FIRST_NAME ASC", 2),
+                                  QStringList() << "Ana" << "Maria", 10000);
+        QCOMPARE(viewFirstNames(clause, "FIRST_NAME DESC", 1), QStringList() << "Zeca");
+    }
+
+    void testViewMaxCountLiveChanges()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QString zecaId = createNamedContact("Zeca");
+        QString mariaId = createNamedContact("Maria");
+        QString anaId = createNamedContact("Ana");
+        QVERIFY(!zecaId.isEmpty() && !mariaId.isEmpty() && !anaId.isEmpty());
+        QTRY_VERIFY(addedContactSpy.count() > 0);
+
+        QContactDetailFilter emailFilter;
+        emailFilter.setDetailType(QContactDetail::TypeEmailAddress, QContactEmailAddress::FieldEmailAddress);
+        emailFilter.setMatchFlags(QContactFilter::MatchContains);
+        emailFilter.setValue("ubuntu.com");
+        QString clause = galera::Filter(emailFilter).toString();
+
+        QDBusReply<QDBusObjectPath> replyQuery = m_serverIface->call("query", clause, "FIRST_NAME ASC", 2, false, QStringList());
+        QVERIFY(replyQuery.isValid());
+        QDBusInterface view(m_serverIface->service(),
+                            replyQuery.value().path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QTRY_COMPARE(viewFirstNames(view), QStringList() << "Ana" << "Maria");
+
+        // a new contact inside the limit pushes the last row out
+        QString betoId = createNamedContact("Beto");
+        QVERIFY(!betoId.isEmpty());
+        QTRY_COMPARE(viewFirstNames(view), QStringList() << "Ana" << "Beto");
+
+        // a new contact after the limit does not show up
+        QString xuxaId = createNamedContact("Xuxa");
+        QVERIFY(!xuxaId.isEmpty());
+        QTest::qWait(500);
+        QCOMPARE(viewFirstNames(view), QStringList() << "Ana" << "Beto");
+
+        // the next contact takes the row of a removed one
+        QDBusReply<int> replyRemove = m_serverIface->call("removeContacts", QStringList() << anaId);
+        QCOMPARE(replyRemove.value(), 1);
+        QTRY_COMPARE(viewFirstNames(view), QStringList() << "Beto" << "Maria");
+
+        view.call("close");
+    }
 };
 
 QTEST_MAIN(AddressBookTest)
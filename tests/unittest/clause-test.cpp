@@ -243,6 +243,12 @@ private Q_SLOTS:
         Filter myFilter(f);
         QCOMPARE(myFilter.test(c), match);
 
+        // same result with the contact numbers already parsed
+        QList<ParsedPhoneNumber> numbers;
+        numbers << ParsedPhoneNumber(phoneNumber);
+        QVERIFY(myFilter.hasPhoneNumberTest());
+        QCOMPARE(myFilter.test(c, QDateTime(), &numbers), match);
+
         // if the phoneNumber contains query
         f.setMatchFlags(QContactFilter::MatchPhoneNumber | QContactFilter::MatchContains);
         myFilter = Filter(f);
@@ -284,6 +290,32 @@ private Q_SLOTS:
         QCOMPARE(ids.size(), 0);
     }
 
+    void testExtractText()
+    {
+        QContactDetailFilter nameFilter;
+        nameFilter.setDetailType(QContactDetail::TypeDisplayLabel, QContactDisplayLabel::FieldLabel);
+        nameFilter.setMatchFlags(QContactFilter::MatchContains);
+        nameFilter.setValue("Foo");
+
+        QContactDetailFilter emailFilter;
+        emailFilter.setDetailType(QContactDetail::TypeEmailAddress, QContactEmailAddress::FieldEmailAddress);
+        emailFilter.setMatchFlags(QContactFilter::MatchStartsWith);
+        emailFilter.setValue("bar");
+
+        QList<QStringList> terms = Filter(nameFilter | emailFilter).textToFilter();
+        QCOMPARE(terms.size(), 1);
+        QCOMPARE(terms.first(), QStringList() << "foo" << "bar");
+
+        terms = Filter(nameFilter & emailFilter).textToFilter();
+        QCOMPARE(terms.size(), 2);
+
+        // phone number filters are not handled by the text index
+        QContactDetailFilter phoneFilter = QContactPhoneNumber::match("12345678");
+        QVERIFY(Filter(phoneFilter).textToFilter().isEmpty());
+        QVERIFY(Filter(nameFilter | phoneFilter).textToFilter().isEmpty());
+        QCOMPARE(Filter(nameFilter & phoneFilter).textToFilter().size(), 1);
+    }
+
     void testIncludeDeleted()
     {
         QContactChangeLogFilter removedFilter;
@@ -347,6 +379,75 @@ private Q_SLOTS:
         // filter again with favorites and removed contacts
         QVERIFY(removedAndFavoriteFilter.test(c, QDateTime::currentDateTime()));
     }
+
+    void testCompiledFilter_data()
+    {
+        QTest::addColumn<int>("matchFlags");
+        QTest::addColumn<QString>("value");
+
+        QTest::newRow("contains") << int(QContactFilter::MatchContains) << "oo";
+        QTest::newRow("starts with") << int(QContactFilter::MatchStartsWith) << "fo";
+        QTest::newRow("ends with") << int(QContactFilter::MatchEndsWith) << "OO";
+        QTest::newRow("fixed string") << int(QContactFilter::MatchFixedString) << "FOO";
+        QTest::newRow("case sensitive") << int(QContactFilter::MatchContains | QContactFilter::MatchCaseSensitive) << "OO";
+        QTest::newRow("exactly") << int(QContactFilter::MatchExactly) << "Foo";
+        QTest::newRow("no match") << int(QContactFilter::MatchContains) << "xyz";
+    }
+
+    void testCompiledFilter()
+    {
+        QFETCH(int, matchFlags);
+        QFETCH(QString, value);
+
+        QContact c;
+        QContactName name;
+        name.setFirstName("Foo");
+        name.setLastName("Bar");
+        c.saveDetail(&name);
+
+        QContactDetailFilter nameFilter;
+        nameFilter.setDetailType(QContactDetail::TypeName, QContactName::FieldFirstName);
+        nameFilter.setMatchFlags(QContactFilter::MatchFlags(matchFlags));
+        nameFilter.setValue(value);
+
+        QContactDetailFilter lastNameFilter;
+        lastNameFilter.setDetailType(QContactDetail::TypeName, QContactName::FieldLastName);
+        lastNameFilter.setMatchFlags(QContactFilter::MatchStartsWith);
+        lastNameFilter.setValue("Ba");
+
+        QContactDetailFilter phoneFilter = QContactPhoneNumber::match("12345678");
+
+        // the compiled filter gives the same result of the contacts engine
+        QList<QContactFilter> filters;
+        filters << nameFilter
+                << (nameFilter & lastNameFilter)
+                << (nameFilter | lastNameFilter)
+                << (phoneFilter | nameFilter)
+                << (phoneFilter & nameFilter & lastNameFilter);
+        Q_FOREACH(const QContactFilter &f, filters) {
+            QCOMPARE(Filter(f).test(c), QContactManagerEngine::testFilter(f, c));
+        }
+    }
+
+    void testDetailTypes()
+    {
+        QContactDetailFilter nameFilter;
+        nameFilter.setDetailType(QContactDetail::TypeName, QContactName::FieldFirstName);
+        nameFilter.setMatchFlags(QContactFilter::MatchContains);
+        nameFilter.setValue("Foo");
+
+        QList<QContactDetail::DetailType> types = Filter(nameFilter | QContactPhoneNumber::match("12345678")).detailTypes();
+        QVERIFY(types.contains(QContactDetail::TypeGuid));
+        QVERIFY(types.contains(QContactDetail::TypeName));
+        QVERIFY(types.contains(QContactDetail::TypePhoneNumber));
+        QVERIFY(!types.contains(QContactDetail::TypeEmailAddress));
+
+        // filters tested by the contacts engine need the whole contact
+        QContactChangeLogFilter changeLogFilter;
+        changeLogFilter.setEventType(QContactChangeLogFilter::EventAdded);
+        changeLogFilter.setSince(QDateTime::currentDateTime());
+        QVERIFY(Filter(nameFilter & changeLogFilter).detailTypes().isEmpty());
+    }
 };
 
 QTEST_MAIN(ClauseParseTest)
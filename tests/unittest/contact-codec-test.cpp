@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+
+#include <QtContacts>
+
+#include "common/contact-codec.h"
+
+using namespace QtContacts;
+using namespace galera;
+
+class ContactCodecTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    QContact createContact(const QString &name)
+    {
+        QContact contact;
+
+        QContactGuid guid;
+        guid.setGuid(name.toLower());
+        contact.saveDetail(&guid);
+
+        QContactName contactName;
+        contactName.setFirstName(name);
+        contactName.setLastName("Flintstone");
+        contactName.setDetailUri("1.1");
+        contact.saveDetail(&contactName);
+
+        QContactPhoneNumber phone;
+        phone.setNumber("33331410");
+        phone.setContexts(QContactDetail::ContextHome);
+        phone.setSubTypes(QList<int>() << QContactPhoneNumber::SubTypeMobile
+                                       << QContactPhoneNumber::SubTypeVoice);
+        phone.setDetailUri("1.1");
+        QContactManagerEngine::setDetailAccessConstraints(&phone, QContactDetail::ReadOnly);
+        contact.saveDetail(&phone);
+
+        QContactPhoneNumber fax;
+        fax.setNumber("33331411");
+        fax.setSubTypes(QList<int>() << QContactPhoneNumber::SubTypeFax);
+        fax.setDetailUri("1.2");
+        contact.saveDetail(&fax);
+        contact.setPreferredDetail("TEL", fax);
+
+        QContactAvatar avatar;
+        avatar.setImageUrl(QUrl("file:///tmp/avatar.png"));
+        contact.saveDetail(&avatar);
+
+        QContactBirthday birthday;
+        birthday.setDate(QDate(1960, 9, 30));
+        contact.saveDetail(&birthday);
+
+        QContactFavorite favorite;
+        favorite.setFavorite(true);
+        contact.saveDetail(&favorite);
+
+        return contact;
+    }
+
+private Q_SLOTS:
+    void testEncodeDecode()
+    {
+        QList<QContact> contacts;
+        contacts << createContact("Fred") << createContact("Wilma");
+
+        bool ok = false;
+        QList<QContact> result = ContactCodec::decode(ContactCodec::encode(contacts), &ok);
+        QVERIFY(ok);
+        QCOMPARE(result.size(), contacts.size());
+
+        for(int i=0; i < contacts.size(); i++) {
+            QCOMPARE(result[i].detail<QContactGuid>(), contacts[i].detail<QContactGuid>());
+            QCOMPARE(result[i].detail<QContactName>(), contacts[i].detail<QContactName>());
+            QCOMPARE(result[i].details<QContactPhoneNumber>(), contacts[i].details<QContactPhoneNumber>());
+            QCOMPARE(result[i].detail<QContactAvatar>(), contacts[i].detail<QContactAvatar>());
+            QCOMPARE(result[i].detail<QContactBirthday>(), contacts[i].detail<QContactBirthday>());
+            QCOMPARE(result[i].detail<QContactFavorite>(), contacts[i].detail<QContactFavorite>());
+
+            QContactPhoneNumber phone = result[i].details<QContactPhoneNumber>().at(0);
+            QVERIFY(phone.accessConstraints().testFlag(QContactDetail::ReadOnly));
+            QCOMPARE(phone.subTypes(), QList<int>() << QContactPhoneNumber::SubTypeMobile
+                                                    << QContactPhoneNumber::SubTypeVoice);
+            QCOMPARE(result[i].preferredDetail("TEL").value(QContactPhoneNumber::FieldNumber).toString(),
+                     QStringLiteral("33331411"));
+        }
+    }
+
+    void testEmptyList()
+    {
+        bool ok = false;
+        QList<QContact> result = ContactCodec::decode(ContactCodec::encode(QList<QContact>()), &ok);
+        QVERIFY(ok);
+        QVERIFY(result.isEmpty());
+    }
+
+    void testInvalidData()
+    {
+        bool ok = true;
+        QList<QContact> result = ContactCodec::decode(QByteArray("BEGIN:VCARD\r\nEND:VCARD\r\n"), &ok);
+        QVERIFY(!ok);
+        QVERIFY(result.isEmpty());
+
+        QByteArray truncated = ContactCodec::encode(QList<QContact>() << createContact("Fred"));
+        truncated.chop(10);
+        result = ContactCodec::decode(truncated, &ok);
+        QVERIFY(!ok);
+        QVERIFY(result.isEmpty());
+    }
+};
+
+QTEST_MAIN(ContactCodecTest)
+
+#include "contact-codec-test.moc"
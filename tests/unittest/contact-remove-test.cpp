@@ -0,0 +1,164 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QtContacts>
+
+#include "base-eds-test.h"
+#include "config.h"
+
+using namespace QtContacts;
+
+class ContactRemoveTest : public QObject, public BaseEDSTest
+{
+    Q_OBJECT
+
+private:
+    QContact createContact(const QString &name, const QString &sourceId = QString())
+    {
+        QContact contact;
+        QContactName contactName;
+        contactName.setFirstName(name);
+        contact.saveDetail(&contactName);
+
+        QContactPhoneNumber phone;
+        phone.setNumber("33331410");
+        contact.saveDetail(&phone);
+
+        if (!sourceId.isEmpty()) {
+            QContactSyncTarget target;
+            target.setSyncTarget(sourceId);
+            contact.saveDetail(&target);
+        }
+        return contact;
+    }
+
+    QString createSource()
+    {
+        QContact source;
+        source.setType(QContactType::TypeGroup);
+        QContactDisplayLabel label;
+        label.setLabel(QUuid::createUuid().toString().remove("{").remove("}"));
+        source.saveDetail(&label);
+
+        if (!m_manager->saveContact(&source)) {
+            return QString();
+        }
+        return source.id().toString().split("source@").last();
+    }
+
+    // contacts removed since 'date', the contacts removed by EDS are only marked as deleted
+    QList<QContactId> deletedContacts(const QDateTime &date)
+    {
+        QContactChangeLogFilter fDeleted(QContactChangeLogFilter::EventRemoved);
+        fDeleted.setSince(date);
+        return m_manager->contactIds(fDeleted);
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        BaseEDSTest::initTestCaseImpl();
+    }
+
+    void cleanupTestCase()
+    {
+        BaseEDSTest::cleanupTestCaseImpl();
+    }
+
+    void init()
+    {
+        BaseEDSTest::initImpl();
+    }
+
+    void cleanup()
+    {
+        QList<QContactId> contacts = m_manager->contactIds();
+        m_manager->removeContacts(contacts);
+        BaseEDSTest::cleanupImpl();
+    }
+
+    /*
+     * Test remove more contacts than fit in a single EDS batch
+     */
+    void testRemoveContactsInBatches()
+    {
+        QList<QContact> contacts;
+        for(int i = 0; i < 150; i++) {
+            contacts << createContact(QString("Fulano %1").arg(i));
+        }
+        QVERIFY(m_manager->saveContacts(&contacts));
+
+        QList<QContactId> ids;
+        Q_FOREACH(const QContact &contact, contacts) {
+            ids << contact.id();
+        }
+        QCOMPARE(m_manager->contactIds().size(), 150);
+
+        // wait one sec to cause a remove date later
+        QDateTime currentDate = QDateTime::currentDateTime();
+        QTest::qWait(1000);
+
+        QSignalSpy spyContactRemoved(m_manager, SIGNAL(contactsRemoved(QList<QContactId>)));
+        QVERIFY(m_manager->removeContacts(ids));
+        QTRY_VERIFY(spyContactRemoved.count() > 0);
+        QTRY_COMPARE(m_manager->contactIds().size(), 0);
+
+        // the contacts were marked as deleted by EDS
+        QList<QContactId> deletedIds = deletedContacts(currentDate);
+        QCOMPARE(deletedIds.size(), 150);
+        Q_FOREACH(const QContactId &id, ids) {
+            QVERIFY(deletedIds.contains(id));
+        }
+    }
+
+    /*
+     * Test remove contacts from a source that is not connected yet
+     */
+    void testRemoveContactsThroughFolks()
+    {
+        QString sourceId = createSource();
+        QVERIFY(!sourceId.isEmpty());
+
+        QContact contact = createContact("Fulano", sourceId);
+        QVERIFY(m_manager->saveContact(&contact));
+        QCOMPARE(contact.detail<QContactSyncTarget>().value(QContactSyncTarget::FieldSyncTarget + 1).toString(),
+                 sourceId);
+
+        // the client of the new source was not connected, the contact is removed by folks
+        QDateTime currentDate = QDateTime::currentDateTime();
+        QTest::qWait(1000);
+        QVERIFY(m_manager->removeContact(contact.id()));
+        QTRY_VERIFY(!m_manager->contactIds().contains(contact.id()));
+        QVERIFY(!deletedContacts(currentDate).contains(contact.id()));
+
+        // the client connects in background, the next removal goes through EDS
+        QTest::qWait(2000);
+        contact = createContact("Beltrano", sourceId);
+        QVERIFY(m_manager->saveContact(&contact));
+        QVERIFY(m_manager->removeContact(contact.id()));
+        QTRY_VERIFY(!m_manager->contactIds().contains(contact.id()));
+        QVERIFY(deletedContacts(currentDate).contains(contact.id()));
+    }
+};
+
+QTEST_MAIN(ContactRemoveTest)
+
+#include "contact-remove-test.moc"
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QtContacts>
+
+#include "config.h"
+#include "base-eds-test.h"
+#include "common/vcard-parser.h"
+
+#include <libebook/libebook.h>
+
+using namespace QtContacts;
+
+class ContactUpdateTest : public QObject, public BaseEDSTest
+{
+    Q_OBJECT
+
+private:
+    EBookClient *m_client;
+    EBookClientView *m_view;
+    int m_modifiedCount;
+
+    static void onObjectsModified(EBookClientView *view, const GSList *contacts, gpointer userdata)
+    {
+        Q_UNUSED(view);
+        ContactUpdateTest *self = static_cast<ContactUpdateTest*>(userdata);
+        self->m_modifiedCount += g_slist_length(const_cast<GSList*>(contacts));
+    }
+
+    EContact *edsContact()
+    {
+        GSList *contacts = 0;
+        EBookQuery *query = e_book_query_any_field_contains("");
+        gchar *sexp = e_book_query_to_string(query);
+        e_book_client_get_contacts_sync(m_client, sexp, &contacts, NULL, NULL);
+        g_free(sexp);
+        e_book_query_unref(query);
+
+        EContact *contact = contacts ? E_CONTACT(g_object_ref(contacts->data)) : 0;
+        g_slist_free_full(contacts, g_object_unref);
+        return contact;
+    }
+
+    // the unfolded lines of the attribute as stored by EDS
+    QStringList edsAttributes(EContact *contact, const QString &name)
+    {
+        gchar *vcard = e_vcard_to_string(E_VCARD(contact), EVC_FORMAT_VCARD_30);
+        QString data = QString::fromUtf8(vcard).replace("\r\n ", "");
+        g_free(vcard);
+
+        QStringList result;
+        Q_FOREACH(const QString &line, data.split("\r\n", QString::SkipEmptyParts)) {
+            if (line.startsWith(name + ";") || line.startsWith(name + ":")) {
+                result << line;
+            }
+        }
+        return result;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        BaseEDSTest::initTestCaseImpl();
+
+        GError *error = 0;
+        ESourceRegistry *registry = e_source_registry_new_sync(NULL, &error);
+        QVERIFY(!error);
+        ESource *source = e_source_registry_ref_source(registry, "system-address-book");
+        QVERIFY(source);
+        m_client = E_BOOK_CLIENT(E_BOOK_CLIENT_CONNECT_SYNC(source, NULL, &error));
+        QVERIFY(!error);
+        g_object_unref(source);
+        g_object_unref(registry);
+
+        EBookQuery *query = e_book_query_any_field_contains("");
+        gchar *sexp = e_book_query_to_string(query);
+        e_book_client_get_view_sync(m_client, sexp, &m_view, NULL, &error);
+        g_free(sexp);
+        e_book_query_unref(query);
+        QVERIFY(!error);
+        g_signal_connect(m_view, "objects-modified", (GCallback) onObjectsModified, this);
+        e_book_client_view_start(m_view, &error);
+        QVERIFY(!error);
+    }
+
+    void cleanupTestCase()
+    {
+        e_book_client_view_stop(m_view, NULL);
+        g_object_unref(m_view);
+        g_object_unref(m_client);
+        BaseEDSTest::cleanupTestCaseImpl();
+    }
+
+    void init()
+    {
+        BaseEDSTest::initImpl();
+        m_modifiedCount = 0;
+    }
+
+    void cleanup()
+    {
+        QList<QContactId> contacts = m_manager->contactIds();
+        m_manager->removeContacts(contacts);
+        BaseEDSTest::cleanupImpl();
+    }
+
+    /*
+     * Test if the changes of several details are written with a single EDS modification
+     * and the unchanged attributes keep their params
+     */
+    void testUpdateSeveralDetails()
+    {
+        QContact contact = galera::VCardParser::vcardToContact(QStringLiteral("BEGIN:VCARD\r\n"
+                                                                              "VERSION:3.0\r\n"
+                                                                              "N:;Fulano;;;\r\n"
+                                                                              "EMAIL;TYPE=HOME:fulano@gmail.com\r\n"
+                                                                              "EMAIL;TYPE=WORK:fulano@work.com\r\n"
+                                                                              "TEL;TYPE=CELL:123456\r\n"
+                                                                              "TEL;TYPE=WORK:654321\r\n"
+                                                                              "NOTE:Works at the quarry\r\n"
+                                                                              "END:VCARD\r\n"));
+        QList<QContactPhoneNumber> phones = contact.details<QContactPhoneNumber>();
+        QCOMPARE(phones.size(), 2);
+        contact.setPreferredDetail(galera::VCardParser::PreferredActionNames[QContactDetail::TypePhoneNumber],
+                                   phones[1]);
+
+        // create a contact
+        QSignalSpy spyContactAdded(m_manager, SIGNAL(contactsAdded(QList<QContactId>)));
+        bool result = m_manager->saveContact(&contact);
+        QCOMPARE(result, true);
+        QTRY_COMPARE(spyContactAdded.count(), 1);
+
+        EContact *original = edsContact();
+        QVERIFY(original);
+        QStringList originalEmails = edsAttributes(original, "EMAIL");
+        QStringList originalNotes = edsAttributes(original, "NOTE");
+        QStringList originalPhones = edsAttributes(original, "TEL");
+        g_object_unref(original);
+        QCOMPARE(originalEmails.size(), 2);
+        QCOMPARE(originalNotes.size(), 1);
+        QCOMPARE(originalPhones.size(), 2);
+        QString preferredPhone;
+        Q_FOREACH(const QString &phone, originalPhones) {
+            if (phone.endsWith(":654321")) {
+                preferredPhone = phone;
+            }
+        }
+        QVERIFY(preferredPhone.contains("PREF"));
+
+        // wait for the notifications of the contact creation
+        QTest::qWait(2000);
+        m_modifiedCount = 0;
+
+        // change several details at once
+        QList<QContact> contacts = m_manager->contacts();
+        QCOMPARE(contacts.size(), 1);
+        QContact newContact(contacts[0]);
+
+        QContactName name = newContact.detail<QContactName>();
+        name.setFirstName("Beltrano");
+        name.setLastName("Silva");
+        newContact.saveDetail(&name);
+
+        QContactBirthday birthday;
+        birthday.setDate(QDate(1980, 5, 12));
+        newContact.saveDetail(&birthday);
+
+        Q_FOREACH(QContactPhoneNumber phone, newContact.details<QContactPhoneNumber>()) {
+            if (phone.number() == "123456") {
+                phone.setNumber("999999");
+                newContact.saveDetail(&phone);
+            }
+        }
+
+        QContactUrl url;
+        url.setUrl("http://www.quarry.com/fulano");
+        newContact.saveDetail(&url);
+
+        QSignalSpy spyContactChanged(m_manager, SIGNAL(contactsChanged(QList<QContactId>)));
+        result = m_manager->saveContact(&newContact);
+        QCOMPARE(result, true);
+        QTRY_COMPARE(spyContactChanged.count(), 1);
+
+        // EDS notifies the modifications in batches
+        QTRY_VERIFY(m_modifiedCount > 0);
+        QTest::qWait(2000);
+        QCOMPARE(m_modifiedCount, 1);
+
+        // the details changed
+        contacts = m_manager->contacts();
+        QCOMPARE(contacts.size(), 1);
+        QCOMPARE(contacts[0].detail<QContactName>().firstName(), QStringLiteral("Beltrano"));
+        QCOMPARE(contacts[0].detail<QContactName>().lastName(), QStringLiteral("Silva"));
+        QCOMPARE(contacts[0].detail<QContactBirthday>().date(), QDate(1980, 5, 12));
+        QCOMPARE(contacts[0].detail<QContactUrl>().url(), QStringLiteral("http://www.quarry.com/fulano"));
+
+        // the unchanged attributes are kept as they were
+        EContact *updated = edsContact();
+        QVERIFY(updated);
+        QCOMPARE(edsAttributes(updated, "EMAIL"), originalEmails);
+        QCOMPARE(edsAttributes(updated, "NOTE"), originalNotes);
+        QStringList phonesAttrs = edsAttributes(updated, "TEL");
+        g_object_unref(updated);
+        QCOMPARE(phonesAttrs.size(), 2);
+        QVERIFY(phonesAttrs.contains(preferredPhone));
+    }
+};
+
+QTEST_MAIN(ContactUpdateTest)
+
+#include "contact-update-test.moc"
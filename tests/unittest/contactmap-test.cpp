@@ -110,6 +110,31 @@ private:
         return phones;
     }
 
+    galera::ContactEntry *createPhoneEntry(const QString &id, const QStringList &phones)
+    {
+        QtContacts::QContact contact;
+        QtContacts::QContactGuid guid;
+        guid.setGuid(id);
+        contact.saveDetail(&guid);
+
+        Q_FOREACH(const QString &number, phones) {
+            QtContacts::QContactPhoneNumber phone;
+            phone.setNumber(number);
+            contact.saveDetail(&phone);
+        }
+        return new galera::ContactEntry(new galera::QIndividual(contact, QDateTime(), 0));
+    }
+
+    QStringList phoneMatches(const galera::ContactsMap &map, const QString &phone)
+    {
+        QStringList ids;
+        Q_FOREACH(galera::ContactEntry *entry, map.valueByPhone(phone)) {
+            ids << entry->individual()->id();
+        }
+        ids.sort();
+        return ids;
+    }
+
 private Q_SLOTS:
     void initTestCase()
     {
@@ -196,6 +221,100 @@ private Q_SLOTS:
         QVERIFY(entry->individual()->individual() == individual);
     }
 
+    void testLookupByText_data()
+    {
+        QTest::addColumn<QStringList>("terms");
+        QTest::addColumn<int>("numberOfMatches");
+
+        QTest::newRow("common name") << (QStringList() << "fulano") << 3;
+        QTest::newRow("case insensitive") << (QStringList() << "FULANO_2") << 1;
+        QTest::newRow("short term") << (QStringList() << "l_") << 0;
+        QTest::newRow("email domain") << (QStringList() << "ubuntu.com") << 3;
+        QTest::newRow("email part") << (QStringList() << "_3@ub") << 1;
+        QTest::newRow("union") << (QStringList() << "fulano_1" << "fulano_2") << 2;
+        QTest::newRow("no match") << (QStringList() << "xyz") << 0;
+    }
+
+    void testLookupByText()
+    {
+        QFETCH(QStringList, terms);
+        QFETCH(int, numberOfMatches);
+
+        QList<QStringList> clauses;
+        QStringList foldedTerms;
+        Q_FOREACH(const QString &term, terms) {
+            foldedTerms << term.toCaseFolded();
+        }
+        clauses << foldedTerms;
+
+        QList<galera::ContactEntry*> entries = m_map.valuesByText(clauses);
+        QCOMPARE(entries.size(), numberOfMatches);
+    }
+
+    void testLookupByTextIntersection()
+    {
+        QList<QStringList> clauses;
+        clauses << (QStringList() << "fulano")
+                << (QStringList() << "fulano_3@");
+
+        QList<galera::ContactEntry*> entries = m_map.valuesByText(clauses);
+        QCOMPARE(entries.size(), 1);
+        QVERIFY(entries.first()->individual()->contact().detail<QtContacts::QContactEmailAddress>().emailAddress().startsWith("fulano_3"));
+    }
+
+    void testValuesBySortClause()
+    {
+        galera::SortClause clause("FIRST_NAME DESC");
+        QList<QByteArray> sortKeys;
+        QList<galera::ContactEntry*> entries = m_map.values(clause, &sortKeys);
+        QCOMPARE(entries.size(), m_map.size());
+        QCOMPARE(sortKeys.size(), m_map.size());
+        QCOMPARE(entries.first()->individual()->contact().detail<QtContacts::QContactName>().firstName(),
+                 QString("Fulano_3"));
+
+        // the secondary index follows the map changes
+        FolksIndividual *individual = entries.first()->individual()->individual();
+        galera::ContactEntry *entry = m_map.take(individual);
+        entries = m_map.values(clause, &sortKeys);
+        QCOMPARE(entries.size(), m_map.size());
+        QCOMPARE(entries.first()->individual()->contact().detail<QtContacts::QContactName>().firstName(),
+                 QString("Fulano_2"));
+
+        m_map.insert(entry);
+        entries = m_map.values(clause, &sortKeys);
+        QCOMPARE(entries.size(), m_map.size());
+        QVERIFY(entries.first() == entry);
+    }
+
+    void testBulkInsert()
+    {
+        QList<galera::ContactEntry*> sorted = m_map.values();
+        QList<galera::ContactEntry*> entries;
+        entries << m_map.take(sorted.last()->individual()->individual())
+                << m_map.take(sorted.first()->individual()->individual());
+
+        m_map.insert(entries);
+        QCOMPARE(m_map.values(), sorted);
+        Q_FOREACH(galera::ContactEntry *entry, entries) {
+            QString phone = entry->individual()->contact().detail<QtContacts::QContactPhoneNumber>().number();
+            QVERIFY(m_map.valueByPhone(phone).contains(entry));
+        }
+    }
+
+    void testReinsert()
+    {
+        QList<galera::ContactEntry*> sorted = m_map.values();
+        int size = m_map.size();
+
+        m_map.reinsert(sorted);
+        QCOMPARE(m_map.size(), size);
+        QCOMPARE(m_map.values(), sorted);
+        Q_FOREACH(galera::ContactEntry *entry, sorted) {
+            QString phone = entry->individual()->contact().detail<QtContacts::QContactPhoneNumber>().number();
+            QCOMPARE(m_map.valueByPhone(phone).count(entry), 1);
+        }
+    }
+
     void testLookupByPhone_data()
     {
         QStringList phones = allPhones();
@@ -238,6 +357,101 @@ private Q_SLOTS:
         QList<galera::ContactEntry*> entries = m_map.valueByPhone(query);
         QCOMPARE(entries.size(), numberOfMatches);
     }
+
+    void testPhoneIndex()
+    {
+        galera::ContactsMap map;
+        map.insert(createPhoneEntry("special-1", QStringList() << "*144" << "+190"));
+        map.insert(createPhoneEntry("special-2", QStringList() << "#144"));
+        map.insert(createPhoneEntry("long-1", QStringList() << "+55(81)87042155" << "12345678#123"));
+        map.insert(createPhoneEntry("long-2", QStringList() << "(81)87042155"));
+        map.insert(createPhoneEntry("short-1", QStringList() << "2155"));
+
+        // '+', '*' and '#' are part of the number
+        QCOMPARE(phoneMatches(map, "*144"), QStringList() << "special-1");
+        QCOMPARE(phoneMatches(map, "#144"), QStringList() << "special-2");
+        QCOMPARE(phoneMatches(map, "+190"), QStringList() << "special-1");
+        QVERIFY(phoneMatches(map, "144").isEmpty());
+        QVERIFY(phoneMatches(map, "190").isEmpty());
+
+        // long numbers match by the last 7 chars, short numbers only match the whole number
+        QCOMPARE(phoneMatches(map, "87042155"), QStringList() << "long-1" << "long-2");
+        QCOMPARE(phoneMatches(map, "7042155"), QStringList() << "long-1" << "long-2");
+        QCOMPARE(phoneMatches(map, "99678#123"), QStringList() << "long-1");
+        QCOMPARE(phoneMatches(map, "2155"), QStringList() << "short-1");
+        QVERIFY(phoneMatches(map, "042155").isEmpty());
+
+        // all numbers of the removed contacts leave the index
+        map.remove("long-1");
+        QCOMPARE(phoneMatches(map, "87042155"), QStringList() << "long-2");
+        QVERIFY(phoneMatches(map, "678#123").isEmpty());
+
+        map.remove("special-1");
+        QVERIFY(phoneMatches(map, "*144").isEmpty());
+        QVERIFY(phoneMatches(map, "+190").isEmpty());
+        QCOMPARE(phoneMatches(map, "#144"), QStringList() << "special-2");
+
+        // the contact inserted again is indexed by its new numbers only
+        map.insert(createPhoneEntry("long-1", QStringList() << "33331410"));
+        QCOMPARE(phoneMatches(map, "33331410"), QStringList() << "long-1");
+        QCOMPARE(phoneMatches(map, "87042155"), QStringList() << "long-2");
+        QVERIFY(phoneMatches(map, "678#123").isEmpty());
+        map.clear();
+    }
+
+    void testDeletedIndex()
+    {
+        galera::ContactsMap map;
+        QDateTime base(QDate(2016, 1, 1), QTime(10, 0, 0), Qt::UTC);
+        for(int i = 0; i < 6; i++) {
+            QtContacts::QContact contact;
+            QtContacts::QContactGuid guid;
+            guid.setGuid(QString("deleted-%1").arg(i));
+            contact.saveDetail(&guid);
+
+            QtContacts::QContactSyncTarget target;
+            target.setSyncTarget("Source");
+            target.setValue(QtContacts::QContactSyncTarget::FieldSyncTarget + 1,
+                            (i % 2) ? "source-odd" : "source-even");
+            contact.saveDetail(&target);
+
+            // the last contact is not deleted
+            QDateTime deletedAt = (i < 5) ? base.addSecs(60 * (5 - i)) : QDateTime();
+            map.insert(new galera::ContactEntry(new galera::QIndividual(contact, deletedAt, 0)));
+        }
+
+        QList<galera::ContactEntry*> entries = map.valuesDeletedSince("source-even", QDateTime::fromTime_t(0));
+        QCOMPARE(entries.size(), 3);
+        QCOMPARE(entries.first()->individual()->id(), QString("deleted-4"));
+        QCOMPARE(entries.last()->individual()->id(), QString("deleted-0"));
+
+        entries = map.valuesDeletedSince("source-odd", base.addSecs(120));
+        QCOMPARE(entries.size(), 1);
+        QCOMPARE(entries.first()->individual()->id(), QString("deleted-1"));
+        QVERIFY(map.valuesDeletedSince("source-none", QDateTime::fromTime_t(0)).isEmpty());
+
+        // the index follows the map changes
+        map.remove("deleted-1");
+        QVERIFY(map.valuesDeletedSince("source-odd", base.addSecs(120)).isEmpty());
+        map.clear();
+    }
+
+    void testReleasePinnedEntry()
+    {
+        m_map.lockForRead();
+        QList<galera::ContactEntry*> entries = m_map.values();
+        m_map.pin();
+        m_map.unlock();
+
+        // the entry removed while pinned stays valid for the reader
+        galera::ContactEntry *entry = m_map.take(entries.first()->individual()->id());
+        m_map.release(entry);
+        QVERIFY(!m_map.contains(entry->individual()->id()));
+        QVERIFY(entry->individual()->individual() != 0);
+
+        m_map.unpin();
+        m_map.release(0);
+    }
 };
 
 QTEST_MAIN(ContactMapTest)
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lib/contacts-map.h"
+#include "lib/contacts-snapshot.h"
+#include "lib/qindividual.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QTemporaryDir>
+
+#include <QtContacts>
+
+using namespace QtContacts;
+
+class ContactsSnapshotTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    galera::ContactEntry *createEntry(int index, const QDateTime &deletedAt = QDateTime())
+    {
+        QContact contact;
+        QContactGuid guid;
+        guid.setGuid(QString("contact-%1").arg(index));
+        contact.saveDetail(&guid);
+
+        QContactName name;
+        name.setFirstName(QString("Fulano_%1").arg(index));
+        contact.saveDetail(&name);
+
+        QContactDisplayLabel label;
+        label.setLabel(QString("Fulano_%1").arg(index));
+        contact.saveDetail(&label);
+
+        QContactPhoneNumber phone;
+        phone.setNumber(QString("3333141%1").arg(index));
+        contact.saveDetail(&phone);
+
+        return new galera::ContactEntry(new galera::QIndividual(contact, deletedAt, 0));
+    }
+
+private Q_SLOTS:
+    void testSaveAndLoad()
+    {
+        QTemporaryDir dir;
+        QString path = dir.path() + "/contacts.snapshot";
+
+        QList<galera::ContactEntry*> entries;
+        entries << createEntry(1)
+                << createEntry(2, QDateTime(QDate(2016, 1, 1), QTime(10, 0, 0), Qt::UTC))
+                << createEntry(3);
+        entries.last()->individual()->setVisible(false);
+        QVERIFY(galera::ContactsSnapshot::save(path, entries));
+
+        QList<galera::ContactEntry*> loaded = galera::ContactsSnapshot::load(path, 0);
+        QCOMPARE(loaded.size(), entries.size());
+        for(int i = 0; i < entries.size(); i++) {
+            galera::QIndividual *expected = entries.at(i)->individual();
+            galera::QIndividual *individual = loaded.at(i)->individual();
+            QCOMPARE(individual->id(), expected->id());
+            QCOMPARE(individual->isVisible(), expected->isVisible());
+            QCOMPARE(individual->deletedAt().isValid(), expected->deletedAt().isValid());
+            QCOMPARE(individual->contact().detail<QContactName>().firstName(),
+                     expected->contact().detail<QContactName>().firstName());
+            QCOMPARE(individual->contact().id(), expected->contact().id());
+        }
+
+        // the snapshot entries are indexed as the folks ones
+        galera::ContactsMap map;
+        map.insert(loaded);
+        QCOMPARE(map.size(), entries.size());
+        QVERIFY(map.value("contact-2") != 0);
+        QCOMPARE(map.valueByPhone("33331412").size(), 1);
+
+        qDeleteAll(entries);
+    }
+
+    void testInvalidSnapshot()
+    {
+        QTemporaryDir dir;
+        QString path = dir.path() + "/contacts.snapshot";
+        QVERIFY(galera::ContactsSnapshot::load(path, 0).isEmpty());
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a snapshot");
+        file.close();
+        QVERIFY(galera::ContactsSnapshot::load(path, 0).isEmpty());
+    }
+};
+
+QTEST_MAIN(ContactsSnapshotTest)
+
+#include "contacts-snapshot-test.moc"
@@ -130,6 +130,36 @@ private Q_SLOTS:
                  QStringLiteral("dummy-store"));
     }
 
+    /*
+     * Test create more contacts than fit in a single 'createContacts' call
+     */
+    void testCreateContactsInBatches()
+    {
+        QList<QContact> contacts;
+        for(int i = 0; i < 250; i++) {
+            QContact contact = testContact();
+            QContactName name = contact.detail<QContactName>();
+            name.setFirstName(QString("Fulano %1").arg(i));
+            contact.saveDetail(&name);
+            contacts << contact;
+        }
+
+        QMap<int, QContactManager::Error> errors;
+        bool result = m_manager->saveContacts(&contacts, &errors);
+        QCOMPARE(result, true);
+        QVERIFY(errors.isEmpty());
+
+        // the saved contacts keep the request order
+        QCOMPARE(contacts.size(), 250);
+        for(int i = 0; i < contacts.size(); i++) {
+            QVERIFY(!contacts[i].id().isNull());
+            QCOMPARE(contacts[i].detail<QContactName>().firstName(), QString("Fulano %1").arg(i));
+        }
+
+        // every contact was created once
+        QTRY_COMPARE(m_manager->contactIds().size(), 250);
+    }
+
     /*
      * Test update a contact
      */
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "dummy-backend.h"
+#include "scoped-loop.h"
+
+#include "lib/qindividual.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+
+#include <QtContacts>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+class QIndividualTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    DummyBackendProxy *m_dummy;
+    galera::QIndividual *m_individual;
+    QList<QtContacts::QContactDetail::DetailType> m_fields;
+
+    // load the contact and cache a vcard for the current revision
+    void cacheVCard(const QString &vcard)
+    {
+        m_individual->contact();
+        m_individual->cacheVCard(m_fields, vcard, m_individual->revision());
+        QCOMPARE(m_individual->cachedVCard(m_fields), vcard);
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_dummy = new DummyBackendProxy();
+        m_dummy->start();
+        QTRY_VERIFY(m_dummy->isReady());
+
+        QtContacts::QContact contact;
+        QtContacts::QContactName name;
+        name.setFirstName("Fulano");
+        name.setLastName("Tal");
+        contact.saveDetail(&name);
+
+        QtContacts::QContactPhoneNumber phone;
+        phone.setNumber("33331410");
+        contact.saveDetail(&phone);
+
+        m_dummy->createContact(contact);
+        QCOMPARE(m_dummy->individuals().size(), 1);
+
+        m_fields << QtContacts::QContactDetail::TypeName
+                 << QtContacts::QContactDetail::TypePhoneNumber;
+    }
+
+    void cleanupTestCase()
+    {
+        m_dummy->shutdown();
+        delete m_dummy;
+    }
+
+    void init()
+    {
+        m_individual = new galera::QIndividual(m_dummy->individuals().first()->individual(),
+                                               m_dummy->aggregator());
+    }
+
+    void cleanup()
+    {
+        delete m_individual;
+    }
+
+    /*
+     * Test if the cached vcards are kept by field list
+     */
+    void testCacheByFields()
+    {
+        cacheVCard("name and phone");
+
+        QList<QtContacts::QContactDetail::DetailType> allFields;
+        QVERIFY(m_individual->cachedVCard(allFields).isEmpty());
+        m_individual->cacheVCard(allFields, "all fields", m_individual->revision());
+        QCOMPARE(m_individual->cachedVCard(allFields), QStringLiteral("all fields"));
+        QCOMPARE(m_individual->cachedVCard(m_fields), QStringLiteral("name and phone"));
+    }
+
+    /*
+     * Test if the cache is dropped when the whole contact is reloaded
+     */
+    void testCacheDroppedOnMarkAsDirty()
+    {
+        cacheVCard("before flush");
+        uint revision = m_individual->revision();
+
+        m_individual->flush();
+        QVERIFY(m_individual->revision() != revision);
+        QVERIFY(m_individual->cachedVCard(m_fields).isEmpty());
+    }
+
+    /*
+     * Test if the cache is dropped when folks notifies the change of some details
+     */
+    void testCacheDroppedOnPartialChange()
+    {
+        // properties that are not part of the contact keep the cache
+        cacheVCard("before change");
+        uint revision = m_individual->revision();
+        g_object_notify(G_OBJECT(m_individual->individual()), "presence-message");
+        QCOMPARE(m_individual->revision(), revision);
+        QCOMPARE(m_individual->cachedVCard(m_fields), QStringLiteral("before change"));
+
+        g_object_notify(G_OBJECT(m_individual->individual()), "phone-numbers");
+        QVERIFY(m_individual->revision() != revision);
+        QVERIFY(m_individual->cachedVCard(m_fields).isEmpty());
+
+        // the details are loaded again
+        QCOMPARE(m_individual->contact().detail<QtContacts::QContactPhoneNumber>().number(),
+                 QStringLiteral("33331410"));
+    }
+
+    /*
+     * Test if the cache is dropped when the folks individual is replaced
+     */
+    void testCacheDroppedOnClear()
+    {
+        cacheVCard("before clear");
+        uint revision = m_individual->revision();
+
+        FolksIndividual *individual = m_individual->individual();
+        g_object_ref(individual);
+        m_individual->setIndividual(0);
+        QVERIFY(m_individual->revision() != revision);
+        QVERIFY(m_individual->cachedVCard(m_fields).isEmpty());
+
+        m_individual->setIndividual(individual);
+        g_object_unref(individual);
+        QVERIFY(m_individual->cachedVCard(m_fields).isEmpty());
+    }
+
+    /*
+     * Test if a vcard exported before a change is not cached after it
+     */
+    void testStaleRevision()
+    {
+        m_individual->contact();
+        uint exportRevision = m_individual->revision();
+
+        // the contact changes while the vcard is exported
+        g_object_notify(G_OBJECT(m_individual->individual()), "structured-name");
+        m_individual->cacheVCard(m_fields, "stale", exportRevision);
+        QVERIFY(m_individual->cachedVCard(m_fields).isEmpty());
+
+        // the next export is cached
+        m_individual->cacheVCard(m_fields, "current", m_individual->revision());
+        QCOMPARE(m_individual->cachedVCard(m_fields), QStringLiteral("current"));
+    }
+};
+
+QTEST_MAIN(QIndividualTest)
+
+#include "qindividual-test.moc"
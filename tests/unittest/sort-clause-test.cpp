@@ -25,6 +25,8 @@
 
 #include "common/sort-clause.h"
 
+#include <string.h>
+
 using namespace QtContacts;
 using namespace galera;
 
@@ -32,6 +34,59 @@ class SortClauseTest : public QObject
 {
     Q_OBJECT
 
+private:
+    // strcoll with the code points breaking ties, the string order of SortClause::sortKey
+    static int compareStrings(QString a, QString b, Qt::CaseSensitivity sensitivity)
+    {
+        if (sensitivity == Qt::CaseInsensitive) {
+            a = a.toCaseFolded();
+            b = b.toCaseFolded();
+        }
+        int result = strcoll(a.toLocal8Bit().constData(), b.toLocal8Bit().constData());
+        if (result == 0) {
+            result = QString::compare(a, b, Qt::CaseSensitive);
+        }
+        return result;
+    }
+
+    // same as QContactManagerEngine::compareContact but with compareStrings
+    static int compareContact(const QContact &a, const QContact &b, const QList<QContactSortOrder> &sortOrders)
+    {
+        Q_FOREACH(const QContactSortOrder &sortOrder, sortOrders) {
+            if (!sortOrder.isValid()) {
+                break;
+            }
+
+            QVariant aVal = a.detail(sortOrder.detailType()).value(sortOrder.detailField());
+            QVariant bVal = b.detail(sortOrder.detailType()).value(sortOrder.detailField());
+            bool aIsNull = !aVal.canConvert<QString>() || aVal.toString().isEmpty();
+            bool bIsNull = !bVal.canConvert<QString>() || bVal.toString().isEmpty();
+            if (aIsNull && bIsNull) {
+                continue;
+            }
+            if (aIsNull) {
+                return (sortOrder.blankPolicy() == QContactSortOrder::BlanksFirst ? -1 : 1);
+            }
+            if (bIsNull) {
+                return (sortOrder.blankPolicy() == QContactSortOrder::BlanksFirst ? 1 : -1);
+            }
+
+            int comparison;
+            if (aVal.type() == QVariant::String) {
+                comparison = compareStrings(aVal.toString(), bVal.toString(), sortOrder.caseSensitivity());
+            } else {
+                comparison = QContactManagerEngine::compareVariant(aVal, bVal, sortOrder.caseSensitivity());
+            }
+            if (sortOrder.direction() == Qt::DescendingOrder) {
+                comparison = -comparison;
+            }
+            if (comparison != 0) {
+                return comparison;
+            }
+        }
+        return 0;
+    }
+
 private Q_SLOTS:
 
     void testSingleClause()
@@ -126,6 +181,61 @@ private Q_SLOTS:
         cClauseList << sortTag;
         QVERIFY(clause.toContactSortOrder() == cClauseList);
     }
+
+    void testSortKey_data()
+    {
+        QTest::addColumn<QString>("clause");
+
+        QTest::newRow("tag") << "TAG ASC";
+        QTest::newRow("first name desc") << "FIRST_NAME DESC";
+        QTest::newRow("birthday and last name") << "BIRTHDAY ASC, LAST_NAME DESC";
+        QTest::newRow("full name and phone") << "FULL_NAME ASC, PHONE ASC";
+    }
+
+    void testSortKey()
+    {
+        QFETCH(QString, clause);
+
+        QStringList names;
+        names << "anna" << "Anna" << "bob" << "Bob Junior" << "carl" << "" << "zed" << "ab";
+        QList<QContact> contacts;
+        for(int i = 0; i < names.size(); i++) {
+            QContact c;
+            QContactName name;
+            name.setFirstName(names[i]);
+            name.setLastName(names[names.size() - i - 1]);
+            c.saveDetail(&name);
+
+            QContactDisplayLabel label;
+            label.setLabel(names[i]);
+            c.saveDetail(&label);
+
+            QContactTag tag;
+            tag.setTag(names[i].toUpper());
+            c.saveDetail(&tag);
+
+            if (i % 3) {
+                QContactBirthday birthday;
+                birthday.setDateTime(QDateTime(QDate(1980 + (i % 2), 1, 1), QTime(0, 0, 0)));
+                c.saveDetail(&birthday);
+            }
+
+            QContactPhoneNumber phone;
+            phone.setNumber(QString::number(i % 4));
+            c.saveDetail(&phone);
+            contacts << c;
+        }
+
+        // keys must follow the documented order
+        SortClause sortClause(clause);
+        Q_FOREACH(const QContact &a, contacts) {
+            Q_FOREACH(const QContact &b, contacts) {
+                int expected = compareContact(a, b, sortClause.toContactSortOrder());
+                int result = SortClause::compareSortKeys(sortClause.sortKey(a), sortClause.sortKey(b));
+                QCOMPARE(qBound(-1, result, 1), qBound(-1, expected, 1));
+            }
+        }
+    }
 };
 
 QTEST_MAIN(SortClauseTest)
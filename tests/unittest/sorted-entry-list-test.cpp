@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lib/sorted-entry-list.h"
+#include "common/sort-clause.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+
+using namespace galera;
+
+class SortedEntryListTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // the list never touches the entries, fake pointers are enough
+    static ContactEntry *entry(int i)
+    {
+        return reinterpret_cast<ContactEntry*>(quintptr(i + 1) * 8);
+    }
+
+    static QByteArray key(int value)
+    {
+        return QByteArray::number(value).rightJustified(4, '0');
+    }
+
+    // reference implementation, same order as the old sorted QList
+    static void insertSorted(QList<QPair<QByteArray, ContactEntry*> > *list, ContactEntry *e, const QByteArray &k)
+    {
+        int pos = 0;
+        while ((pos < list->size()) && (SortClause::compareSortKeys(list->at(pos).first, k) <= 0)) {
+            pos++;
+        }
+        list->insert(pos, qMakePair(k, e));
+    }
+
+    static void removeSorted(QList<QPair<QByteArray, ContactEntry*> > *list, ContactEntry *e)
+    {
+        for(int i = 0; i < list->size(); i++) {
+            if (list->at(i).second == e) {
+                list->removeAt(i);
+                return;
+            }
+        }
+    }
+
+    void compare(const SortedEntryList &list, const QList<QPair<QByteArray, ContactEntry*> > &expected)
+    {
+        QCOMPARE(list.size(), expected.size());
+        QList<ContactEntry*> values = list.values();
+        QList<QByteArray> keys = list.sortKeys();
+        for(int i = 0; i < expected.size(); i++) {
+            QCOMPARE(values.at(i), expected.at(i).second);
+            QCOMPARE(keys.at(i), expected.at(i).first);
+            QCOMPARE(list.at(i), expected.at(i).second);
+            QCOMPARE(list.indexOf(expected.at(i).second), i);
+        }
+    }
+
+private Q_SLOTS:
+    void testInsertRemoveUpdate()
+    {
+        SortedEntryList list;
+        QList<QPair<QByteArray, ContactEntry*> > expected;
+
+        qsrand(42);
+        for(int i = 0; i < 200; i++) {
+            QByteArray k = key(qrand() % 50);
+            insertSorted(&expected, entry(i), k);
+            int pos = list.insert(entry(i), k);
+            QCOMPARE(expected.at(pos).second, entry(i));
+        }
+        compare(list, expected);
+
+        for(int i = 0; i < 200; i += 3) {
+            int pos = list.remove(entry(i));
+            QCOMPARE(expected.at(pos).second, entry(i));
+            removeSorted(&expected, entry(i));
+        }
+        QCOMPARE(list.remove(entry(0)), -1);
+        compare(list, expected);
+
+        for(int i = 1; i < 200; i += 3) {
+            QByteArray k = key(qrand() % 50);
+            removeSorted(&expected, entry(i));
+            insertSorted(&expected, entry(i), k);
+            int pos = list.update(entry(i), k);
+            QCOMPARE(expected.at(pos).second, entry(i));
+        }
+        compare(list, expected);
+        QVERIFY(list.at(list.size()) == 0);
+    }
+
+    void testAssign()
+    {
+        QList<ContactEntry*> entries;
+        QList<QByteArray> keys;
+        QList<QPair<QByteArray, ContactEntry*> > expected;
+        for(int i = 0; i < 100; i++) {
+            entries << entry(i);
+            keys << key(i / 2);
+            expected << qMakePair(key(i / 2), entry(i));
+        }
+
+        SortedEntryList list;
+        list.insert(entry(500), key(1));
+        list.assign(entries, keys);
+        QVERIFY(!list.contains(entry(500)));
+        compare(list, expected);
+
+        // new entries go after the assigned ones with the same key
+        insertSorted(&expected, entry(100), key(10));
+        QCOMPARE(list.insert(entry(100), key(10)), 22);
+        compare(list, expected);
+
+        list.clear();
+        QCOMPARE(list.size(), 0);
+        QVERIFY(list.values().isEmpty());
+    }
+};
+
+QTEST_MAIN(SortedEntryListTest)
+
+#include "sorted-entry-list-test.moc"
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "lib/view.h"
+#include "lib/contacts-map.h"
+#include "lib/qindividual.h"
+#include "common/filter.h"
+#include "common/sort-clause.h"
+#include "common/contact-codec.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QtDBus>
+
+#include <QtContacts>
+
+using namespace QtContacts;
+
+// a view scan is split in chunks of 256 contacts
+#define VIEW_CONTACTS       2000
+
+class ViewFilterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    galera::ContactsMap m_map;
+
+    // the contacts with a note are matched by a filter that can not use the map indexes,
+    // the names are not created in the sort order
+    void createContacts(galera::ContactsMap *map, int count)
+    {
+        QList<galera::ContactEntry*> entries;
+        for(int i = 0; i < count; i++) {
+            QContact contact;
+            QContactGuid guid;
+            guid.setGuid(QString("contact-%1").arg(i));
+            contact.saveDetail(&guid);
+
+            bool match = ((i % 3) == 0);
+            QContactName name;
+            name.setFirstName(QString("%1 %2").arg(match ? "Match" : "Other")
+                                              .arg((i * 7919) % count, 5, 10, QChar('0')));
+            contact.saveDetail(&name);
+
+            if (match) {
+                QContactNote note;
+                note.setNote("matched note");
+                contact.saveDetail(&note);
+            }
+
+            entries << new galera::ContactEntry(new galera::QIndividual(contact, QDateTime(), 0));
+        }
+        map->insert(entries);
+    }
+
+    // the contacts of the view filtered one by one
+    QStringList serialResult(const QContactFilter &contactFilter, const QString &sort, int maxCount)
+    {
+        galera::Filter filter(contactFilter);
+        galera::SortClause clause(sort);
+        QList<QPair<QByteArray, QString> > matches;
+        Q_FOREACH(galera::ContactEntry *entry, m_map.values()) {
+            QContact contact = entry->individual()->contact();
+            if (filter.test(contact, entry->individual()->deletedAt())) {
+                matches << qMakePair(clause.isEmpty() ? QByteArray() : clause.sortKey(contact),
+                                     entry->individual()->id());
+            }
+        }
+        if (!clause.isEmpty()) {
+            std::stable_sort(matches.begin(), matches.end(), sortKeyLessThan);
+        }
+
+        QStringList ids;
+        for(int i = 0; i < matches.size(); i++) {
+            if ((maxCount > 0) && (ids.size() >= maxCount)) {
+                break;
+            }
+            ids << matches.at(i).second;
+        }
+        return ids;
+    }
+
+    QStringList viewResult(const QContactFilter &contactFilter, const QString &sort, int maxCount)
+    {
+        galera::View view(galera::Filter(contactFilter).toString(), sort, maxCount,
+                          false, QStringList(), &m_map, 0);
+        QDBusConnection connection = QDBusConnection::sessionBus();
+        if (!view.registerObject(connection)) {
+            return QStringList();
+        }
+
+        QStringList ids;
+        Q_FOREACH(const QContact &contact, galera::ContactCodec::decode(view.contactsDetailsBinary(QStringList(), 0, -1))) {
+            ids << contact.detail<QContactGuid>().guid();
+        }
+        view.close();
+        return ids;
+    }
+
+    static bool sortKeyLessThan(const QPair<QByteArray, QString> &a, const QPair<QByteArray, QString> &b)
+    {
+        return (galera::SortClause::compareSortKeys(a.first, b.first) < 0);
+    }
+
+    static QContactFilter noteFilter()
+    {
+        QContactDetailFilter filter;
+        filter.setDetailType(QContactDetail::TypeNote, QContactNote::FieldNote);
+        filter.setMatchFlags(QContactFilter::MatchContains);
+        filter.setValue("matched");
+        return filter;
+    }
+
+    static QContactFilter nameFilter()
+    {
+        QContactDetailFilter filter;
+        filter.setDetailType(QContactDetail::TypeName, QContactName::FieldFirstName);
+        filter.setMatchFlags(QContactFilter::MatchStartsWith);
+        filter.setValue("Match");
+        return filter;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        createContacts(&m_map, VIEW_CONTACTS);
+        QCOMPARE(m_map.size(), VIEW_CONTACTS);
+    }
+
+    void cleanupTestCase()
+    {
+        m_map.clear();
+    }
+
+    /*
+     * Test if the scans split between threads return the same contacts of a serial scan
+     */
+    void testMultiChunkScan_data()
+    {
+        QTest::addColumn<QContactFilter>("filter");
+        QTest::addColumn<QString>("sort");
+
+        QTest::newRow("not indexed, map order") << noteFilter() << QString();
+        QTest::newRow("not indexed, sorted") << noteFilter() << QString("FIRST_NAME ASC");
+        QTest::newRow("indexed, sorted") << nameFilter() << QString("FIRST_NAME DESC");
+    }
+
+    void testMultiChunkScan()
+    {
+        QFETCH(QContactFilter, filter);
+        QFETCH(QString, sort);
+
+        QStringList expected = serialResult(filter, sort, 0);
+        QCOMPARE(expected.size(), (VIEW_CONTACTS + 2) / 3);
+        QCOMPARE(viewResult(filter, sort, 0), expected);
+    }
+
+    /*
+     * Test if limited views keep the first contacts of the whole scan
+     */
+    void testMaxCountAcrossChunks_data()
+    {
+        QTest::addColumn<QContactFilter>("filter");
+        QTest::addColumn<QString>("sort");
+        QTest::addColumn<int>("maxCount");
+
+        // ~85 matches per chunk
+        QTest::newRow("not indexed, map order") << noteFilter() << QString() << 300;
+        QTest::newRow("not indexed, sorted") << noteFilter() << QString("FIRST_NAME ASC") << 300;
+        QTest::newRow("indexed, top k") << nameFilter() << QString("FIRST_NAME ASC") << 100;
+        QTest::newRow("indexed, top k desc") << nameFilter() << QString("FIRST_NAME DESC") << 300;
+    }
+
+    void testMaxCountAcrossChunks()
+    {
+        QFETCH(QContactFilter, filter);
+        QFETCH(QString, sort);
+        QFETCH(int, maxCount);
+
+        QStringList expected = serialResult(filter, sort, maxCount);
+        QCOMPARE(expected.size(), maxCount);
+        QCOMPARE(viewResult(filter, sort, maxCount), expected);
+    }
+
+    /*
+     * Test close a view while its scan is running on several threads
+     */
+    void testCancelWhileFiltering()
+    {
+        galera::ContactsMap map;
+        createContacts(&map, VIEW_CONTACTS * 10);
+
+        for(int i = 0; i < 10; i++) {
+            galera::View *view = new galera::View(galera::Filter(noteFilter()).toString(),
+                                                  "FIRST_NAME ASC", 0, false, QStringList(), &map, 0);
+            // the view waits for the running scan before returning
+            delete view;
+        }
+
+        // no helper is left running over the map
+        QVERIFY(QThreadPool::globalInstance()->waitForDone(10000));
+        map.clear();
+    }
+};
+
+QTEST_MAIN(ViewFilterTest)
+
+#include "view-filter-test.moc"